@@ -0,0 +1,181 @@
+#include "AnimationHelper.h"
+#include "SimdHelper.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+using SimdNative = SimdFloat<SIMD_WIDTH>;
+
+uint32_t findKeyframe(const float *times, uint32_t count, float time, uint32_t &cursor)
+{
+    // same result as lower_bound: times[index - 1] < time <= times[index]
+    uint32_t index = cursor;
+    if (index <= count && (index == 0 || times[index - 1] < time))
+    {
+        // playback moves forward, so the answer is usually the last key or one of the next few
+        for (uint32_t step = 0; step < 4 && index < count && times[index] < time; ++step)
+            index++;
+        if (index == count || times[index] >= time)
+        {
+            cursor = index;
+            return index;
+        }
+    }
+
+    // seek or loop, start over with a binary search
+    index = static_cast<uint32_t>(std::lower_bound(times, times + count, time) - times);
+    cursor = index;
+    return index;
+}
+
+void AnimationEvaluator::clear()
+{
+    groups.clear();
+}
+
+bool AnimationEvaluator::empty() const
+{
+    return groups.empty();
+}
+
+void AnimationEvaluator::addChannel(DriverChannel channel, Interpolation interpolation, const std::vector<float> &times, const std::vector<float> &values, uint32_t target)
+{
+    uint32_t components = channel == DriverChannel::T_Rotation ? 4 : 3;
+    // slerp only makes sense for rotations, vectors fall back to linear
+    if (interpolation == Interpolation::T_Slerp && components == 3)
+        interpolation = Interpolation::T_Linear;
+    if (times.empty() || values.size() < times.size() * components)
+        throw std::runtime_error("driver has fewer values than keyframes!");
+
+    auto iter = std::find_if(groups.begin(), groups.end(), [&](const AnimationChannelGroup &group)
+                             { return group.channel == channel && group.interpolation == interpolation; });
+    if (iter == groups.end())
+    {
+        groups.emplace_back();
+        iter = std::prev(groups.end());
+        iter->channel = channel;
+        iter->interpolation = interpolation;
+        iter->components = components;
+    }
+
+    AnimationChannelGroup &group = *iter;
+    group.targets.push_back(target);
+    group.keyOffsets.push_back(static_cast<uint32_t>(group.times.size()));
+    group.keyCounts.push_back(static_cast<uint32_t>(times.size()));
+    group.cursors.push_back(0);
+    group.times.insert(group.times.end(), times.begin(), times.end());
+    for (size_t i = 0; i < times.size(); ++i)
+    {
+        for (uint32_t c = 0; c < components; ++c)
+        {
+            group.values[c].push_back(values[i * components + c]);
+        }
+    }
+
+    // padding lanes stay at zero and are never written back
+    size_t lanes = (group.targets.size() + SIMD_WIDTH - 1) / SIMD_WIDTH * SIMD_WIDTH;
+    group.factors.resize(lanes, 0.0f);
+    for (uint32_t c = 0; c < components; ++c)
+    {
+        group.from[c].resize(lanes, 0.0f);
+        group.to[c].resize(lanes, 0.0f);
+        group.results[c].resize(lanes, 0.0f);
+    }
+}
+
+void AnimationEvaluator::evaluateGroup(AnimationChannelGroup &group, float time)
+{
+    uint32_t components = group.components;
+
+    // keyframe search and gather are per lane, each driver has its own times
+    for (size_t i = 0; i < group.targets.size(); ++i)
+    {
+        const float *times = group.times.data() + group.keyOffsets[i];
+        uint32_t count = group.keyCounts[i];
+        uint32_t index = findKeyframe(times, count, time, group.cursors[i]);
+
+        uint32_t first = index == 0 ? 0 : index - 1;
+        uint32_t second = index == count ? count - 1 : index;
+        float factor = 0.0f;
+        if (index != 0 && index != count && group.interpolation != Interpolation::T_Step)
+            factor = (time - times[first]) / (times[second] - times[first]);
+
+        group.factors[i] = factor;
+        for (uint32_t c = 0; c < components; ++c)
+        {
+            group.from[c][i] = group.values[c][group.keyOffsets[i] + first];
+            group.to[c][i] = group.values[c][group.keyOffsets[i] + second];
+        }
+    }
+
+    // the interpolation itself runs SIMD_WIDTH lanes at a time
+    for (size_t i = 0; i < group.factors.size(); i += SIMD_WIDTH)
+    {
+        SimdNative factor = SimdNative::load(&group.factors[i]);
+
+        if (group.interpolation != Interpolation::T_Slerp)
+        {
+            // step keys have a zero factor, so they take the same path
+            for (uint32_t c = 0; c < components; ++c)
+            {
+                SimdNative from = SimdNative::load(&group.from[c][i]);
+                SimdNative to = SimdNative::load(&group.to[c][i]);
+                fmadd(to - from, factor, from).store(&group.results[c][i]);
+            }
+            continue;
+        }
+
+        SimdNative q1[4], q2[4];
+        for (uint32_t c = 0; c < 4; ++c)
+        {
+            q1[c] = SimdNative::load(&group.from[c][i]);
+            q2[c] = SimdNative::load(&group.to[c][i]);
+        }
+
+        // take the shortest path by flipping the second key where the dot product is negative
+        SimdNative dot = q1[0] * q2[0] + q1[1] * q2[1] + q1[2] * q2[2] + q1[3] * q2[3];
+        SimdNative sign = select(dot < SimdNative(0.0f), SimdNative(-1.0f), SimdNative(1.0f));
+        SimdNative cosTheta = min(abs(dot), SimdNative(1.0f));
+
+        SimdNative theta = acosPositive(cosTheta);
+        SimdNative invSinTheta = SimdNative(1.0f) / max(sinQuarter(theta), SimdNative(1e-6f));
+        SimdNative w1 = sinQuarter((SimdNative(1.0f) - factor) * theta) * invSinTheta;
+        SimdNative w2 = sinQuarter(factor * theta) * invSinTheta;
+
+        // nearly identical keys make sin(theta) vanish, lerp there instead
+        auto nearlyEqual = cosTheta > SimdNative(0.9995f);
+        w1 = select(nearlyEqual, SimdNative(1.0f) - factor, w1);
+        w2 = select(nearlyEqual, factor, w2) * sign;
+
+        SimdNative result[4];
+        for (uint32_t c = 0; c < 4; ++c)
+        {
+            result[c] = q1[c] * w1 + q2[c] * w2;
+        }
+        SimdNative length = sqrt(result[0] * result[0] + result[1] * result[1] + result[2] * result[2] + result[3] * result[3]);
+        SimdNative invLength = SimdNative(1.0f) / max(length, SimdNative(1e-12f));
+        for (uint32_t c = 0; c < 4; ++c)
+        {
+            (result[c] * invLength).store(&group.results[c][i]);
+        }
+    }
+}
+
+void AnimationEvaluator::evaluate(float time, glm::vec3 *translations, glm::quat *rotations, glm::vec3 *scales)
+{
+    for (auto &group : groups)
+    {
+        evaluateGroup(group, time);
+
+        for (size_t i = 0; i < group.targets.size(); ++i)
+        {
+            uint32_t target = group.targets[i];
+            if (group.channel == DriverChannel::T_Rotation)
+                rotations[target] = glm::quat(group.results[3][i], group.results[0][i], group.results[1][i], group.results[2][i]);
+            else if (group.channel == DriverChannel::T_Translation)
+                translations[target] = glm::vec3(group.results[0][i], group.results[1][i], group.results[2][i]);
+            else
+                scales[target] = glm::vec3(group.results[0][i], group.results[1][i], group.results[2][i]);
+        }
+    }
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <cstdint>
+#include <vector>
+
+enum class DriverChannel
+{
+    T_Translation,
+    T_Rotation,
+    T_Scale
+};
+
+enum class Interpolation
+{
+    T_Step,
+    T_Linear,
+    T_Slerp
+};
+
+// index of the first key >= time (like lower_bound), cursor caches the answer between calls
+// so forward playback costs O(1) instead of a binary search
+uint32_t findKeyframe(const float *times, uint32_t count, float time, uint32_t &cursor);
+
+// drivers of one channel and interpolation mode, keyframes and per-lane staging in SoA layout
+struct AnimationChannelGroup
+{
+    DriverChannel channel;
+    Interpolation interpolation;
+    uint32_t components = 3;
+
+    std::vector<uint32_t> targets; // pose index written by each lane
+    std::vector<uint32_t> keyOffsets;
+    std::vector<uint32_t> keyCounts;
+    std::vector<uint32_t> cursors;
+    std::vector<float> times;
+    std::vector<float> values[4];
+
+    // one lane per driver, padded to the SIMD width
+    std::vector<float> factors;
+    std::vector<float> from[4];
+    std::vector<float> to[4];
+    std::vector<float> results[4];
+};
+
+// evaluates all animated channels in batches, lanes are drivers so SSE handles 4 and AVX2 8 channels at once
+class AnimationEvaluator
+{
+private:
+    std::vector<AnimationChannelGroup> groups;
+
+    void evaluateGroup(AnimationChannelGroup &group, float time);
+
+public:
+    void clear();
+    bool empty() const;
+    void addChannel(DriverChannel channel, Interpolation interpolation, const std::vector<float> &times, const std::vector<float> &values, uint32_t target);
+    // writes every channel at time into the pose arrays, indexed by the channel target
+    void evaluate(float time, glm::vec3 *translations, glm::quat *rotations, glm::vec3 *scales);
+};
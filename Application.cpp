@@ -49,6 +49,7 @@ void Application::loadScene(const SceneStructure &structure)
     std::vector<std::string> texcoordFormats;
     std::vector<std::string> colorFormats;
     std::vector<uint32_t> instanceCounts;
+    std::vector<AABB> aabbs;
 
     bool simpleMaterial = false;
 
@@ -87,12 +88,23 @@ void Application::loadScene(const SceneStructure &structure)
             instanceCounts.push_back(meshInfo.transforms.size());
         }
 
+        if (meshInfo.mesh.bounds.has_value())
+        {
+            aabbs.push_back(meshInfo.mesh.bounds.value());
+        }
+
         for (auto transform : meshInfo.transforms)
         {
             uboSize++;
         }
     }
 
+    // only use the precomputed bounds if every mesh has them
+    if (aabbs.size() != vertexData.size())
+    {
+        aabbs.clear();
+    }
+
     // separate record environment map texture
     std::string cubemap = "";
     if (structure.environment.has_value())
@@ -100,9 +112,20 @@ void Application::loadScene(const SceneStructure &structure)
         cubemap = structure.environment.value().radiance.src;
     }
 
+    // occluders are named in the scene, the helper knows meshes by vbo index
+    std::vector<uint32_t> occluderMeshes;
+    for (size_t i = 0; i < structure.meshes.size(); ++i)
+    {
+        if (std::find(occluderNames.begin(), occluderNames.end(), structure.meshes[i].mesh.name) != occluderNames.end())
+            occluderMeshes.push_back(static_cast<uint32_t>(i));
+    }
+    if (occluderMeshes.size() != occluderNames.size())
+        std::cout << "some occluder meshes are not in the scene" << std::endl;
+    helper.setOccluderMeshes(occluderMeshes);
+
     if (simpleMaterial)
     {
-        helper.initScene(vertexData, uboSize, counts, strides, posOffsets, normalOffsets, colorOffsets, posFormats, normalFormats, colorFormats, instanceCounts, cubemap);
+        helper.initScene(vertexData, aabbs, uboSize, counts, strides, posOffsets, normalOffsets, colorOffsets, posFormats, normalFormats, colorFormats, instanceCounts, cubemap);
     }
     else
     {
@@ -111,12 +134,63 @@ void Application::loadScene(const SceneStructure &structure)
         {
             materialId.push_back(material.id);
         }
-        helper.initScene(vertexData, uboSize, counts, strides, posOffsets, normalOffsets, tangentOffsets, texcoordOffsets, colorOffsets, posFormats, normalFormats, tangentFormats, texcoordFormats, colorFormats, instanceCounts, materialId, structure.vboMaterialId, structure.vboPipelineId, structure.materialTexturePair, cubemap);
+        helper.initScene(vertexData, aabbs, uboSize, counts, strides, posOffsets, normalOffsets, tangentOffsets, texcoordOffsets, colorOffsets, posFormats, normalFormats, tangentFormats, texcoordFormats, colorFormats, instanceCounts, materialId, structure.vboMaterialId, structure.vboPipelineId, structure.materialTexturePair, cubemap);
     }
 }
 
-void Application::renderLoop(SceneStructure &structure, std::string &cameraName)
+void Application::setTemporalCulling(bool enabled)
+{
+    helper.setTemporalCulling(enabled);
+}
+
+void Application::setGpuCulling(bool enabled)
+{
+    helper.setGpuCulling(enabled);
+}
+
+void Application::setOcclusionCulling(bool enabled)
+{
+    helper.setOcclusionCulling(enabled);
+}
+
+void Application::setInstancedDrawing(bool enabled)
+{
+    helper.setInstancedDrawing(enabled);
+}
+
+void Application::setParallelRecording(bool enabled)
+{
+    helper.setParallelRecording(enabled);
+}
+
+void Application::setCommandBufferCache(bool enabled)
+{
+    helper.setCommandBufferCache(enabled);
+}
+
+void Application::setMeshletCulling(bool enabled)
+{
+    helper.setMeshletCulling(enabled);
+}
+
+void Application::setSoftwareOcclusion(bool enabled)
+{
+    helper.setSoftwareOcclusion(enabled);
+}
+
+void Application::setOccluderMeshes(const std::vector<std::string> &names)
+{
+    occluderNames = names;
+}
+
+void Application::setAutoOccluders(bool enabled)
+{
+    helper.setAutoOccluders(enabled);
+}
+
+void Application::renderLoop(SceneStructure &structure, std::string &cameraName, bool cullingStats)
 {
+    std::vector<glm::mat4> uniformData;
     while (!glfwWindowShouldClose(window))
     {
         // per-frame time logic
@@ -140,17 +214,61 @@ void Application::renderLoop(SceneStructure &structure, std::string &cameraName)
             cameraName = switchCamera(structure.cameras, cameraName);
         }
 
-        std::vector<glm::mat4> uniformData;
         glm::mat4 view;
         glm::mat4 proj;
         updateScene(structure, uniformData, view, proj, cameraName);
 
-        helper.drawFrame(window, uniformData, view, proj, freezeRendering);
+        helper.drawFrame(window, uniformData, structure.hierarchy.dirtyInstances, view, proj, freezeRendering);
+
+        if (cullingStats)
+        {
+            reportCullingStats(currentFrame);
+        }
     }
 
     vkDeviceWaitIdle(helper.getDevice());
 }
 
+void Application::reportCullingStats(float currentTime)
+{
+    const CullingStats &stats = helper.getCullingStats();
+    statsTotal.instances += stats.instances;
+    statsTotal.subtreeRejected += stats.subtreeRejected;
+    statsTotal.subtreeAccepted += stats.subtreeAccepted;
+    statsTotal.sphereRejected += stats.sphereRejected;
+    statsTotal.sphereAccepted += stats.sphereAccepted;
+    statsTotal.boxRejected += stats.boxRejected;
+    statsTotal.boxAccepted += stats.boxAccepted;
+    statsTotal.satRejected += stats.satRejected;
+    statsTotal.satAccepted += stats.satAccepted;
+    statsTotal.temporalReused += stats.temporalReused;
+    statsTotal.occlusionRejected += stats.occlusionRejected;
+    statsTotal.meshletFrustumRejected += stats.meshletFrustumRejected;
+    statsTotal.meshletBackfaceRejected += stats.meshletBackfaceRejected;
+    statsTotal.meshletAccepted += stats.meshletAccepted;
+    statsTotal.pipelineBindsElided += stats.pipelineBindsElided;
+    statsTotal.vertexInputsElided += stats.vertexInputsElided;
+    statsFrames++;
+
+    // averages per frame, once a second
+    if (currentTime - lastStatsReport < 1.0f)
+        return;
+    auto average = [&](uint32_t total)
+    { return total / statsFrames; };
+    std::cout << "culling " << average(statsTotal.instances) << " instances"
+              << ", subtree -" << average(statsTotal.subtreeRejected) << " +" << average(statsTotal.subtreeAccepted)
+              << ", sphere -" << average(statsTotal.sphereRejected) << " +" << average(statsTotal.sphereAccepted)
+              << ", box -" << average(statsTotal.boxRejected) << " +" << average(statsTotal.boxAccepted)
+              << ", sat -" << average(statsTotal.satRejected) << " +" << average(statsTotal.satAccepted)
+              << ", reused " << average(statsTotal.temporalReused)
+              << ", occluded -" << average(statsTotal.occlusionRejected)
+              << ", meshlets frustum -" << average(statsTotal.meshletFrustumRejected) << " backface -" << average(statsTotal.meshletBackfaceRejected) << " +" << average(statsTotal.meshletAccepted)
+              << ", elided pipelines " << average(statsTotal.pipelineBindsElided) << " vertex inputs " << average(statsTotal.vertexInputsElided) << std::endl;
+    statsTotal = CullingStats{};
+    statsFrames = 0;
+    lastStatsReport = currentTime;
+}
+
 void Application::initWindow(uint32_t width, uint32_t height)
 {
     glfwInit();
@@ -232,27 +350,30 @@ void Application::updateTime()
 void Application::updateScene(SceneStructure &structure, std::vector<glm::mat4> &uniformData, glm::mat4 &view, glm::mat4 &proj, std::string &cameraName)
 {
     // update scene structure based on drivers
-    structure.meshes.clear();
-    structure.cameras.clear();
-    for (auto root : structure.scene.roots)
+    SceneParser::updateTransforms(structure, currentAnimTime);
+
+    // record updated ubo, everything on the first frame and only the instances that moved afterwards
+    if (uniformData.empty())
     {
-        std::vector<glm::mat4> parentTransforms;
-        SceneParser::recordTransform(structure, std::get<Node>(structure.objects[root - 1].object), parentTransforms, currentAnimTime);
+        for (const auto &meshInfo : structure.meshes)
+        {
+            uniformData.insert(uniformData.end(), meshInfo.transforms.begin(), meshInfo.transforms.end());
+        }
     }
-
-    // record updated ubo
-    for (auto meshInfo : structure.meshes)
+    else
     {
-        for (auto transform : meshInfo.transforms)
+        // dirty instances are written in the order of the dynamic meshes
+        const TransformHierarchy &hierarchy = structure.hierarchy;
+        for (size_t i = 0; i < hierarchy.dirtyInstances.size(); ++i)
         {
-            uniformData.push_back(transform);
+            uniformData[hierarchy.dirtyInstances[i]] = hierarchy.worlds[hierarchy.meshEntries[hierarchy.dynamicMeshes[i]]];
         }
     }
 
     if (cameraName != "USER")
     {
         bool findCamera = false;
-        for (auto cameraInfo : structure.cameras)
+        for (const auto &cameraInfo : structure.cameras)
         {
             if (cameraInfo.camera.name == cameraName)
             {
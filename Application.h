@@ -26,12 +26,32 @@ public:
     ~Application();
 
     void loadScene(const SceneStructure &structure);
-    void renderLoop(SceneStructure &structure, std::string &cameraName);
+    void renderLoop(SceneStructure &structure, std::string &cameraName, bool cullingStats = false);
+    void setTemporalCulling(bool enabled);
+    // call before loadScene
+    void setGpuCulling(bool enabled);
+    // call before loadScene
+    void setOcclusionCulling(bool enabled);
+    // call before loadScene
+    void setInstancedDrawing(bool enabled);
+    // call before loadScene
+    void setParallelRecording(bool enabled);
+    // call before loadScene
+    void setCommandBufferCache(bool enabled);
+    // call before loadScene
+    void setMeshletCulling(bool enabled);
+    // call before loadScene
+    void setSoftwareOcclusion(bool enabled);
+    // call before loadScene, names of the solid meshes the software rasterizer draws as occluders
+    void setOccluderMeshes(const std::vector<std::string> &names);
+    // call before loadScene
+    void setAutoOccluders(bool enabled);
 
 private:
     GLFWwindow *window;
     bool framebufferResized = false;
     VulkanHelper helper;
+    std::vector<std::string> occluderNames;
 
     bool pause = false;
     std::optional<std::chrono::steady_clock::time_point> startAnimTime;
@@ -48,6 +68,12 @@ private:
     void updateTime();
     void updateScene(SceneStructure &structure, std::vector<glm::mat4> &uniformData, glm::mat4 &view, glm::mat4 &proj, std::string &cameraName);
 
+    // culling tier counters summed over the frames since the last report
+    CullingStats statsTotal;
+    uint32_t statsFrames = 0;
+    float lastStatsReport = 0.0f;
+    void reportCullingStats(float currentTime);
+
     std::string switchCamera(const std::vector<CameraRenderInfo> &cameras, const std::string &cameraName);
     bool switchNextCamera = false;
     bool switchPrevCamera = false;
@@ -0,0 +1,198 @@
+#include "BvhHelper.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <numeric>
+
+// instances per leaf, small enough that a crossing leaf costs only a few box tests
+const uint32_t BVH_LEAF_SIZE = 4;
+const uint32_t BVH_NO_PARENT = UINT32_MAX;
+const uint32_t ALL_PLANES = (1u << 6) - 1;
+
+static AABB merge(const AABB &a, const AABB &b)
+{
+    return AABB{.min = glm::min(a.min, b.min), .max = glm::max(a.max, b.max)};
+}
+
+void InstanceBvh::build(const std::vector<AABB> &bounds)
+{
+    nodes.clear();
+    parents.clear();
+    instances.resize(bounds.size());
+    std::iota(instances.begin(), instances.end(), 0);
+    leafOf.assign(bounds.size(), 0);
+    if (bounds.empty())
+        return;
+
+    std::vector<glm::vec3> centers(bounds.size());
+    for (size_t i = 0; i < bounds.size(); ++i)
+    {
+        centers[i] = 0.5f * (bounds[i].min + bounds[i].max);
+    }
+
+    nodes.reserve(2 * (bounds.size() / BVH_LEAF_SIZE + 1));
+    nodes.push_back(BvhNode{.first = 0, .count = static_cast<uint32_t>(bounds.size())});
+    parents.push_back(BVH_NO_PARENT);
+    buildNode(0, bounds, centers);
+    nodeFlags.assign(nodes.size(), 0);
+}
+
+void InstanceBvh::buildNode(uint32_t node, const std::vector<AABB> &bounds, const std::vector<glm::vec3> &centers)
+{
+    uint32_t first = nodes[node].first;
+    uint32_t count = nodes[node].count;
+
+    AABB box{.min = glm::vec3(FLT_MAX), .max = glm::vec3(-FLT_MAX)};
+    AABB centerBox = box;
+    for (uint32_t i = first; i < first + count; ++i)
+    {
+        box = merge(box, bounds[instances[i]]);
+        centerBox.min = glm::min(centerBox.min, centers[instances[i]]);
+        centerBox.max = glm::max(centerBox.max, centers[instances[i]]);
+    }
+    nodes[node].bounds = box;
+
+    if (count <= BVH_LEAF_SIZE)
+    {
+        for (uint32_t i = first; i < first + count; ++i)
+        {
+            leafOf[instances[i]] = node;
+        }
+        return;
+    }
+
+    // median split along the widest spread of centers, keeps the tree balanced for any scene
+    glm::vec3 spread = centerBox.max - centerBox.min;
+    int axis = spread.x > spread.y ? (spread.x > spread.z ? 0 : 2) : (spread.y > spread.z ? 1 : 2);
+    uint32_t half = count / 2;
+    std::nth_element(instances.begin() + first, instances.begin() + first + half, instances.begin() + first + count, [&](uint32_t a, uint32_t b)
+                     { return centers[a][axis] < centers[b][axis]; });
+
+    uint32_t child = static_cast<uint32_t>(nodes.size());
+    nodes[node].child = child;
+    nodes.push_back(BvhNode{.first = first, .count = half});
+    nodes.push_back(BvhNode{.first = first + half, .count = count - half});
+    parents.push_back(node);
+    parents.push_back(node);
+    buildNode(child, bounds, centers);
+    buildNode(child + 1, bounds, centers);
+}
+
+void InstanceBvh::updateNode(uint32_t node, const std::vector<AABB> &bounds)
+{
+    BvhNode &current = nodes[node];
+    if (current.child != 0)
+    {
+        current.bounds = merge(nodes[current.child].bounds, nodes[current.child + 1].bounds);
+        return;
+    }
+
+    AABB box = bounds[instances[current.first]];
+    for (uint32_t i = current.first + 1; i < current.first + current.count; ++i)
+    {
+        box = merge(box, bounds[instances[i]]);
+    }
+    current.bounds = box;
+}
+
+void InstanceBvh::refit(const std::vector<AABB> &bounds, const std::vector<uint32_t> &dirtyInstances)
+{
+    // only the paths from moved instances to the root change, the topology is kept
+    refitNodes.clear();
+    for (auto instance : dirtyInstances)
+    {
+        for (uint32_t node = leafOf[instance]; node != BVH_NO_PARENT && !nodeFlags[node]; node = parents[node])
+        {
+            nodeFlags[node] = 1;
+            refitNodes.push_back(node);
+        }
+    }
+
+    std::sort(refitNodes.begin(), refitNodes.end(), std::greater<uint32_t>());
+    for (auto node : refitNodes)
+    {
+        updateNode(node, bounds);
+        nodeFlags[node] = 0;
+    }
+}
+
+void InstanceBvh::cull(const std::array<glm::vec4, 6> &planes, const std::vector<AABB> &bounds, const std::vector<glm::vec4> &spheres, std::vector<uint32_t> &visibility, std::vector<uint32_t> &candidates, CullingStats &stats)
+{
+    visibility.assign((instances.size() + 31) / 32, 0);
+    candidates.clear();
+    stats = CullingStats{.instances = static_cast<uint32_t>(instances.size())};
+    if (nodes.empty())
+        return;
+
+    // the plane mask drops planes a parent is already fully inside of
+    stack.clear();
+    stack.emplace_back(0, ALL_PLANES);
+    while (!stack.empty())
+    {
+        auto [node, planeMask] = stack.back();
+        stack.pop_back();
+
+        const BvhNode &current = nodes[node];
+        PlaneTest result = testPlanes(planes, current.bounds, planeMask);
+        if (result == PlaneTest::T_Outside)
+        {
+            stats.subtreeRejected += current.count;
+            continue;
+        }
+
+        if (result == PlaneTest::T_Inside)
+        {
+            stats.subtreeAccepted += current.count;
+            for (uint32_t i = current.first; i < current.first + current.count; ++i)
+            {
+                visibility[instances[i] / 32] |= 1u << (instances[i] % 32);
+            }
+        }
+        else if (current.child != 0)
+        {
+            stack.emplace_back(current.child + 1, planeMask);
+            stack.emplace_back(current.child, planeMask);
+        }
+        else
+        {
+            for (uint32_t i = current.first; i < current.first + current.count; ++i)
+            {
+                uint32_t instance = instances[i];
+                uint32_t instanceMask = planeMask;
+                PlaneTest instanceResult = testPlanes(planes, spheres[instance], instanceMask);
+                if (instanceResult == PlaneTest::T_Outside)
+                {
+                    stats.sphereRejected++;
+                    continue;
+                }
+                if (instanceResult == PlaneTest::T_Inside)
+                {
+                    stats.sphereAccepted++;
+                    visibility[instance / 32] |= 1u << (instance % 32);
+                    continue;
+                }
+
+                // planes the sphere is inside of are done, the box only retests the rest
+                instanceResult = testPlanes(planes, bounds[instance], instanceMask);
+                if (instanceResult == PlaneTest::T_Outside)
+                {
+                    stats.boxRejected++;
+                }
+                else if (instanceResult == PlaneTest::T_Inside)
+                {
+                    stats.boxAccepted++;
+                    visibility[instance / 32] |= 1u << (instance % 32);
+                }
+                else
+                {
+                    candidates.push_back(instance);
+                }
+            }
+        }
+    }
+}
+
+size_t InstanceBvh::size() const
+{
+    return instances.size();
+}
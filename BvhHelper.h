@@ -0,0 +1,45 @@
+#pragma once
+
+#include "CullingHelper.h"
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+struct BvhNode
+{
+    AABB bounds{};
+    // every subtree covers a contiguous range of the instance order
+    uint32_t first = 0;
+    uint32_t count = 0;
+    uint32_t child = 0; // left child, the right one is child + 1, 0 for leaves
+};
+
+// bounding volume hierarchy over the world-space boxes of all mesh instances,
+// children are always stored after their parent so sorting nodes by descending index visits them bottom-up
+class InstanceBvh
+{
+private:
+    std::vector<BvhNode> nodes;
+    std::vector<uint32_t> parents;
+    std::vector<uint32_t> instances; // instance ids in leaf order
+    std::vector<uint32_t> leafOf;    // leaf node of every instance
+    std::vector<uint8_t> nodeFlags;
+    std::vector<uint32_t> refitNodes;
+    std::vector<std::pair<uint32_t, uint32_t>> stack;
+
+    void buildNode(uint32_t node, const std::vector<AABB> &bounds, const std::vector<glm::vec3> &centers);
+    void updateNode(uint32_t node, const std::vector<AABB> &bounds);
+
+public:
+    void build(const std::vector<AABB> &bounds);
+    // grows or shrinks the nodes above the instances that moved, bounds holds the current box of every instance
+    void refit(const std::vector<AABB> &bounds, const std::vector<uint32_t> &dirtyInstances);
+
+    // sets the visibility bit of every instance in a subtree fully inside the planes without testing it,
+    // instances of crossing leaves go through their sphere and then their box, the ones still crossing a plane
+    // are appended to candidates for an exact test
+    void cull(const std::array<glm::vec4, 6> &planes, const std::vector<AABB> &bounds, const std::vector<glm::vec4> &spheres, std::vector<uint32_t> &visibility, std::vector<uint32_t> &candidates, CullingStats &stats);
+
+    size_t size() const;
+};
@@ -1,46 +1,335 @@
 #include "CullingHelper.h"
+#include "JobSystem.h"
+#include "SimdHelper.h"
 
-AABB createAABB(const std::vector<char> &vertices, uint32_t stride, uint32_t posOffset, uint32_t normalOffset)
+#include <algorithm>
+#include <cfloat>
+#include <cstring>
+
+static void checkPositionLayout(uint32_t posOffset, uint32_t normalOffset)
 {
     if (normalOffset - posOffset != 12)
         throw std::runtime_error("failed to parse vertex position, not 4-byte data!");
+}
+
+// vertices whose whole position lies inside the buffer
+static size_t countVertices(size_t size, uint32_t stride, uint32_t posOffset)
+{
+    if (stride == 0 || size < posOffset + 3 * sizeof(float))
+        return 0;
+    return (size - posOffset - 3 * sizeof(float)) / stride + 1;
+}
 
-    float min_x = FLT_MAX, min_y = FLT_MAX, min_z = FLT_MAX;
-    float max_x = FLT_MIN, max_y = FLT_MIN, max_z = FLT_MIN;
-    for (size_t i = 0; i * stride < vertices.size(); ++i)
+static AABB boundVertices(const char *positions, size_t first, size_t last, uint32_t stride)
+{
+    AABB aabb{.min = glm::vec3(FLT_MAX), .max = glm::vec3(-FLT_MAX)};
+    size_t i = first;
+
+#if SIMD_LEVEL >= 4
+    // one unaligned 4-wide load per vertex takes x, y, z and whatever float follows, the extra lane is dropped at the end;
+    // the read stays inside the buffer for every vertex but the last because the next position is at least 12 bytes on.
+    // four vertices per step into separate accumulators so the min and max chains don't wait on each other
+    using Simd4 = SimdFloat<4>;
+    Simd4 min0(FLT_MAX), min1(FLT_MAX), min2(FLT_MAX), min3(FLT_MAX);
+    Simd4 max0(-FLT_MAX), max1(-FLT_MAX), max2(-FLT_MAX), max3(-FLT_MAX);
+    for (; i + 4 < last; i += 4)
     {
-        float pos_x = std::bit_cast<float>(std::array<char, 4>{vertices[i * stride], vertices[i * stride + 1], vertices[i * stride + 2], vertices[i * stride + 3]});
-        float pos_y = std::bit_cast<float>(std::array<char, 4>{vertices[i * stride + 4], vertices[i * stride + 5], vertices[i * stride + 6], vertices[i * stride + 7]});
-        float pos_z = std::bit_cast<float>(std::array<char, 4>{vertices[i * stride + 8], vertices[i * stride + 9], vertices[i * stride + 10], vertices[i * stride + 11]});
+        const char *vertex = positions + i * stride;
+        Simd4 a = Simd4::load(reinterpret_cast<const float *>(vertex));
+        Simd4 b = Simd4::load(reinterpret_cast<const float *>(vertex + stride));
+        Simd4 c = Simd4::load(reinterpret_cast<const float *>(vertex + 2 * stride));
+        Simd4 d = Simd4::load(reinterpret_cast<const float *>(vertex + 3 * stride));
+        min0 = min(min0, a);
+        min1 = min(min1, b);
+        min2 = min(min2, c);
+        min3 = min(min3, d);
+        max0 = max(max0, a);
+        max1 = max(max1, b);
+        max2 = max(max2, c);
+        max3 = max(max3, d);
+    }
 
-        if (pos_x < min_x)
-        {
-            min_x = pos_x;
-        }
-        else if (pos_x > max_x)
-        {
-            max_x = pos_x;
-        }
-        if (pos_y < min_y)
+    alignas(16) float lanes[2][4];
+    min(min(min0, min1), min(min2, min3)).store(lanes[0]);
+    max(max(max0, max1), max(max2, max3)).store(lanes[1]);
+    aabb.min = glm::vec3(lanes[0][0], lanes[0][1], lanes[0][2]);
+    aabb.max = glm::vec3(lanes[1][0], lanes[1][1], lanes[1][2]);
+#endif
+
+    for (; i < last; ++i)
+    {
+        glm::vec3 position;
+        std::memcpy(&position, positions + i * stride, sizeof(position));
+        aabb.min = glm::min(aabb.min, position);
+        aabb.max = glm::max(aabb.max, position);
+    }
+    return aabb;
+}
+
+AABB createAABB(const std::vector<char> &vertices, uint32_t stride, uint32_t posOffset, uint32_t normalOffset)
+{
+    return createAABB(vertices.data(), vertices.size(), stride, posOffset, normalOffset);
+}
+
+AABB createAABB(const char *vertices, size_t size, uint32_t stride, uint32_t posOffset, uint32_t normalOffset)
+{
+    checkPositionLayout(posOffset, normalOffset);
+    return boundVertices(vertices + posOffset, 0, countVertices(size, stride, posOffset), stride);
+}
+
+void createAABBs(const std::vector<VertexSource> &sources, std::vector<AABB> &aabbs)
+{
+    struct BoundsChunk
+    {
+        uint32_t source;
+        size_t first;
+        size_t last;
+    };
+
+    // every mesh is cut into chunks so one big mesh doesn't keep a single core busy while the others idle
+    std::vector<BoundsChunk> chunks;
+    for (size_t i = 0; i < sources.size(); ++i)
+    {
+        checkPositionLayout(sources[i].posOffset, sources[i].normalOffset);
+        size_t count = countVertices(sources[i].size, sources[i].stride, sources[i].posOffset);
+        for (size_t first = 0; first < count; first += AABB_CHUNK_VERTICES)
         {
-            min_y = pos_y;
+            chunks.push_back({static_cast<uint32_t>(i), first, std::min(first + AABB_CHUNK_VERTICES, count)});
         }
-        else if (pos_y > max_y)
+    }
+
+    std::vector<AABB> chunkAabbs(chunks.size());
+    JobSystem::instance().parallelFor(chunks.size(), 1, [&](size_t first, size_t last)
+                                      {
+        for (size_t i = first; i < last; ++i)
         {
-            max_y = pos_y;
-        }
-        if (pos_z < min_z)
+            const VertexSource &source = sources[chunks[i].source];
+            chunkAabbs[i] = boundVertices(source.vertices + source.posOffset, chunks[i].first, chunks[i].last, source.stride);
+        } });
+
+    // empty meshes keep the inverted box, same as the single mesh version
+    aabbs.assign(sources.size(), AABB{.min = glm::vec3(FLT_MAX), .max = glm::vec3(-FLT_MAX)});
+    for (size_t i = 0; i < chunks.size(); ++i)
+    {
+        AABB &aabb = aabbs[chunks[i].source];
+        aabb.min = glm::min(aabb.min, chunkAabbs[i].min);
+        aabb.max = glm::max(aabb.max, chunkAabbs[i].max);
+    }
+}
+
+AABB transformAABB(const glm::mat4 &transform, const AABB &aabb)
+{
+    glm::vec3 center = glm::vec3(transform * glm::vec4(0.5f * (aabb.min + aabb.max), 1.0f));
+    glm::vec3 extents = 0.5f * (aabb.max - aabb.min);
+    glm::vec3 worldExtents = glm::abs(glm::vec3(transform[0])) * extents.x + glm::abs(glm::vec3(transform[1])) * extents.y + glm::abs(glm::vec3(transform[2])) * extents.z;
+    return AABB{.min = center - worldExtents, .max = center + worldExtents};
+}
+
+glm::vec4 transformBoundingSphere(const glm::mat4 &transform, const AABB &aabb)
+{
+    glm::vec3 center = glm::vec3(transform * glm::vec4(0.5f * (aabb.min + aabb.max), 1.0f));
+    float scale = std::max(glm::length(glm::vec3(transform[0])), std::max(glm::length(glm::vec3(transform[1])), glm::length(glm::vec3(transform[2]))));
+    return glm::vec4(center, 0.5f * glm::length(aabb.max - aabb.min) * scale);
+}
+
+std::array<glm::vec4, 6> getFrustumPlanes(const CullingFrustum &frustum, const glm::mat4 &view)
+{
+    float x_near = frustum.near_right;
+    float y_near = frustum.near_top;
+    float z_near = frustum.near_plane;
+    float z_far = frustum.far_plane;
+
+    // view space, the camera looks down -z and both plane distances are negative
+    std::array<glm::vec4, 6> planes = {
+        glm::vec4(0.0f, 0.0f, -1.0f, z_near),    // Near plane
+        glm::vec4(0.0f, 0.0f, 1.0f, -z_far),     // Far plane
+        glm::vec4(-z_near, 0.0f, -x_near, 0.0f), // Left plane
+        glm::vec4(z_near, 0.0f, -x_near, 0.0f),  // Right plane
+        glm::vec4(0.0f, z_near, -y_near, 0.0f),  // Top plane
+        glm::vec4(0.0f, -z_near, -y_near, 0.0f), // Bottom plane
+    };
+
+    // dot(n, view * p) == dot(transpose(view) * n, p)
+    glm::mat4 toWorld = glm::transpose(view);
+    for (auto &plane : planes)
+    {
+        plane = toWorld * plane;
+        plane /= glm::length(glm::vec3(plane));
+    }
+    return planes;
+}
+
+PlaneTest testPlanes(const std::array<glm::vec4, 6> &planes, const AABB &aabb, uint32_t &planeMask)
+{
+    glm::vec3 center = 0.5f * (aabb.min + aabb.max);
+    glm::vec3 extents = 0.5f * (aabb.max - aabb.min);
+    for (uint32_t i = 0; i < planes.size(); ++i)
+    {
+        if (!(planeMask & (1u << i)))
+            continue;
+
+        glm::vec3 normal = glm::vec3(planes[i]);
+        float distance = glm::dot(normal, center) + planes[i].w;
+        float radius = glm::dot(glm::abs(normal), extents);
+        if (distance + radius < 0.0f)
+            return PlaneTest::T_Outside;
+        if (distance - radius >= 0.0f)
+            planeMask &= ~(1u << i);
+    }
+    return planeMask == 0 ? PlaneTest::T_Inside : PlaneTest::T_Intersecting;
+}
+
+PlaneTest testPlanes(const std::array<glm::vec4, 6> &planes, const glm::vec4 &sphere, uint32_t &planeMask)
+{
+    for (uint32_t i = 0; i < planes.size(); ++i)
+    {
+        if (!(planeMask & (1u << i)))
+            continue;
+
+        float distance = glm::dot(glm::vec3(planes[i]), glm::vec3(sphere)) + planes[i].w;
+        if (distance < -sphere.w)
+            return PlaneTest::T_Outside;
+        if (distance >= sphere.w)
+            planeMask &= ~(1u << i);
+    }
+    return planeMask == 0 ? PlaneTest::T_Inside : PlaneTest::T_Intersecting;
+}
+
+void TemporalCuller::resize(size_t count)
+{
+    margins.assign(count, -1.0f);
+    reaches.assign(count, 0.0f);
+    retests.clear();
+    hasReference = false;
+}
+
+void TemporalCuller::invalidate(const std::vector<uint32_t> &dirtyInstances)
+{
+    for (auto instance : dirtyInstances)
+    {
+        margins[instance] = -1.0f;
+    }
+    retests.insert(retests.end(), dirtyInstances.begin(), dirtyInstances.end());
+}
+
+void TemporalCuller::retest(uint32_t instance, const std::array<glm::vec4, 6> &planes, float shift, float tilt, const std::vector<AABB> &bounds, const std::vector<glm::vec4> &spheres, std::vector<uint32_t> &visibility, std::vector<uint32_t> &candidates, CullingStats &stats)
+{
+    const glm::vec4 &sphere = spheres[instance];
+    float radius = sphere.w;
+    reaches[instance] = glm::length(glm::vec3(sphere) - referencePosition) + radius;
+    float motion = shift + tilt * reaches[instance];
+
+    // margin of a rejection is how far the sphere is outside its best plane, of an acceptance how far inside the closest one,
+    // both are stored relative to the reference planes
+    float outside = 0.0f;
+    float inside = FLT_MAX;
+    for (const auto &plane : planes)
+    {
+        float distance = glm::dot(glm::vec3(plane), glm::vec3(sphere)) + plane.w;
+        outside = std::max(outside, -distance - radius);
+        inside = std::min(inside, distance - radius);
+    }
+
+    uint32_t bit = 1u << (instance % 32);
+    if (outside > 0.0f)
+    {
+        stats.sphereRejected++;
+        visibility[instance / 32] &= ~bit;
+        margins[instance] = outside - motion;
+        return;
+    }
+    if (inside >= 0.0f)
+    {
+        stats.sphereAccepted++;
+        visibility[instance / 32] |= bit;
+        margins[instance] = inside - motion;
+        return;
+    }
+
+    // the box and exact tests have no cheap margin, these instances are retested every frame
+    margins[instance] = -1.0f;
+    nextRetests.push_back(instance);
+    uint32_t planeMask = (1u << 6) - 1;
+    PlaneTest result = testPlanes(planes, bounds[instance], planeMask);
+    if (result == PlaneTest::T_Outside)
+    {
+        stats.boxRejected++;
+        visibility[instance / 32] &= ~bit;
+    }
+    else if (result == PlaneTest::T_Inside)
+    {
+        stats.boxAccepted++;
+        visibility[instance / 32] |= bit;
+    }
+    else
+    {
+        visibility[instance / 32] &= ~bit;
+        candidates.push_back(instance);
+    }
+}
+
+void TemporalCuller::cull(const std::array<glm::vec4, 6> &planes, const glm::vec3 &position, const std::vector<AABB> &bounds, const std::vector<glm::vec4> &spheres, std::vector<uint32_t> &visibility, std::vector<uint32_t> &candidates, CullingStats &stats)
+{
+    candidates.clear();
+    nextRetests.clear();
+    stats = CullingStats{.instances = static_cast<uint32_t>(margins.size())};
+    visibility.resize((margins.size() + 31) / 32, 0);
+
+    // start over from the current camera once camera motion alone expires too many cached results
+    if (!hasReference || lastExpired > margins.size() / 4)
+    {
+        referencePlanes = planes;
+        referencePosition = position;
+        hasReference = true;
+        std::fill(margins.begin(), margins.end(), -1.0f);
+        lastPlanes = {};
+    }
+
+    // the camera did not move, only the instances without a margin need work
+    if (planes == lastPlanes)
+    {
+        std::sort(retests.begin(), retests.end());
+        retests.erase(std::unique(retests.begin(), retests.end()), retests.end());
+        float shift = 0.0f, tilt = 0.0f;
+        computeMotion(planes, shift, tilt);
+        for (auto instance : retests)
         {
-            min_z = pos_z;
+            retest(instance, planes, shift, tilt, bounds, spheres, visibility, candidates, stats);
         }
-        else if (pos_z > max_z)
+        stats.temporalReused = stats.instances - static_cast<uint32_t>(retests.size());
+        std::swap(retests, nextRetests);
+        return;
+    }
+    lastPlanes = planes;
+
+    float shift = 0.0f, tilt = 0.0f;
+    computeMotion(planes, shift, tilt);
+    lastExpired = 0;
+    for (uint32_t instance = 0; instance < margins.size(); ++instance)
+    {
+        if (shift + tilt * reaches[instance] < margins[instance])
         {
-            max_z = pos_z;
+            stats.temporalReused++;
+            continue;
         }
+        if (margins[instance] >= 0.0f)
+            lastExpired++;
+        retest(instance, planes, shift, tilt, bounds, spheres, visibility, candidates, stats);
     }
+    std::swap(retests, nextRetests);
+}
 
-    AABB aabb{.min = glm::vec3(min_x, min_y, min_z), .max = glm::vec3(max_x, max_y, max_z)};
-    return aabb;
+void TemporalCuller::computeMotion(const std::array<glm::vec4, 6> &planes, float &shift, float &tilt) const
+{
+    // a point within reach of the reference position moved at most shift + tilt * reach relative to any plane
+    shift = 0.0f;
+    tilt = 0.0f;
+    for (size_t i = 0; i < planes.size(); ++i)
+    {
+        glm::vec4 delta = planes[i] - referencePlanes[i];
+        shift = std::max(shift, std::abs(glm::dot(glm::vec3(delta), referencePosition) + delta.w));
+        tilt = std::max(tilt, glm::length(glm::vec3(delta)));
+    }
 }
 
 bool test_using_separating_axis_theorem(const CullingFrustum &frustum, const glm::mat4 &vs_transform, const AABB &aabb)
@@ -319,4 +608,165 @@ bool test_using_separating_axis_theorem(const CullingFrustum &frustum, const glm
 
     // No intersections detected
     return true;
-};
\ No newline at end of file
+};
+
+template <uint32_t W>
+struct SimdVec3
+{
+    SimdFloat<W> x, y, z;
+};
+
+template <uint32_t W>
+static SimdFloat<W> dot(const SimdVec3<W> &a, const SimdVec3<W> &b)
+{
+    return fmadd(a.x, b.x, fmadd(a.y, b.y, a.z * b.z));
+}
+
+template <uint32_t W>
+struct SimdObb
+{
+    SimdVec3<W> center;
+    SimdVec3<W> axes[3];
+    SimdFloat<W> extents[3];
+};
+
+// lanes where the projection [MoC - radius, MoC + radius] of the obb on axis M misses the frustum's, same math as the scalar test
+template <uint32_t W>
+static typename SimdFloat<W>::Mask separated(const CullingFrustum &frustum, const SimdVec3<W> &M, SimdFloat<W> MoC, SimdFloat<W> radius)
+{
+    using Simd = SimdFloat<W>;
+    Simd zNear(frustum.near_plane);
+    Simd ratio(frustum.far_plane / frustum.near_plane);
+
+    Simd p = fmadd(Simd(frustum.near_right), abs(M.x), Simd(frustum.near_top) * abs(M.y));
+    Simd tau_0 = zNear * M.z - p;
+    Simd tau_1 = zNear * M.z + p;
+    tau_0 = select(tau_0 < Simd(0.0f), tau_0 * ratio, tau_0);
+    tau_1 = select(tau_1 > Simd(0.0f), tau_1 * ratio, tau_1);
+
+    return (MoC - radius > tau_1) | (MoC + radius < tau_0);
+}
+
+template <uint32_t W>
+static typename SimdFloat<W>::Mask separated(const CullingFrustum &frustum, const SimdObb<W> &obb, const SimdVec3<W> &M)
+{
+    SimdFloat<W> radius = abs(dot(M, obb.axes[0])) * obb.extents[0];
+    radius = fmadd(abs(dot(M, obb.axes[1])), obb.extents[1], radius);
+    radius = fmadd(abs(dot(M, obb.axes[2])), obb.extents[2], radius);
+    return separated(frustum, M, dot(M, obb.center), radius);
+}
+
+template <uint32_t W>
+static uint32_t cullBatch(const CullingFrustum &frustum, const glm::mat4 *vs_transforms, const AABB *aabbs, uint32_t lanes)
+{
+    using Simd = SimdFloat<W>;
+
+    // transpose the batch into one float per lane, the tail repeats the last instance
+    alignas(64) float columns[4][3][W];
+    alignas(64) float mins[3][W];
+    alignas(64) float sizes[3][W];
+    for (uint32_t lane = 0; lane < W; ++lane)
+    {
+        uint32_t i = lane < lanes ? lane : lanes - 1;
+        for (int c = 0; c < 4; ++c)
+        {
+            for (int r = 0; r < 3; ++r)
+            {
+                columns[c][r][lane] = vs_transforms[i][c][r];
+            }
+        }
+        for (int r = 0; r < 3; ++r)
+        {
+            mins[r][lane] = aabbs[i].min[r];
+            sizes[r][lane] = aabbs[i].max[r] - aabbs[i].min[r];
+        }
+    }
+
+    // corner 0 and the three edges leaving it, the transform is affine so each edge is a scaled column
+    SimdObb<W> obb;
+    Simd min[3] = {Simd::load(mins[0]), Simd::load(mins[1]), Simd::load(mins[2])};
+    Simd corner[3];
+    for (int r = 0; r < 3; ++r)
+    {
+        Simd value = Simd::load(columns[3][r]);
+        for (int c = 0; c < 3; ++c)
+        {
+            value = fmadd(Simd::load(columns[c][r]), min[c], value);
+        }
+        corner[r] = value;
+    }
+    for (int a = 0; a < 3; ++a)
+    {
+        Simd size = Simd::load(sizes[a]);
+        obb.axes[a] = {Simd::load(columns[a][0]) * size, Simd::load(columns[a][1]) * size, Simd::load(columns[a][2]) * size};
+    }
+
+    Simd half(0.5f);
+    obb.center.x = fmadd(obb.axes[0].x + obb.axes[1].x + obb.axes[2].x, half, corner[0]);
+    obb.center.y = fmadd(obb.axes[0].y + obb.axes[1].y + obb.axes[2].y, half, corner[1]);
+    obb.center.z = fmadd(obb.axes[0].z + obb.axes[1].z + obb.axes[2].z, half, corner[2]);
+    for (int a = 0; a < 3; ++a)
+    {
+        Simd length = sqrt(dot(obb.axes[a], obb.axes[a]));
+        obb.axes[a] = {obb.axes[a].x / length, obb.axes[a].y / length, obb.axes[a].z / length};
+        obb.extents[a] = length * half;
+    }
+
+    uint32_t all = (W >= 32 ? 0u : (1u << W)) - 1u;
+    Simd zero(0.0f);
+    float x_near = frustum.near_right;
+    float y_near = frustum.near_top;
+    float z_near = frustum.near_plane;
+
+    // near and far, then the four side planes
+    typename Simd::Mask culled = separated(frustum, obb, SimdVec3<W>{zero, zero, Simd(1.0f)});
+    const glm::vec3 planes[] = {{z_near, 0.0f, x_near}, {-z_near, 0.0f, x_near}, {0.0f, -z_near, y_near}, {0.0f, z_near, y_near}};
+    for (const auto &plane : planes)
+    {
+        culled = culled | separated(frustum, obb, SimdVec3<W>{Simd(plane.x), Simd(plane.y), Simd(plane.z)});
+    }
+    if (culled.bits() == all)
+        return 0;
+
+    // obb axes, then R x A_i and U x A_i
+    for (int a = 0; a < 3; ++a)
+    {
+        const SimdVec3<W> &A = obb.axes[a];
+        culled = culled | separated(frustum, A, dot(A, obb.center), obb.extents[a]);
+        culled = culled | separated(frustum, obb, SimdVec3<W>{zero, -A.z, A.y});
+        culled = culled | separated(frustum, obb, SimdVec3<W>{A.z, zero, -A.x});
+    }
+    if (culled.bits() == all)
+        return 0;
+
+    // frustum edges x A_i, skipping lanes where the cross product vanishes
+    const glm::vec3 edges[] = {{-x_near, 0.0f, z_near}, {x_near, 0.0f, z_near}, {0.0f, y_near, z_near}, {0.0f, -y_near, z_near}};
+    Simd epsilon(1e-4f);
+    for (int a = 0; a < 3; ++a)
+    {
+        const SimdVec3<W> &A = obb.axes[a];
+        for (const auto &edge : edges)
+        {
+            Simd ex(edge.x), ey(edge.y), ez(edge.z);
+            SimdVec3<W> M = {ey * A.z - ez * A.y, ez * A.x - ex * A.z, ex * A.y - ey * A.x};
+            auto valid = (abs(M.x) >= epsilon) | (abs(M.y) >= epsilon) | (abs(M.z) >= epsilon);
+            culled = culled | (separated(frustum, obb, M) & valid);
+        }
+    }
+
+    return ~culled.bits() & (lanes >= 32 ? ~0u : (1u << lanes) - 1u);
+}
+
+void cullInstances(const CullingFrustum &frustum, const glm::mat4 *vs_transforms, const AABB *aabbs, size_t count, uint32_t *visibility)
+{
+    for (size_t i = 0; i < (count + 31) / 32; ++i)
+    {
+        visibility[i] = 0;
+    }
+    for (size_t i = 0; i < count; i += SIMD_WIDTH)
+    {
+        uint32_t lanes = static_cast<uint32_t>(std::min<size_t>(SIMD_WIDTH, count - i));
+        uint32_t bits = cullBatch<SIMD_WIDTH>(frustum, vs_transforms + i, aabbs + i, lanes);
+        visibility[i / 32] |= bits << (i % 32);
+    }
+}
@@ -31,6 +31,96 @@ struct OBB
     glm::vec3 axes[3] = {};
 };
 
+// vertices per bounds job, meshes above that are split and their partial bounds merged
+const size_t AABB_CHUNK_VERTICES = 1 << 16;
+
+// interleaved vertex data of one mesh, the position is three floats at posOffset of every stride bytes
+struct VertexSource
+{
+    const char *vertices = nullptr;
+    size_t size = 0;
+    uint32_t stride = 0;
+    uint32_t posOffset = 0;
+    uint32_t normalOffset = 0;
+};
+
 AABB createAABB(const std::vector<char> &vertices, uint32_t stride, uint32_t posOffset, uint32_t normalOffset);
+AABB createAABB(const char *vertices, size_t size, uint32_t stride, uint32_t posOffset, uint32_t normalOffset);
+// bounds of all meshes in one parallel pass, aabbs[i] belongs to sources[i]
+void createAABBs(const std::vector<VertexSource> &sources, std::vector<AABB> &aabbs);
+
+// instances resolved by each culling tier in one frame, cheapest tier first
+struct CullingStats
+{
+    uint32_t instances = 0;
+    uint32_t subtreeRejected = 0;
+    uint32_t subtreeAccepted = 0;
+    uint32_t sphereRejected = 0;
+    uint32_t sphereAccepted = 0;
+    uint32_t boxRejected = 0;
+    uint32_t boxAccepted = 0;
+    uint32_t satRejected = 0;
+    uint32_t satAccepted = 0;
+    uint32_t temporalReused = 0;    // cached results still valid for the current camera
+    uint32_t occlusionRejected = 0; // frustum-visible draws skipped behind last frame's depth
+    uint32_t meshletFrustumRejected = 0; // meshlets of drawn instances, only counted with meshlet culling
+    uint32_t meshletBackfaceRejected = 0;
+    uint32_t meshletAccepted = 0;
+    uint32_t pipelineBindsElided = 0; // binds the render queue order made redundant while recording
+    uint32_t vertexInputsElided = 0;
+};
+
+// box around the transformed box, used for the world-space bounds of instances
+AABB transformAABB(const glm::mat4 &transform, const AABB &aabb);
+// sphere around the transformed box as center and radius, tighter than the world box for rotated instances
+glm::vec4 transformBoundingSphere(const glm::mat4 &transform, const AABB &aabb);
+
+enum class PlaneTest
+{
+    T_Outside,
+    T_Intersecting,
+    T_Inside
+};
+
+// normalized world-space planes of the view-space frustum, dot(n, vec4(p, 1)) is the signed distance of p to plane n
+std::array<glm::vec4, 6> getFrustumPlanes(const CullingFrustum &frustum, const glm::mat4 &view);
+// planeMask has bit i set for the planes still to test, the ones the volume is fully inside are cleared
+PlaneTest testPlanes(const std::array<glm::vec4, 6> &planes, const AABB &aabb, uint32_t &planeMask);
+PlaneTest testPlanes(const std::array<glm::vec4, 6> &planes, const glm::vec4 &sphere, uint32_t &planeMask);
+
+// keeps every instance's result between frames together with a safe margin, the distance its bounding sphere
+// is away from changing the result; an instance is only retested once the planes moved more than that near it
+class TemporalCuller
+{
+private:
+    // planes and camera position the margins are measured against
+    std::array<glm::vec4, 6> referencePlanes = {};
+    glm::vec3 referencePosition = glm::vec3(0.0f);
+    bool hasReference = false;
+    std::array<glm::vec4, 6> lastPlanes = {};
+    uint32_t lastExpired = 0; // results that had a margin but were retested because of camera motion
+
+    std::vector<float> margins; // negative means retest, instances decided by the exact test keep no margin
+    std::vector<float> reaches; // distance from the reference position to the far side of the sphere
+    // instances without a margin, the only ones a still camera has to look at
+    std::vector<uint32_t> retests;
+    std::vector<uint32_t> nextRetests;
+
+    void computeMotion(const std::array<glm::vec4, 6> &planes, float &shift, float &tilt) const;
+    void retest(uint32_t instance, const std::array<glm::vec4, 6> &planes, float shift, float tilt, const std::vector<AABB> &bounds, const std::vector<glm::vec4> &spheres, std::vector<uint32_t> &visibility, std::vector<uint32_t> &candidates, CullingStats &stats);
+
+public:
+    void resize(size_t count);
+    // instances whose bounds changed lose their cached result
+    void invalidate(const std::vector<uint32_t> &dirtyInstances);
+
+    // updates visibility in place, instances still crossing a plane after their sphere and box tests are cleared
+    // in visibility and appended to candidates, the caller sets their bits from the exact test
+    void cull(const std::array<glm::vec4, 6> &planes, const glm::vec3 &position, const std::vector<AABB> &bounds, const std::vector<glm::vec4> &spheres, std::vector<uint32_t> &visibility, std::vector<uint32_t> &candidates, CullingStats &stats);
+};
+
+bool test_using_separating_axis_theorem(const CullingFrustum &frustum, const glm::mat4 &vs_transform, const AABB &aabb);
 
-bool test_using_separating_axis_theorem(const CullingFrustum &frustum, const glm::mat4 &vs_transform, const AABB &aabb);
\ No newline at end of file
+// same test for count instances, SIMD_WIDTH at a time
+// bit i % 32 of visibility[i / 32] is set when instance i may be visible, visibility needs (count + 31) / 32 words
+void cullInstances(const CullingFrustum &frustum, const glm::mat4 *vs_transforms, const AABB *aabbs, size_t count, uint32_t *visibility);
\ No newline at end of file
@@ -0,0 +1,179 @@
+#include "JobSystem.h"
+
+#include <algorithm>
+
+JobSystem::JobSystem(uint32_t threadCount)
+{
+    // the calling thread is one of the workers
+    threadCount = std::max(threadCount, 1u);
+    ranges = std::vector<ChunkRange>(threadCount);
+    for (uint32_t i = 1; i < threadCount; ++i)
+    {
+        workers.emplace_back(&JobSystem::workerLoop, this, i - 1);
+    }
+}
+
+JobSystem::~JobSystem()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stop = true;
+    }
+    wakeCondition.notify_all();
+
+    for (auto &worker : workers)
+    {
+        worker.join();
+    }
+}
+
+JobSystem &JobSystem::instance()
+{
+    static JobSystem jobSystem;
+    return jobSystem;
+}
+
+uint32_t JobSystem::getThreadCount() const
+{
+    return static_cast<uint32_t>(workers.size()) + 1;
+}
+
+void JobSystem::parallelFor(size_t count, size_t grainSize, const std::function<void(size_t, size_t)> &job)
+{
+    if (count == 0)
+        return;
+
+    grainSize = std::max<size_t>(grainSize, 1);
+    if (workers.empty() || count <= grainSize)
+    {
+        job(0, count);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        currentJob = &job;
+        jobCount = count;
+        jobGrainSize = grainSize;
+        jobException = nullptr;
+        cancelled = false;
+
+        // deal the chunks out evenly, stealing evens out whatever imbalance the work itself has
+        uint64_t chunkCount = (count + grainSize - 1) / grainSize;
+        uint64_t participants = ranges.size();
+        for (uint64_t i = 0; i < participants; ++i)
+        {
+            uint64_t begin = chunkCount * i / participants;
+            uint64_t end = chunkCount * (i + 1) / participants;
+            ranges[i].range = begin | (end << 32);
+        }
+
+        activeWorkers = static_cast<uint32_t>(workers.size());
+        generation++;
+    }
+    wakeCondition.notify_all();
+
+    runChunks(static_cast<uint32_t>(ranges.size()) - 1);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    doneCondition.wait(lock, [this]
+                       { return activeWorkers == 0; });
+    currentJob = nullptr;
+
+    if (jobException)
+        std::rethrow_exception(jobException);
+}
+
+void JobSystem::workerLoop(uint32_t index)
+{
+    uint64_t seenGeneration = 0;
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wakeCondition.wait(lock, [this, seenGeneration]
+                               { return stop || generation != seenGeneration; });
+            if (stop)
+                return;
+            seenGeneration = generation;
+        }
+
+        runChunks(index);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            activeWorkers--;
+        }
+        doneCondition.notify_one();
+    }
+}
+
+void JobSystem::runChunks(uint32_t index)
+{
+    uint64_t chunk;
+    while (popChunk(index, chunk) || (stealChunks(index) && popChunk(index, chunk)))
+    {
+        if (cancelled)
+            return;
+
+        size_t first = static_cast<size_t>(chunk) * jobGrainSize;
+        size_t last = std::min(first + jobGrainSize, jobCount);
+        try
+        {
+            (*currentJob)(first, last);
+        }
+        catch (...)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!jobException)
+                jobException = std::current_exception();
+            cancelled = true; // skip the remaining chunks
+        }
+    }
+}
+
+bool JobSystem::popChunk(uint32_t index, uint64_t &chunk)
+{
+    // the owner takes chunks from the front of its range
+    std::atomic<uint64_t> &range = ranges[index].range;
+    uint64_t current = range.load();
+    while (true)
+    {
+        uint64_t begin = current & 0xFFFFFFFF;
+        uint64_t end = current >> 32;
+        if (begin >= end)
+            return false;
+        if (range.compare_exchange_weak(current, (begin + 1) | (end << 32)))
+        {
+            chunk = begin;
+            return true;
+        }
+    }
+}
+
+bool JobSystem::stealChunks(uint32_t index)
+{
+    // thieves take the back half of another range, starting with the neighbour to spread the contention
+    uint32_t participants = static_cast<uint32_t>(ranges.size());
+    for (uint32_t offset = 1; offset < participants; ++offset)
+    {
+        std::atomic<uint64_t> &victim = ranges[(index + offset) % participants].range;
+        uint64_t current = victim.load();
+        while (true)
+        {
+            uint64_t begin = current & 0xFFFFFFFF;
+            uint64_t end = current >> 32;
+            if (begin >= end)
+                break;
+
+            uint64_t middle = end - (end - begin + 1) / 2;
+            if (victim.compare_exchange_weak(current, begin | (middle << 32)))
+            {
+                // only the owner ever adds work to its own range, and it is empty right now
+                ranges[index].range = middle | (end << 32);
+                return true;
+            }
+        }
+    }
+    return false;
+}
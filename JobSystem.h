@@ -0,0 +1,59 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// fixed pool of worker threads for data-parallel loops, the calling thread works on the loop too;
+// each participant starts on its own contiguous range of chunks and steals half of another range once it runs dry
+class JobSystem
+{
+public:
+    explicit JobSystem(uint32_t threadCount = std::thread::hardware_concurrency());
+    ~JobSystem();
+
+    JobSystem(const JobSystem &) = delete;
+    JobSystem &operator=(const JobSystem &) = delete;
+
+    // process-wide pool sized to the number of hardware threads
+    static JobSystem &instance();
+
+    uint32_t getThreadCount() const;
+
+    // calls job(first, last) for chunks of at most grainSize items covering [0, count) and waits for all of them,
+    // the first exception thrown by a chunk is rethrown on the calling thread, loops must not be nested
+    void parallelFor(size_t count, size_t grainSize, const std::function<void(size_t, size_t)> &job);
+
+private:
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wakeCondition;
+    std::condition_variable doneCondition;
+    bool stop = false;
+
+    // chunk range [begin, end) of one participant packed as begin | end << 32, so owner and thieves update it with one CAS
+    struct alignas(64) ChunkRange
+    {
+        std::atomic<uint64_t> range = 0;
+    };
+
+    // the loop currently being processed
+    const std::function<void(size_t, size_t)> *currentJob = nullptr;
+    size_t jobCount = 0;
+    size_t jobGrainSize = 1;
+    std::vector<ChunkRange> ranges; // one per participant, the calling thread uses the last one
+    std::atomic<bool> cancelled = false;
+    uint64_t generation = 0;
+    uint32_t activeWorkers = 0;
+    std::exception_ptr jobException;
+
+    void workerLoop(uint32_t index);
+    void runChunks(uint32_t index);
+    bool popChunk(uint32_t index, uint64_t &chunk);
+    bool stealChunks(uint32_t index);
+};
@@ -0,0 +1,128 @@
+#include "MeshletHelper.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cstring>
+
+// spreads the low 10 bits of value to every third bit
+static uint32_t expandBits(uint32_t value)
+{
+    value = (value | (value << 16)) & 0x030000ffu;
+    value = (value | (value << 8)) & 0x0300f00fu;
+    value = (value | (value << 4)) & 0x030c30c3u;
+    value = (value | (value << 2)) & 0x09249249u;
+    return value;
+}
+
+static glm::vec3 readPosition(const VertexSource &source, size_t vertex)
+{
+    glm::vec3 position;
+    std::memcpy(&position, source.vertices + vertex * source.stride + source.posOffset, sizeof(position));
+    return position;
+}
+
+void buildMeshlets(const VertexSource &source, uint32_t vertexCount, std::vector<char> &reordered, std::vector<Meshlet> &meshlets)
+{
+    if (static_cast<size_t>(vertexCount) * source.stride > source.size)
+        throw std::runtime_error("failed to build meshlets, vertex data is shorter than the mesh!");
+
+    uint32_t triangleCount = vertexCount / 3;
+    std::vector<glm::vec3> centers(triangleCount);
+    AABB bounds{.min = glm::vec3(FLT_MAX), .max = glm::vec3(-FLT_MAX)};
+    for (uint32_t i = 0; i < triangleCount; ++i)
+    {
+        centers[i] = (readPosition(source, i * 3) + readPosition(source, i * 3 + 1) + readPosition(source, i * 3 + 2)) / 3.0f;
+        bounds.min = glm::min(bounds.min, centers[i]);
+        bounds.max = glm::max(bounds.max, centers[i]);
+    }
+
+    // 10 bits per axis of the triangle center inside the mesh bounds, the triangle index breaks ties
+    glm::vec3 scale = 1023.0f / glm::max(bounds.max - bounds.min, glm::vec3(FLT_MIN));
+    std::vector<uint64_t> keys(triangleCount);
+    for (uint32_t i = 0; i < triangleCount; ++i)
+    {
+        glm::uvec3 cell = glm::uvec3(glm::clamp((centers[i] - bounds.min) * scale, 0.0f, 1023.0f));
+        uint32_t code = expandBits(cell.x) << 2 | expandBits(cell.y) << 1 | expandBits(cell.z);
+        keys[i] = static_cast<uint64_t>(code) << 32 | i;
+    }
+    std::sort(keys.begin(), keys.end());
+
+    size_t triangleSize = 3 * static_cast<size_t>(source.stride);
+    reordered.resize(static_cast<size_t>(vertexCount) * source.stride);
+    for (uint32_t i = 0; i < triangleCount; ++i)
+    {
+        uint32_t triangle = static_cast<uint32_t>(keys[i]);
+        std::memcpy(reordered.data() + i * triangleSize, source.vertices + triangle * triangleSize, triangleSize);
+    }
+    // a trailing partial triangle is never drawn but stays in place
+    std::memcpy(reordered.data() + triangleCount * triangleSize, source.vertices + triangleCount * triangleSize, (vertexCount - triangleCount * 3) * static_cast<size_t>(source.stride));
+
+    VertexSource sorted = source;
+    sorted.vertices = reordered.data();
+    sorted.size = reordered.size();
+
+    meshlets.clear();
+    std::vector<glm::vec3> normals;
+    for (uint32_t first = 0; first < triangleCount; first += MESHLET_TRIANGLES)
+    {
+        uint32_t last = std::min(first + MESHLET_TRIANGLES, triangleCount);
+        Meshlet meshlet;
+        meshlet.firstVertex = first * 3;
+        meshlet.vertexCount = (last - first) * 3;
+        meshlet.bounds = AABB{.min = glm::vec3(FLT_MAX), .max = glm::vec3(-FLT_MAX)};
+
+        normals.clear();
+        glm::vec3 normalSum = glm::vec3(0.0f);
+        for (uint32_t i = first; i < last; ++i)
+        {
+            glm::vec3 a = readPosition(sorted, i * 3);
+            glm::vec3 b = readPosition(sorted, i * 3 + 1);
+            glm::vec3 c = readPosition(sorted, i * 3 + 2);
+            meshlet.bounds.min = glm::min(meshlet.bounds.min, glm::min(a, glm::min(b, c)));
+            meshlet.bounds.max = glm::max(meshlet.bounds.max, glm::max(a, glm::max(b, c)));
+
+            // degenerate triangles produce no fragments, they don't widen the cone
+            glm::vec3 normal = glm::cross(b - a, c - a);
+            float length = glm::length(normal);
+            if (length > 0.0f)
+            {
+                normals.push_back(normal / length);
+                normalSum += normals.back();
+            }
+        }
+
+        float sumLength = glm::length(normalSum);
+        if (sumLength > 0.0f)
+        {
+            meshlet.coneAxis = normalSum / sumLength;
+            meshlet.coneCos = 1.0f;
+            for (const auto &normal : normals)
+            {
+                meshlet.coneCos = std::min(meshlet.coneCos, glm::dot(normal, meshlet.coneAxis));
+            }
+        }
+        meshlets.push_back(meshlet);
+    }
+}
+
+bool isBackfacing(const Meshlet &meshlet, glm::vec3 cameraPosition, bool mirrored)
+{
+    if (meshlet.coneCos <= 0.0f)
+        return false;
+
+    // every point p of the meshlet is within radius of the center and every normal n within the cone angle theta
+    // of the axis, so dot(p - camera, n) >= distance * cos(alpha + theta) - radius with alpha the angle between
+    // the view direction and the axis; the meshlet is backfacing where that bound is positive
+    glm::vec3 center = 0.5f * (meshlet.bounds.min + meshlet.bounds.max);
+    float radius = 0.5f * glm::length(meshlet.bounds.max - meshlet.bounds.min);
+    glm::vec3 view = center - cameraPosition;
+    float distance = glm::length(view);
+    if (distance <= radius)
+        return false;
+
+    glm::vec3 axis = mirrored ? -meshlet.coneAxis : meshlet.coneAxis;
+    float cosAlpha = glm::dot(view, axis) / distance;
+    float sinAlpha = std::sqrt(std::max(0.0f, 1.0f - cosAlpha * cosAlpha));
+    float sinTheta = std::sqrt(std::max(0.0f, 1.0f - meshlet.coneCos * meshlet.coneCos));
+    return cosAlpha * meshlet.coneCos - sinAlpha * sinTheta > radius / distance;
+}
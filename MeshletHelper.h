@@ -0,0 +1,27 @@
+#pragma once
+
+#include "CullingHelper.h"
+
+#include <cstdint>
+#include <vector>
+
+// triangles per meshlet, a draw for each visible run of meshlets keeps the call count low
+const uint32_t MESHLET_TRIANGLES = 128;
+
+// contiguous run of triangles of a non-indexed triangle list with its own bounds and normal cone
+struct Meshlet
+{
+    uint32_t firstVertex = 0;
+    uint32_t vertexCount = 0;
+    AABB bounds;
+    glm::vec3 coneAxis = glm::vec3(0.0f);
+    float coneCos = -1.0f; // cosine of the cone half angle, not positive when the normals span a half space or more
+};
+
+// reorders the first vertexCount vertices of source along a morton curve of the triangle centers, so that the
+// meshlets cut from consecutive triangles are compact; reordered receives the vertex data to upload in their place
+void buildMeshlets(const VertexSource &source, uint32_t vertexCount, std::vector<char> &reordered, std::vector<Meshlet> &meshlets);
+
+// true if every triangle of the meshlet faces away from cameraPosition, given in the meshlet's object space;
+// mirrored is set for transforms with a negative determinant, they swap the winding the rasterizer sees
+bool isBackfacing(const Meshlet &meshlet, glm::vec3 cameraPosition, bool mirrored);
@@ -0,0 +1,389 @@
+#include "OcclusionHelper.h"
+#include "JobSystem.h"
+#include "SimdHelper.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+// rows of the finest level per job when the depth buffer is downsampled
+const size_t HIZ_GRAIN_SIZE = 16;
+
+using SimdNative = SimdFloat<SIMD_WIDTH>;
+
+// offsets of the pixels handled by one vector, the scalar build only uses the first
+alignas(64) static const float LANE_OFFSETS[16] = {0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f, 8.0f, 9.0f, 10.0f, 11.0f, 12.0f, 13.0f, 14.0f, 15.0f};
+
+// two triangles per box face, corner bits are x, y, z
+static const uint8_t BOX_TRIANGLES[12][3] = {
+    {0, 2, 3}, {0, 3, 1}, {4, 5, 7}, {4, 7, 6}, // -z, +z
+    {0, 1, 5}, {0, 5, 4}, {2, 6, 7}, {2, 7, 3}, // -y, +y
+    {0, 4, 6}, {0, 6, 2}, {1, 3, 7}, {1, 7, 5}  // -x, +x
+};
+
+void HiZBuffer::build(const float *depth, uint32_t width, uint32_t height, const glm::mat4 &sourceViewProj, const glm::mat4 &targetViewProj)
+{
+    uint32_t baseWidth = std::min(HIZ_BASE_WIDTH, width);
+    uint32_t baseHeight = std::max(1u, static_cast<uint32_t>(static_cast<uint64_t>(height) * baseWidth / width));
+    baseHeight = std::min(baseHeight, height);
+    viewProj = targetViewProj;
+
+    // depth range of every source block first, so each reprojected footprint is conservative for its whole block
+    downsampled.resize(static_cast<size_t>(baseWidth) * baseHeight);
+    JobSystem::instance().parallelFor(baseHeight, HIZ_GRAIN_SIZE, [&](size_t first, size_t last)
+                                      {
+        for (size_t by = first; by < last; ++by)
+        {
+            size_t y0 = by * height / baseHeight, y1 = (by + 1) * height / baseHeight;
+            for (size_t bx = 0; bx < baseWidth; ++bx)
+            {
+                size_t x0 = bx * width / baseWidth, x1 = (bx + 1) * width / baseWidth;
+                float nearest = 1.0f, farthest = 0.0f;
+                for (size_t y = y0; y < y1; ++y)
+                {
+                    const float *row = depth + y * width;
+                    for (size_t x = x0; x < x1; ++x)
+                    {
+                        nearest = std::min(nearest, row[x]);
+                        farthest = std::max(farthest, row[x]);
+                    }
+                }
+                downsampled[by * baseWidth + bx] = glm::vec2(nearest, std::min(farthest, 1.0f));
+            }
+        } });
+
+    // splat the whole reprojected footprint of every block, background included: the footprint bounds all 8 corners
+    // of the slab between the block's farthest depth and the nearest depth around it, so the gap that opens between a
+    // block and its neighbours as the view shifts, like a slit or a silhouette edge, is covered by the farther depth
+    widths.assign(1, baseWidth);
+    heights.assign(1, baseHeight);
+    levels.resize(1);
+    std::vector<float> &base = levels[0];
+    base.assign(downsampled.size(), -1.0f);
+    glm::mat4 sourceToTarget = targetViewProj * glm::inverse(sourceViewProj);
+    for (uint32_t by = 0; by < baseHeight; ++by)
+    {
+        for (uint32_t bx = 0; bx < baseWidth; ++bx)
+        {
+            glm::vec2 range = downsampled[by * baseWidth + bx];
+            for (uint32_t ny = std::max(by, 1u) - 1; ny < std::min(by + 2, baseHeight); ++ny)
+            {
+                for (uint32_t nx = std::max(bx, 1u) - 1; nx < std::min(bx + 2, baseWidth); ++nx)
+                    range.x = std::min(range.x, downsampled[ny * baseWidth + nx].x);
+            }
+
+            glm::vec2 low(FLT_MAX), high(-FLT_MAX);
+            float farthest = 0.0f;
+            bool valid = true;
+            for (uint32_t corner = 0; corner < 8; ++corner)
+            {
+                glm::vec4 ndc(static_cast<float>(bx + (corner & 1)) / baseWidth * 2.0f - 1.0f, static_cast<float>(by + ((corner >> 1) & 1)) / baseHeight * 2.0f - 1.0f, range[corner >> 2], 1.0f);
+                glm::vec4 clip = sourceToTarget * ndc;
+                // content in front of the new near plane can't hide anything
+                valid = clip.w > FLT_EPSILON && clip.z >= 0.0f;
+                if (!valid)
+                    break;
+                glm::vec3 projected = glm::vec3(clip) / clip.w;
+                farthest = std::max(farthest, std::min(projected.z, 1.0f));
+                low = glm::min(low, glm::vec2(projected));
+                high = glm::max(high, glm::vec2(projected));
+            }
+            if (!valid)
+                continue;
+
+            // every texel the footprint touches, even partially
+            float x0 = std::floor((low.x * 0.5f + 0.5f) * baseWidth), x1 = std::ceil((high.x * 0.5f + 0.5f) * baseWidth);
+            float y0 = std::floor((low.y * 0.5f + 0.5f) * baseHeight), y1 = std::ceil((high.y * 0.5f + 0.5f) * baseHeight);
+            if (x1 <= 0.0f || y1 <= 0.0f || x0 >= baseWidth || y0 >= baseHeight)
+                continue;
+            uint32_t tx0 = static_cast<uint32_t>(std::max(x0, 0.0f)), tx1 = static_cast<uint32_t>(std::min(x1, static_cast<float>(baseWidth)));
+            uint32_t ty0 = static_cast<uint32_t>(std::max(y0, 0.0f)), ty1 = static_cast<uint32_t>(std::min(y1, static_cast<float>(baseHeight)));
+            tx1 = std::max(tx1, tx0 + 1);
+            ty1 = std::max(ty1, ty0 + 1);
+            for (uint32_t ty = ty0; ty < ty1; ++ty)
+            {
+                float *row = base.data() + static_cast<size_t>(ty) * baseWidth;
+                for (uint32_t tx = tx0; tx < tx1; ++tx)
+                    row[tx] = std::max(row[tx], farthest);
+            }
+        }
+    }
+    for (auto &texel : base)
+    {
+        if (texel < 0.0f)
+            texel = 1.0f;
+    }
+    buildPyramid();
+}
+
+void HiZBuffer::build(const float *depth, uint32_t width, uint32_t height, const glm::mat4 &viewProj)
+{
+    this->viewProj = viewProj;
+    widths.assign(1, width);
+    heights.assign(1, height);
+    levels.resize(1);
+    levels[0].assign(depth, depth + static_cast<size_t>(width) * height);
+    buildPyramid();
+}
+
+void HiZBuffer::buildPyramid()
+{
+    levels.resize(1);
+    widths.resize(1);
+    heights.resize(1);
+
+    // every coarser texel keeps the farthest of the up to four below it
+    while (widths.back() > 1 || heights.back() > 1)
+    {
+        uint32_t fineWidth = widths.back(), fineHeight = heights.back();
+        uint32_t coarseWidth = (fineWidth + 1) / 2, coarseHeight = (fineHeight + 1) / 2;
+        std::vector<float> coarse(static_cast<size_t>(coarseWidth) * coarseHeight);
+        const std::vector<float> &fine = levels.back();
+        for (uint32_t y = 0; y < coarseHeight; ++y)
+        {
+            uint32_t y0 = 2 * y, y1 = std::min(2 * y + 1, fineHeight - 1);
+            for (uint32_t x = 0; x < coarseWidth; ++x)
+            {
+                uint32_t x0 = 2 * x, x1 = std::min(2 * x + 1, fineWidth - 1);
+                coarse[y * coarseWidth + x] = std::max(std::max(fine[y0 * fineWidth + x0], fine[y0 * fineWidth + x1]),
+                                                       std::max(fine[y1 * fineWidth + x0], fine[y1 * fineWidth + x1]));
+            }
+        }
+        levels.push_back(std::move(coarse));
+        widths.push_back(coarseWidth);
+        heights.push_back(coarseHeight);
+    }
+}
+
+bool HiZBuffer::isOccluded(const AABB &bounds) const
+{
+    if (levels.empty())
+        return false;
+
+    // corners as the projected min corner plus the projected edges, three matrix columns instead of eight products
+    glm::vec3 size = bounds.max - bounds.min;
+    glm::vec4 origin = viewProj * glm::vec4(bounds.min, 1.0f);
+    glm::vec4 edges[3] = {viewProj[0] * size.x, viewProj[1] * size.y, viewProj[2] * size.z};
+
+    glm::vec3 ndcMin(FLT_MAX), ndcMax(-FLT_MAX);
+    for (uint32_t corner = 0; corner < 8; ++corner)
+    {
+        glm::vec4 clip = origin;
+        if (corner & 1)
+            clip += edges[0];
+        if (corner & 2)
+            clip += edges[1];
+        if (corner & 4)
+            clip += edges[2];
+        // boxes reaching behind the camera are never hidden
+        if (clip.w <= FLT_EPSILON)
+            return false;
+        glm::vec3 ndc = glm::vec3(clip) / clip.w;
+        ndcMin = glm::min(ndcMin, ndc);
+        ndcMax = glm::max(ndcMax, ndc);
+    }
+    if (ndcMin.z < 0.0f)
+        return false;
+
+    // screen rectangle in texels of the finest level, grown by a texel since depth is only known at texel centers
+    float x0 = std::clamp((ndcMin.x * 0.5f + 0.5f) * widths[0] - 1.0f, 0.0f, static_cast<float>(widths[0]));
+    float x1 = std::clamp((ndcMax.x * 0.5f + 0.5f) * widths[0] + 1.0f, 0.0f, static_cast<float>(widths[0]));
+    float y0 = std::clamp((ndcMin.y * 0.5f + 0.5f) * heights[0] - 1.0f, 0.0f, static_cast<float>(heights[0]));
+    float y1 = std::clamp((ndcMax.y * 0.5f + 0.5f) * heights[0] + 1.0f, 0.0f, static_cast<float>(heights[0]));
+    if (x0 >= x1 || y0 >= y1)
+        return false;
+
+    // coarsest level where the rectangle still spans at most two texels, so only a handful are read
+    uint32_t level = 0;
+    float extent = std::max(x1 - x0, y1 - y0);
+    while (extent > 2.0f && level + 1 < levels.size())
+    {
+        extent *= 0.5f;
+        level++;
+    }
+
+    float scale = 1.0f / static_cast<float>(1u << level);
+    uint32_t tx0 = static_cast<uint32_t>(x0 * scale);
+    uint32_t ty0 = static_cast<uint32_t>(y0 * scale);
+    uint32_t tx1 = std::min(static_cast<uint32_t>(std::ceil(x1 * scale)), widths[level]);
+    uint32_t ty1 = std::min(static_cast<uint32_t>(std::ceil(y1 * scale)), heights[level]);
+    const std::vector<float> &texels = levels[level];
+    for (uint32_t y = ty0; y < ty1; ++y)
+    {
+        for (uint32_t x = tx0; x < tx1; ++x)
+        {
+            if (texels[y * widths[level] + x] >= ndcMin.z)
+                return false;
+        }
+    }
+    return true;
+}
+
+bool HiZBuffer::empty() const
+{
+    return levels.empty();
+}
+
+void OcclusionRasterizer::resize(uint32_t width, uint32_t height)
+{
+    // whole vectors per row, so a row is never written past its end
+    this->width = (std::max(width, 1u) + SIMD_WIDTH - 1) / SIMD_WIDTH * SIMD_WIDTH;
+    this->height = std::max(height, 1u);
+    depth.assign(static_cast<size_t>(this->width) * this->height, 1.0f);
+}
+
+void OcclusionRasterizer::clear(const glm::mat4 &viewProj)
+{
+    this->viewProj = viewProj;
+    std::fill(depth.begin(), depth.end(), 1.0f);
+}
+
+void OcclusionRasterizer::drawBox(const glm::mat4 &transform, const AABB &bounds)
+{
+    glm::mat4 toClip = viewProj * transform;
+    glm::vec4 corners[8];
+    for (uint32_t corner = 0; corner < 8; ++corner)
+    {
+        glm::vec3 point((corner & 1) ? bounds.max.x : bounds.min.x, (corner & 2) ? bounds.max.y : bounds.min.y, (corner & 4) ? bounds.max.z : bounds.min.z);
+        corners[corner] = toClip * glm::vec4(point, 1.0f);
+    }
+
+    for (const auto &triangle : BOX_TRIANGLES)
+    {
+        glm::vec4 clip[3] = {corners[triangle[0]], corners[triangle[1]], corners[triangle[2]]};
+        // trivially outside one of the side planes
+        if ((clip[0].x > clip[0].w && clip[1].x > clip[1].w && clip[2].x > clip[2].w) ||
+            (clip[0].x < -clip[0].w && clip[1].x < -clip[1].w && clip[2].x < -clip[2].w) ||
+            (clip[0].y > clip[0].w && clip[1].y > clip[1].w && clip[2].y > clip[2].w) ||
+            (clip[0].y < -clip[0].w && clip[1].y < -clip[1].w && clip[2].y < -clip[2].w))
+            continue;
+        drawClippedTriangle(clip);
+    }
+}
+
+void OcclusionRasterizer::drawClippedTriangle(const glm::vec4 clip[3])
+{
+    // clip against the near plane z = 0, big walls and floors usually cross it
+    glm::vec4 polygon[4];
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < 3; ++i)
+    {
+        const glm::vec4 &current = clip[i];
+        const glm::vec4 &next = clip[(i + 1) % 3];
+        if (current.z >= 0.0f)
+            polygon[count++] = current;
+        if ((current.z >= 0.0f) != (next.z >= 0.0f))
+        {
+            float t = current.z / (current.z - next.z);
+            polygon[count++] = current + t * (next - current);
+        }
+    }
+    if (count < 3)
+        return;
+
+    glm::vec3 screen[4];
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        if (polygon[i].w <= 0.0f)
+            return;
+        glm::vec3 ndc = glm::vec3(polygon[i]) / polygon[i].w;
+        screen[i] = glm::vec3((ndc.x * 0.5f + 0.5f) * width, (ndc.y * 0.5f + 0.5f) * height, ndc.z);
+    }
+    drawTriangle(screen[0], screen[1], screen[2]);
+    if (count == 4)
+        drawTriangle(screen[0], screen[2], screen[3]);
+}
+
+void OcclusionRasterizer::drawTriangle(glm::vec3 a, glm::vec3 b, glm::vec3 c)
+{
+    // both windings are drawn, the nearer side of a closed box wins the depth test anyway
+    float area = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+    if (std::abs(area) < 1e-8f)
+        return;
+    if (area < 0.0f)
+    {
+        std::swap(b, c);
+        area = -area;
+    }
+
+    // pixel centers inside the bounds, rows start on a vector boundary
+    int minX = std::max(static_cast<int>(std::floor(std::min({a.x, b.x, c.x}) - 0.5f)), 0);
+    int maxX = std::min(static_cast<int>(std::ceil(std::max({a.x, b.x, c.x}) - 0.5f)), static_cast<int>(width) - 1);
+    int minY = std::max(static_cast<int>(std::floor(std::min({a.y, b.y, c.y}) - 0.5f)), 0);
+    int maxY = std::min(static_cast<int>(std::ceil(std::max({a.y, b.y, c.y}) - 0.5f)), static_cast<int>(height) - 1);
+    if (minX > maxX || minY > maxY)
+        return;
+    minX -= minX % static_cast<int>(SIMD_WIDTH);
+
+    // edge functions and depth are linear in screen space, positive inside
+    float invArea = 1.0f / area;
+    glm::vec3 stepX(b.y - c.y, c.y - a.y, a.y - b.y);
+    glm::vec3 stepY(c.x - b.x, a.x - c.x, b.x - a.x);
+    glm::vec3 depths(a.z, b.z, c.z);
+    float depthStepX = glm::dot(stepX, depths) * invArea;
+    float depthStepY = glm::dot(stepY, depths) * invArea;
+
+    float startX = minX + 0.5f, startY = minY + 0.5f;
+    glm::vec3 start((b.x - startX) * (c.y - startY) - (b.y - startY) * (c.x - startX),
+                    (c.x - startX) * (a.y - startY) - (c.y - startY) * (a.x - startX),
+                    (a.x - startX) * (b.y - startY) - (a.y - startY) * (b.x - startX));
+    float startDepth = glm::dot(start, depths) * invArea;
+
+    SimdNative lanes = SimdNative::load(LANE_OFFSETS);
+    SimdNative zero(0.0f);
+    for (int y = minY; y <= maxY; ++y)
+    {
+        float dy = static_cast<float>(y - minY);
+        glm::vec3 rowEdges = start + dy * stepY;
+        float rowDepth = startDepth + dy * depthStepY;
+        float *row = depth.data() + static_cast<size_t>(y) * width;
+
+        for (int x = minX; x <= maxX; x += SIMD_WIDTH)
+        {
+            SimdNative dx = lanes + SimdNative(static_cast<float>(x - minX));
+            SimdNative e0 = fmadd(dx, SimdNative(stepX.x), SimdNative(rowEdges.x));
+            SimdNative e1 = fmadd(dx, SimdNative(stepX.y), SimdNative(rowEdges.y));
+            SimdNative e2 = fmadd(dx, SimdNative(stepX.z), SimdNative(rowEdges.z));
+            auto inside = (e0 >= zero) & (e1 >= zero) & (e2 >= zero);
+            if (inside.bits() == 0)
+                continue;
+
+            SimdNative z = fmadd(dx, SimdNative(depthStepX), SimdNative(rowDepth));
+            SimdNative current = SimdNative::load(row + x);
+            select(inside, min(current, z), current).store(row + x);
+        }
+    }
+}
+
+const float *OcclusionRasterizer::data() const
+{
+    return depth.data();
+}
+
+uint32_t OcclusionRasterizer::getWidth() const
+{
+    return width;
+}
+
+uint32_t OcclusionRasterizer::getHeight() const
+{
+    return height;
+}
+
+void selectOccluders(const std::vector<AABB> &worldBounds, const std::vector<uint32_t> &candidates, glm::vec3 cameraPosition, size_t count, std::vector<uint32_t> &occluders)
+{
+    occluders.assign(candidates.begin(), candidates.end());
+    if (occluders.size() <= count)
+        return;
+
+    auto score = [&](uint32_t instance)
+    {
+        const AABB &bounds = worldBounds[instance];
+        glm::vec3 size = bounds.max - bounds.min;
+        glm::vec3 offset = 0.5f * (bounds.min + bounds.max) - cameraPosition;
+        return glm::dot(size, size) / std::max(glm::dot(offset, offset), 1e-4f);
+    };
+    std::nth_element(occluders.begin(), occluders.begin() + count, occluders.end(), [&](uint32_t a, uint32_t b)
+                     { return score(a) > score(b); });
+    occluders.resize(count);
+}
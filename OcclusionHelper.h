@@ -0,0 +1,64 @@
+#pragma once
+
+#include "CullingHelper.h"
+
+#include <cstdint>
+#include <vector>
+
+// width of the finest pyramid level, the height follows the aspect ratio of the depth buffer
+const uint32_t HIZ_BASE_WIDTH = 256;
+// width of the software occlusion buffer, the height follows the aspect ratio of the swap chain
+const uint32_t OCCLUSION_RASTER_WIDTH = 256;
+
+// hierarchical-z pyramid of the farthest depth per texel, built by reprojecting an older depth buffer into the current view;
+// depth runs from 0 at the near plane to 1 at the far plane and texel rows follow the vulkan viewport, top row first
+class HiZBuffer
+{
+private:
+    std::vector<std::vector<float>> levels;
+    std::vector<uint32_t> widths;
+    std::vector<uint32_t> heights;
+    // nearest and farthest depth of every source block
+    std::vector<glm::vec2> downsampled;
+    glm::mat4 viewProj = glm::mat4(1.0f);
+
+    void buildPyramid();
+
+public:
+    // depth was rendered with sourceViewProj, the pyramid is laid out for targetViewProj;
+    // texels nothing reprojects onto stay at the far plane so they never hide anything
+    void build(const float *depth, uint32_t width, uint32_t height, const glm::mat4 &sourceViewProj, const glm::mat4 &targetViewProj);
+    // depth already rendered with viewProj at the pyramid's resolution, like the software rasterizer's
+    void build(const float *depth, uint32_t width, uint32_t height, const glm::mat4 &viewProj);
+    // true if the nearest point of the world box is behind everything in the screen rectangle it covers
+    bool isOccluded(const AABB &bounds) const;
+    bool empty() const;
+};
+
+// low resolution depth buffer the occluders are rasterized into on the cpu, SIMD_WIDTH pixels at a time;
+// occluders are drawn as their transformed boxes, so only meshes that fill their bounds hide things correctly
+class OcclusionRasterizer
+{
+private:
+    uint32_t width = 0;
+    uint32_t height = 0;
+    std::vector<float> depth;
+    glm::mat4 viewProj = glm::mat4(1.0f);
+
+    void drawClippedTriangle(const glm::vec4 clip[3]);
+    // x and y in pixels, z is the depth
+    void drawTriangle(glm::vec3 a, glm::vec3 b, glm::vec3 c);
+
+public:
+    // the width is rounded up to whole SIMD vectors
+    void resize(uint32_t width, uint32_t height);
+    void clear(const glm::mat4 &viewProj);
+    void drawBox(const glm::mat4 &transform, const AABB &bounds);
+
+    const float *data() const;
+    uint32_t getWidth() const;
+    uint32_t getHeight() const;
+};
+
+// the count candidates that likely cover the most screen, scored by world box size over distance to the camera
+void selectOccluders(const std::vector<AABB> &worldBounds, const std::vector<uint32_t> &candidates, glm::vec3 cameraPosition, size_t count, std::vector<uint32_t> &occluders);
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+// read-only memory mapping of a whole file, the pages are only read in when they are touched
+class MappedFile
+{
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+    MappedFile(MappedFile &&other) noexcept;
+    MappedFile &operator=(MappedFile &&other) noexcept;
+
+    // returns false if the file can't be mapped, the caller should fall back to reading it
+    bool open(const std::string &filename);
+    void close();
+
+    const char *data() const;
+    size_t size() const;
+    bool isOpen() const;
+
+private:
+    const char *mappedData = nullptr;
+    size_t mappedSize = 0;
+#ifdef _WIN32
+    void *fileHandle = nullptr;
+    void *mappingHandle = nullptr;
+#endif
+};
+
+// peak resident set size of the process in bytes
+size_t getPeakResidentSetSize();
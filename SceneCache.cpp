@@ -0,0 +1,752 @@
+#include "SceneCache.h"
+
+#include <cstring>
+#include <filesystem>
+#include <type_traits>
+#include <unordered_set>
+
+namespace
+{
+    const char COMPILED_SCENE_MAGIC[4] = {'S', '7', '2', 'B'};
+    const uint32_t NO_INDEX = 0xFFFFFFFF;
+    // dependency size of a file that did not exist at compile time
+    const uint64_t MISSING_FILE = 0xFFFFFFFFFFFFFFFF;
+
+    enum MaterialFlags : uint32_t
+    {
+        F_Pbr = 1 << 0,
+        F_Lambertian = 1 << 1,
+        F_Mirror = 1 << 2,
+        F_Environment = 1 << 3,
+        F_Simple = 1 << 4,
+        F_NormalMap = 1 << 5,
+        F_DisplacementMap = 1 << 6
+    };
+
+    struct StringRef
+    {
+        uint32_t offset;
+        uint32_t length;
+    };
+
+    struct TextureRecord
+    {
+        StringRef src;
+        StringRef type;
+        StringRef format;
+    };
+
+    struct ObjectRecord
+    {
+        uint32_t type;
+        uint32_t index; // into the table of that type
+    };
+
+    struct SceneRecord
+    {
+        StringRef name;
+        uint32_t rootsBegin;
+        uint32_t rootsCount;
+    };
+
+    struct NodeRecord
+    {
+        StringRef name;
+        float translation[3];
+        float rotation[4];
+        float scale[3];
+        uint32_t childrenBegin;
+        uint32_t childrenCount;
+        uint32_t camera;
+        uint32_t mesh;
+        uint32_t environment;
+    };
+
+    struct AttributeRecord
+    {
+        StringRef src;
+        uint32_t offset;
+        uint32_t stride;
+        StringRef format;
+    };
+
+    struct MeshRecord
+    {
+        StringRef name;
+        StringRef topology;
+        uint32_t count;
+        uint32_t material;
+        uint32_t attributeCount;
+        AttributeRecord attributes[5];
+        float aabbMin[3];
+        float aabbMax[3];
+    };
+
+    struct CameraRecord
+    {
+        StringRef name;
+        float aspect;
+        float vfov;
+        float near;
+        float far;
+    };
+
+    struct DriverRecord
+    {
+        StringRef name;
+        uint32_t channel;
+        uint32_t interpolation;
+        uint32_t node;
+        uint32_t timesBegin;
+        uint32_t timesCount;
+        uint32_t valuesBegin;
+        uint32_t valuesCount;
+    };
+
+    struct MaterialRecord
+    {
+        StringRef name;
+        uint32_t flags;
+        TextureRecord normalMap;
+        TextureRecord displacementMap;
+        TextureRecord albedo;
+        TextureRecord roughness;
+        TextureRecord metalness;
+        uint32_t texturesBegin; // into the string reference pool
+        uint32_t texturesCount;
+    };
+
+    struct EnvironmentRecord
+    {
+        StringRef name;
+        TextureRecord radiance;
+    };
+
+    struct DependencyRecord
+    {
+        StringRef path;
+        uint64_t size;
+        int64_t time;
+        uint64_t hash;
+    };
+
+    struct TableRecord
+    {
+        uint64_t offset;
+        uint64_t count;
+    };
+
+    struct CompiledSceneHeader
+    {
+        char magic[4];
+        uint32_t version;
+        uint64_t sourceSize;
+        int64_t sourceTime;
+        TableRecord objects;
+        TableRecord scenes;
+        TableRecord nodes;
+        TableRecord meshes;
+        TableRecord cameras;
+        TableRecord drivers;
+        TableRecord materials;
+        TableRecord environments;
+        TableRecord dependencies;
+        TableRecord strings;
+        TableRecord stringRefs;
+        TableRecord indices;
+        TableRecord floats;
+    };
+
+    bool getFileStamp(const std::string &filename, uint64_t &size, int64_t &time)
+    {
+        std::error_code error;
+        size = static_cast<uint64_t>(std::filesystem::file_size(filename, error));
+        if (error)
+            return false;
+        time = static_cast<int64_t>(std::filesystem::last_write_time(filename, error).time_since_epoch().count());
+        return !error;
+    }
+
+    // fnv-1a over the contents, only needed when a file was touched without changing size
+    bool getFileHash(const std::string &filename, uint64_t &hash)
+    {
+        std::ifstream file(filename, std::ios::binary);
+        if (!file.is_open())
+            return false;
+
+        hash = 14695981039346656037ull;
+        std::vector<char> buffer(1 << 16);
+        while (file.read(buffer.data(), buffer.size()) || file.gcount() > 0)
+        {
+            for (std::streamsize i = 0; i < file.gcount(); ++i)
+                hash = (hash ^ static_cast<uint8_t>(buffer[i])) * 1099511628211ull;
+        }
+        return true;
+    }
+
+    class CompiledSceneWriter
+    {
+    public:
+        std::vector<ObjectRecord> objects;
+        std::vector<SceneRecord> scenes;
+        std::vector<NodeRecord> nodes;
+        std::vector<MeshRecord> meshes;
+        std::vector<CameraRecord> cameras;
+        std::vector<DriverRecord> drivers;
+        std::vector<MaterialRecord> materials;
+        std::vector<EnvironmentRecord> environments;
+        std::vector<DependencyRecord> dependencies;
+        std::vector<char> strings;
+        std::vector<StringRef> stringRefs;
+        std::vector<uint32_t> indices;
+        std::vector<float> floats;
+
+        StringRef addString(const std::string &str)
+        {
+            // file names repeat across attributes and meshes, store each string once
+            auto iter = stringOffsets.find(str);
+            if (iter != stringOffsets.end())
+                return iter->second;
+
+            StringRef ref{static_cast<uint32_t>(strings.size()), static_cast<uint32_t>(str.size())};
+            strings.insert(strings.end(), str.begin(), str.end());
+            stringOffsets.insert({str, ref});
+            return ref;
+        }
+
+        TextureRecord addTexture(const Texture &texture)
+        {
+            return TextureRecord{addString(texture.src), addString(texture.type), addString(texture.format)};
+        }
+
+        // stamps a file the scene reads at load, one missing now makes the image stale once it appears
+        void addDependency(const std::string &path)
+        {
+            if (!dependencyPaths.insert(path).second)
+                return;
+
+            DependencyRecord dependency{};
+            dependency.path = addString(path);
+            if (!getFileStamp(path, dependency.size, dependency.time) || !getFileHash(path, dependency.hash))
+                dependency.size = MISSING_FILE;
+            dependencies.push_back(dependency);
+        }
+
+        uint32_t addIndices(const std::vector<uint32_t> &values)
+        {
+            uint32_t begin = static_cast<uint32_t>(indices.size());
+            indices.insert(indices.end(), values.begin(), values.end());
+            return begin;
+        }
+
+        uint32_t addFloats(const std::vector<float> &values)
+        {
+            uint32_t begin = static_cast<uint32_t>(floats.size());
+            floats.insert(floats.end(), values.begin(), values.end());
+            return begin;
+        }
+
+        void write(const std::string &filename, CompiledSceneHeader &header)
+        {
+            std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+            if (!file.is_open())
+                throw std::runtime_error("failed to create .s72b file!");
+
+            uint64_t offset = sizeof(CompiledSceneHeader);
+            auto place = [&offset](TableRecord &table, size_t count, size_t elementSize)
+            {
+                offset = (offset + 15) & ~uint64_t(15); // keep every table aligned for direct access
+                table.offset = offset;
+                table.count = count;
+                offset += count * elementSize;
+            };
+            place(header.objects, objects.size(), sizeof(ObjectRecord));
+            place(header.scenes, scenes.size(), sizeof(SceneRecord));
+            place(header.nodes, nodes.size(), sizeof(NodeRecord));
+            place(header.meshes, meshes.size(), sizeof(MeshRecord));
+            place(header.cameras, cameras.size(), sizeof(CameraRecord));
+            place(header.drivers, drivers.size(), sizeof(DriverRecord));
+            place(header.materials, materials.size(), sizeof(MaterialRecord));
+            place(header.environments, environments.size(), sizeof(EnvironmentRecord));
+            place(header.dependencies, dependencies.size(), sizeof(DependencyRecord));
+            place(header.strings, strings.size(), sizeof(char));
+            place(header.stringRefs, stringRefs.size(), sizeof(StringRef));
+            place(header.indices, indices.size(), sizeof(uint32_t));
+            place(header.floats, floats.size(), sizeof(float));
+
+            file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+            writeTable(file, header.objects, objects);
+            writeTable(file, header.scenes, scenes);
+            writeTable(file, header.nodes, nodes);
+            writeTable(file, header.meshes, meshes);
+            writeTable(file, header.cameras, cameras);
+            writeTable(file, header.drivers, drivers);
+            writeTable(file, header.materials, materials);
+            writeTable(file, header.environments, environments);
+            writeTable(file, header.dependencies, dependencies);
+            writeTable(file, header.strings, strings);
+            writeTable(file, header.stringRefs, stringRefs);
+            writeTable(file, header.indices, indices);
+            writeTable(file, header.floats, floats);
+
+            file.close();
+            if (!file.good())
+                throw std::runtime_error("failed to write .s72b file!");
+        }
+
+    private:
+        std::unordered_map<std::string, StringRef> stringOffsets;
+        std::unordered_set<std::string> dependencyPaths;
+
+        template <typename T>
+        void writeTable(std::ofstream &file, const TableRecord &table, const std::vector<T> &values)
+        {
+            static_assert(std::is_trivially_copyable_v<T>);
+
+            // pad up to the aligned table offset
+            static const char zeros[16] = {};
+            uint64_t position = static_cast<uint64_t>(file.tellp());
+            file.write(zeros, static_cast<std::streamsize>(table.offset - position));
+            file.write(reinterpret_cast<const char *>(values.data()), static_cast<std::streamsize>(values.size() * sizeof(T)));
+        }
+    };
+
+    class CompiledSceneReader
+    {
+    public:
+        CompiledSceneReader(const MappedFile &file) : file(file) {}
+
+        template <typename T>
+        const T *getTable(const TableRecord &table) const
+        {
+            if (table.offset > file.size() || table.count > (file.size() - table.offset) / sizeof(T))
+                throw std::runtime_error("corrupt .s72b file!");
+            return reinterpret_cast<const T *>(file.data() + table.offset);
+        }
+
+        void setPools(const CompiledSceneHeader &header)
+        {
+            strings = getTable<char>(header.strings);
+            stringCount = header.strings.count;
+        }
+
+        std::string getString(const StringRef &ref) const
+        {
+            if (static_cast<uint64_t>(ref.offset) + ref.length > stringCount)
+                throw std::runtime_error("corrupt .s72b file!");
+            return std::string(strings + ref.offset, ref.length);
+        }
+
+        Texture getTexture(const TextureRecord &record) const
+        {
+            Texture texture;
+            texture.src = getString(record.src);
+            texture.type = getString(record.type);
+            texture.format = getString(record.format);
+            return texture;
+        }
+
+    private:
+        const MappedFile &file;
+        const char *strings = nullptr;
+        uint64_t stringCount = 0;
+    };
+
+    void checkRange(uint64_t begin, uint64_t count, const TableRecord &table)
+    {
+        if (begin + count > table.count)
+            throw std::runtime_error("corrupt .s72b file!");
+    }
+}
+
+std::string getCompiledScenePath(const std::string &sourceFile)
+{
+    return sourceFile + "b";
+}
+
+void compileScene(const SceneStructure &structure, const std::string &sourceFile, const std::string &compiledFile)
+{
+    CompiledSceneWriter writer;
+    CompiledSceneHeader header{};
+    std::memcpy(header.magic, COMPILED_SCENE_MAGIC, sizeof(header.magic));
+    header.version = COMPILED_SCENE_VERSION;
+    if (!getFileStamp(sourceFile, header.sourceSize, header.sourceTime))
+        throw std::runtime_error("failed to stat .s72 file!");
+
+    // vertex files are read once here so the viewer never has to scan them for bounds
+    std::unordered_map<std::string, std::vector<char>> vertexFiles;
+    // bounds are computed for all meshes together once every file is loaded
+    std::vector<VertexSource> boundsSources;
+    std::vector<size_t> boundsMeshes;
+
+    for (const auto &obj : structure.objects)
+    {
+        ObjectRecord object{static_cast<uint32_t>(obj.type), 0};
+
+        if (obj.type == Type::T_Scene)
+        {
+            const Scene &scene = std::get<Scene>(obj.object);
+            object.index = static_cast<uint32_t>(writer.scenes.size());
+            writer.scenes.push_back(SceneRecord{writer.addString(scene.name), writer.addIndices(scene.roots), static_cast<uint32_t>(scene.roots.size())});
+        }
+        else if (obj.type == Type::T_Node)
+        {
+            const Node &node = std::get<Node>(obj.object);
+            NodeRecord record{};
+            record.name = writer.addString(node.name);
+            std::memcpy(record.translation, node.translation.data(), sizeof(record.translation));
+            std::memcpy(record.rotation, node.rotation.data(), sizeof(record.rotation));
+            std::memcpy(record.scale, node.scale.data(), sizeof(record.scale));
+            record.childrenBegin = writer.addIndices(node.children);
+            record.childrenCount = static_cast<uint32_t>(node.children.size());
+            record.camera = node.camera.value_or(NO_INDEX);
+            record.mesh = node.mesh.value_or(NO_INDEX);
+            record.environment = node.environment.value_or(NO_INDEX);
+            object.index = static_cast<uint32_t>(writer.nodes.size());
+            writer.nodes.push_back(record);
+        }
+        else if (obj.type == Type::T_Mesh)
+        {
+            const Mesh &mesh = std::get<Mesh>(obj.object);
+            if (mesh.attributes.size() > 5)
+                throw std::logic_error("too many mesh attributes to compile!");
+
+            MeshRecord record{};
+            record.name = writer.addString(mesh.name);
+            record.topology = writer.addString(mesh.topology);
+            record.count = mesh.count;
+            record.material = mesh.material.value_or(NO_INDEX);
+            record.attributeCount = static_cast<uint32_t>(mesh.attributes.size());
+            for (size_t i = 0; i < mesh.attributes.size(); ++i)
+            {
+                const MeshAttribute &attribute = mesh.attributes[i];
+                record.attributes[i] = AttributeRecord{writer.addString(attribute.src), attribute.offset, attribute.stride, writer.addString(attribute.format)};
+                writer.addDependency(attribute.src);
+            }
+
+            // same bounds the renderer would compute from the position attribute
+            const MeshAttribute &position = mesh.attributes[0];
+            auto iter = vertexFiles.find(position.src);
+            if (iter == vertexFiles.end())
+            {
+                std::ifstream file(position.src, std::ios::ate | std::ios::binary);
+                if (!file.is_open())
+                    throw std::runtime_error("failed to open vertex file " + position.src);
+
+                std::vector<char> vertices(static_cast<size_t>(file.tellg()));
+                file.seekg(0);
+                file.read(vertices.data(), vertices.size());
+                iter = vertexFiles.insert({position.src, std::move(vertices)}).first;
+            }
+            boundsSources.push_back(VertexSource{iter->second.data(), iter->second.size(), position.stride, position.offset, mesh.attributes.size() > 1 ? mesh.attributes[1].offset : 0});
+            boundsMeshes.push_back(writer.meshes.size());
+
+            object.index = static_cast<uint32_t>(writer.meshes.size());
+            writer.meshes.push_back(record);
+        }
+        else if (obj.type == Type::T_Camera)
+        {
+            const Camera &camera = std::get<Camera>(obj.object);
+            object.index = static_cast<uint32_t>(writer.cameras.size());
+            writer.cameras.push_back(CameraRecord{writer.addString(camera.name), camera.perspective.aspect, camera.perspective.vfov, camera.perspective.near, camera.perspective.far});
+        }
+        else if (obj.type == Type::T_Driver)
+        {
+            const Driver &driver = std::get<Driver>(obj.object);
+            DriverRecord record{};
+            record.name = writer.addString(driver.name);
+            record.channel = static_cast<uint32_t>(driver.channel);
+            record.interpolation = static_cast<uint32_t>(driver.interpolation);
+            record.node = driver.node;
+            record.timesBegin = writer.addFloats(driver.times);
+            record.timesCount = static_cast<uint32_t>(driver.times.size());
+            record.valuesBegin = writer.addFloats(driver.values);
+            record.valuesCount = static_cast<uint32_t>(driver.values.size());
+            object.index = static_cast<uint32_t>(writer.drivers.size());
+            writer.drivers.push_back(record);
+        }
+        else if (obj.type == Type::T_Material)
+        {
+            const Material &material = std::get<Material>(obj.object);
+            MaterialRecord record{};
+            record.name = writer.addString(material.name);
+            if (material.normalMap.has_value())
+            {
+                record.flags |= F_NormalMap;
+                record.normalMap = writer.addTexture(material.normalMap.value());
+            }
+            if (material.displacementMap.has_value())
+            {
+                record.flags |= F_DisplacementMap;
+                record.displacementMap = writer.addTexture(material.displacementMap.value());
+            }
+            if (material.pbr.has_value())
+            {
+                record.flags |= F_Pbr;
+                record.albedo = writer.addTexture(material.pbr.value().albedo);
+                record.roughness = writer.addTexture(material.pbr.value().roughness);
+                record.metalness = writer.addTexture(material.pbr.value().metalness);
+            }
+            if (material.lambertian.has_value())
+            {
+                record.flags |= F_Lambertian;
+                record.albedo = writer.addTexture(material.lambertian.value().albedo);
+            }
+            if (material.mirror)
+                record.flags |= F_Mirror;
+            if (material.environment)
+                record.flags |= F_Environment;
+            if (material.simple)
+                record.flags |= F_Simple;
+
+            record.texturesBegin = static_cast<uint32_t>(writer.stringRefs.size());
+            auto textures = structure.materialTexturePair.find(material.id);
+            if (textures != structure.materialTexturePair.end())
+            {
+                for (const auto &texture : textures->second)
+                {
+                    writer.stringRefs.push_back(writer.addString(texture));
+                    writer.addDependency(texture);
+                }
+                record.texturesCount = static_cast<uint32_t>(textures->second.size());
+            }
+
+            object.index = static_cast<uint32_t>(writer.materials.size());
+            writer.materials.push_back(record);
+        }
+        else if (obj.type == Type::T_Environment)
+        {
+            const Environment &environment = std::get<Environment>(obj.object);
+            object.index = static_cast<uint32_t>(writer.environments.size());
+            writer.environments.push_back(EnvironmentRecord{writer.addString(environment.name), writer.addTexture(environment.radiance)});
+            writer.addDependency(environment.radiance.src);
+        }
+
+        writer.objects.push_back(object);
+    }
+
+    std::vector<AABB> aabbs;
+    createAABBs(boundsSources, aabbs);
+    for (size_t i = 0; i < aabbs.size(); ++i)
+    {
+        MeshRecord &record = writer.meshes[boundsMeshes[i]];
+        std::memcpy(record.aabbMin, &aabbs[i].min, sizeof(record.aabbMin));
+        std::memcpy(record.aabbMax, &aabbs[i].max, sizeof(record.aabbMax));
+    }
+
+    // written beside the image and renamed over it, so an interrupted compile never leaves a truncated image behind
+    std::string tempFile = compiledFile + ".tmp";
+    std::error_code error;
+    try
+    {
+        writer.write(tempFile, header);
+    }
+    catch (...)
+    {
+        std::filesystem::remove(tempFile, error);
+        throw;
+    }
+    std::filesystem::rename(tempFile, compiledFile, error);
+    if (error)
+    {
+        std::filesystem::remove(tempFile, error);
+        throw std::runtime_error("failed to replace .s72b file!");
+    }
+}
+
+std::optional<SceneStructure> loadCompiledScene(const std::string &compiledFile, const std::string &sourceFile)
+{
+    MappedFile file;
+    if (!file.open(compiledFile) || file.size() < sizeof(CompiledSceneHeader))
+        return std::nullopt;
+
+    CompiledSceneHeader header;
+    std::memcpy(&header, file.data(), sizeof(header));
+    if (std::memcmp(header.magic, COMPILED_SCENE_MAGIC, sizeof(header.magic)) != 0 || header.version != COMPILED_SCENE_VERSION)
+        return std::nullopt;
+
+    CompiledSceneReader reader(file);
+    reader.setPools(header);
+
+    // a missing source is fine, a changed one makes the image stale
+    uint64_t size;
+    int64_t time;
+    if (getFileStamp(sourceFile, size, time) && (size != header.sourceSize || time != header.sourceTime))
+        return std::nullopt;
+
+    // every vertex file and texture is checked too, a touched file with the same contents, like a regenerated
+    // constant texture, keeps the image
+    const DependencyRecord *dependencies = reader.getTable<DependencyRecord>(header.dependencies);
+    for (uint64_t i = 0; i < header.dependencies.count; ++i)
+    {
+        std::string path = reader.getString(dependencies[i].path);
+        bool exists = getFileStamp(path, size, time);
+        if (dependencies[i].size == MISSING_FILE)
+        {
+            if (exists)
+                return std::nullopt;
+            continue;
+        }
+        uint64_t hash;
+        if (!exists || size != dependencies[i].size)
+            return std::nullopt;
+        if (time != dependencies[i].time && (!getFileHash(path, hash) || hash != dependencies[i].hash))
+            return std::nullopt;
+    }
+
+    const ObjectRecord *objects = reader.getTable<ObjectRecord>(header.objects);
+    const SceneRecord *scenes = reader.getTable<SceneRecord>(header.scenes);
+    const NodeRecord *nodes = reader.getTable<NodeRecord>(header.nodes);
+    const MeshRecord *meshes = reader.getTable<MeshRecord>(header.meshes);
+    const CameraRecord *cameras = reader.getTable<CameraRecord>(header.cameras);
+    const DriverRecord *drivers = reader.getTable<DriverRecord>(header.drivers);
+    const MaterialRecord *materials = reader.getTable<MaterialRecord>(header.materials);
+    const EnvironmentRecord *environments = reader.getTable<EnvironmentRecord>(header.environments);
+    const StringRef *stringRefs = reader.getTable<StringRef>(header.stringRefs);
+    const uint32_t *indices = reader.getTable<uint32_t>(header.indices);
+    const float *floats = reader.getTable<float>(header.floats);
+
+    SceneStructure structure;
+    structure.objects.resize(header.objects.count);
+
+    for (uint64_t i = 0; i < header.objects.count; ++i)
+    {
+        SceneObject &obj = structure.objects[i];
+        obj.type = static_cast<Type>(objects[i].type);
+        uint32_t index = objects[i].index;
+        uint32_t id = static_cast<uint32_t>(i + 1);
+
+        if (obj.type == Type::T_Scene)
+        {
+            checkRange(index, 1, header.scenes);
+            const SceneRecord &record = scenes[index];
+            checkRange(record.rootsBegin, record.rootsCount, header.indices);
+
+            Scene scene;
+            scene.id = id;
+            scene.name = reader.getString(record.name);
+            scene.roots.assign(indices + record.rootsBegin, indices + record.rootsBegin + record.rootsCount);
+            obj.object = std::move(scene);
+        }
+        else if (obj.type == Type::T_Node)
+        {
+            checkRange(index, 1, header.nodes);
+            const NodeRecord &record = nodes[index];
+            checkRange(record.childrenBegin, record.childrenCount, header.indices);
+
+            Node node;
+            node.id = id;
+            node.name = reader.getString(record.name);
+            node.translation.assign(record.translation, record.translation + 3);
+            node.rotation.assign(record.rotation, record.rotation + 4);
+            node.scale.assign(record.scale, record.scale + 3);
+            node.children.assign(indices + record.childrenBegin, indices + record.childrenBegin + record.childrenCount);
+            if (record.camera != NO_INDEX)
+                node.camera = record.camera;
+            if (record.mesh != NO_INDEX)
+                node.mesh = record.mesh;
+            if (record.environment != NO_INDEX)
+                node.environment = record.environment;
+            obj.object = std::move(node);
+        }
+        else if (obj.type == Type::T_Mesh)
+        {
+            checkRange(index, 1, header.meshes);
+            const MeshRecord &record = meshes[index];
+            if (record.attributeCount > 5)
+                throw std::runtime_error("corrupt .s72b file!");
+
+            Mesh mesh;
+            mesh.id = id;
+            mesh.name = reader.getString(record.name);
+            mesh.topology = reader.getString(record.topology);
+            mesh.count = record.count;
+            if (record.material != NO_INDEX)
+                mesh.material = record.material;
+            for (uint32_t j = 0; j < record.attributeCount; ++j)
+            {
+                const AttributeRecord &attribute = record.attributes[j];
+                mesh.attributes.push_back(MeshAttribute{reader.getString(attribute.src), attribute.offset, attribute.stride, reader.getString(attribute.format)});
+            }
+            mesh.bounds = AABB{.min = glm::vec3(record.aabbMin[0], record.aabbMin[1], record.aabbMin[2]), .max = glm::vec3(record.aabbMax[0], record.aabbMax[1], record.aabbMax[2])};
+            obj.object = std::move(mesh);
+        }
+        else if (obj.type == Type::T_Camera)
+        {
+            checkRange(index, 1, header.cameras);
+            const CameraRecord &record = cameras[index];
+
+            Camera camera;
+            camera.id = id;
+            camera.name = reader.getString(record.name);
+            camera.perspective = CameraInfo{record.aspect, record.vfov, record.near, record.far};
+            obj.object = std::move(camera);
+        }
+        else if (obj.type == Type::T_Driver)
+        {
+            checkRange(index, 1, header.drivers);
+            const DriverRecord &record = drivers[index];
+            checkRange(record.timesBegin, record.timesCount, header.floats);
+            checkRange(record.valuesBegin, record.valuesCount, header.floats);
+
+            Driver driver;
+            driver.id = id;
+            driver.name = reader.getString(record.name);
+            driver.node = record.node;
+            driver.channel = static_cast<DriverChannel>(record.channel);
+            driver.interpolation = static_cast<Interpolation>(record.interpolation);
+            driver.times.assign(floats + record.timesBegin, floats + record.timesBegin + record.timesCount);
+            driver.values.assign(floats + record.valuesBegin, floats + record.valuesBegin + record.valuesCount);
+            obj.object = std::move(driver);
+        }
+        else if (obj.type == Type::T_Material)
+        {
+            checkRange(index, 1, header.materials);
+            const MaterialRecord &record = materials[index];
+            checkRange(record.texturesBegin, record.texturesCount, header.stringRefs);
+
+            Material material;
+            material.id = id;
+            material.name = reader.getString(record.name);
+            if (record.flags & F_NormalMap)
+                material.normalMap = reader.getTexture(record.normalMap);
+            if (record.flags & F_DisplacementMap)
+                material.displacementMap = reader.getTexture(record.displacementMap);
+            if (record.flags & F_Pbr)
+                material.pbr = PBR{reader.getTexture(record.albedo), reader.getTexture(record.roughness), reader.getTexture(record.metalness)};
+            if (record.flags & F_Lambertian)
+                material.lambertian = Lambertian{reader.getTexture(record.albedo)};
+            material.mirror = (record.flags & F_Mirror) != 0;
+            material.environment = (record.flags & F_Environment) != 0;
+            material.simple = (record.flags & F_Simple) != 0;
+
+            std::vector<std::string> textures;
+            for (uint32_t j = 0; j < record.texturesCount; ++j)
+            {
+                textures.push_back(reader.getString(stringRefs[record.texturesBegin + j]));
+            }
+            structure.materialTexturePair.insert({id, std::move(textures)});
+
+            obj.object = std::move(material);
+        }
+        else if (obj.type == Type::T_Environment)
+        {
+            checkRange(index, 1, header.environments);
+            const EnvironmentRecord &record = environments[index];
+
+            Environment environment;
+            environment.id = id;
+            environment.name = reader.getString(record.name);
+            environment.radiance = reader.getTexture(record.radiance);
+            obj.object = std::move(environment);
+        }
+        else
+        {
+            throw std::runtime_error("corrupt .s72b file!");
+        }
+    }
+
+    SceneParser::finalizeSceneStructure(structure);
+
+    return structure;
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include "SceneParser.h"
+
+// version of the .s72b layout, bump it whenever a record changes
+const uint32_t COMPILED_SCENE_VERSION = 3;
+
+// "scene.s72" -> "scene.s72b"
+std::string getCompiledScenePath(const std::string &sourceFile);
+
+// writes a binary image of the scene: flat object tables, string/index/float pools and precomputed mesh AABBs,
+// stamped with the size and modification time of the .s72 file and every vertex file and texture it references;
+// the image is written to a temporary file first and renamed over the old one
+void compileScene(const SceneStructure &structure, const std::string &sourceFile, const std::string &compiledFile);
+
+// maps a compiled image and copies its tables into a scene structure without tokenizing anything,
+// returns nullopt if the image is missing, from another version or older than its sources, throws if it is corrupt
+std::optional<SceneStructure> loadCompiledScene(const std::string &compiledFile, const std::string &sourceFile);
@@ -1,60 +1,96 @@
 #include "SceneParser.h"
 
-SceneParser::SceneParser(const std::string &filename)
+SceneParser::SceneParser(const std::string &filename, bool useMapping)
 {
-    sceneFile = readSceneFile(filename);
-    max_index = static_cast<uint32_t>(sceneFile.size());
+    // parse the mapped pages in place, only copy the file into memory if mapping is unavailable
+    if (useMapping && mappedSceneFile.open(filename))
+    {
+        tokenizer = SceneTokenizer(mappedSceneFile.data(), mappedSceneFile.size());
+    }
+    else
+    {
+        sceneFile = readSceneFile(filename);
+        tokenizer = SceneTokenizer(sceneFile.data(), sceneFile.size());
+    }
+
+    // the file is an array that starts with the "s72-v1" magic string
+    tokenizer.beginArray();
+    if (!tokenizer.nextElement() || tokenizer.readString() != "s72-v1")
+        throw std::runtime_error("not a .s72 file!");
 }
 
 SceneParser::~SceneParser()
 {
 }
 
+SceneParser::SceneParser(std::string_view objectText, uint32_t index)
+{
+    tokenizer = SceneTokenizer(objectText.data(), objectText.size());
+    object_index = index;
+}
+
+bool SceneParser::isMapped() const
+{
+    return mappedSceneFile.isOpen();
+}
+
 std::optional<SceneObject> SceneParser::parse()
 {
-    char token = getNextToken();
-    if (token == '[')
+    if (!tokenizer.nextElement())
     {
-        current_index += 10; // skip "s72-v1",
-        token = getNextToken();
-    }
-    if (token == '{')
-    {
-        object_index++;
-
-        current_index += 1; // avoid extra space
-        token = getNextToken();
-        current_index += 8; // get first letter of the type
-        token = getNextToken();
-
-        if (token == 'S')
-            return parseScene();
-        if (token == 'N')
-            return parseNode();
-        if (token == 'M')
-        {
-            if (sceneFile[current_index + 1] == 'E')
-                return parseMesh();
-            if (sceneFile[current_index + 1] == 'A')
-                return parseMaterial();
-        }
-        if (token == 'C')
-            return parseCamera();
-        if (token == 'D')
-            return parseDriver();
-        if (token == 'E')
-            return parseEnvironment();
-    }
-    if (token == ',')
-    {
-        moveToken(1);
+        finish = true;
         return std::nullopt;
     }
-    else // token == ']'
+
+    object_index++;
+
+    return parseObject();
+}
+
+SceneObject SceneParser::parseObject()
+{
+    // "type" normally comes first and the object is parsed straight on; key order is free in .s72 though,
+    // so otherwise the object is scanned for "type" and reopened from the start
+    size_t objectStart = tokenizer.position();
+    std::string_view type;
+    std::string_view key;
+    tokenizer.beginObject();
+    if (tokenizer.nextKey(key) && key == "type")
     {
-        finish = true;
-        return std::nullopt;
+        type = tokenizer.readString();
     }
+    else
+    {
+        tokenizer.seek(objectStart);
+        tokenizer.beginObject();
+        while (tokenizer.nextKey(key))
+        {
+            if (key == "type")
+                type = tokenizer.readString();
+            else
+                tokenizer.skipValue();
+        }
+        tokenizer.seek(objectStart);
+        tokenizer.beginObject();
+    }
+
+    if (type == "SCENE")
+        return parseScene();
+    if (type == "NODE")
+        return parseNode();
+    if (type == "MESH")
+        return parseMesh();
+    if (type == "CAMERA")
+        return parseCamera();
+    if (type == "DRIVER")
+        return parseDriver();
+    if (type == "MATERIAL")
+        return parseMaterial();
+    if (type == "ENVIRONMENT")
+        return parseEnvironment();
+
+    // every object must be kept, other objects refer to them by their index in the file
+    throw std::logic_error("unsupported object type: " + std::string(type));
 }
 
 SceneObject SceneParser::parseScene()
@@ -64,22 +100,17 @@ SceneObject SceneParser::parseScene()
 
     object.type = Type::T_Scene;
     scene.id = object_index;
-    parseToLineEnd();
-
-    moveToken(8); // get first letter of the name
-    scene.name = parseString();
-    parseToLineEnd();
 
-    moveToken(9); // get first number of the root
-    while (sceneFile[current_index] != ']')
+    std::string_view key;
+    while (tokenizer.nextKey(key))
     {
-        scene.roots.push_back(parseInteger());
-        if (sceneFile[current_index] == ']')
-            break;
-        moveToken(1); // skip ','
+        if (key == "name")
+            scene.name = tokenizer.readString();
+        else if (key == "roots")
+            parseIntegerArray(scene.roots);
+        else
+            tokenizer.skipValue();
     }
-    current_index++; // skip ']'
-    getNextToken();  // finish parsing scene
 
     object.object = scene;
 
@@ -93,113 +124,32 @@ SceneObject SceneParser::parseNode()
 
     object.type = Type::T_Node;
     node.id = object_index;
-    parseToLineEnd();
 
-    moveToken(8); // get first letter of the name
-    node.name = parseString();
-    parseToLineEnd();
-
-    moveToken(1); // get first letter of the T/R/S
-    if (sceneFile[current_index] == 't')
-    {
-        moveToken(14); // get first number of the translation
-        node.translation[0] = parseFloat();
-        parseToLineEnd();
-        node.translation[1] = parseFloat();
-        parseToLineEnd();
-        node.translation[2] = parseFloat();
-        parseToLineEnd();
-
-        moveToken(12); // get first number of the rotation
-        node.rotation[0] = parseFloat();
-        parseToLineEnd();
-        node.rotation[1] = parseFloat();
-        parseToLineEnd();
-        node.rotation[2] = parseFloat();
-        parseToLineEnd();
-        node.rotation[3] = parseFloat();
-        parseToLineEnd();
-
-        moveToken(9); // get first number of the scale
-        node.scale[0] = parseFloat();
-        parseToLineEnd();
-        node.scale[1] = parseFloat();
-        parseToLineEnd();
-        node.scale[2] = parseFloat();
-
-        if (sceneFile[current_index + 1] != ',') // empty node
-        {
-            parseToLineEnd();
-            object.object = node;
-            return object;
-        }
+    std::string_view key;
+    while (tokenizer.nextKey(key))
+    {
+        if (key == "name")
+            node.name = tokenizer.readString();
+        else if (key == "translation")
+            parseFloatArray(node.translation);
+        else if (key == "rotation")
+            parseFloatArray(node.rotation);
+        else if (key == "scale")
+            parseFloatArray(node.scale);
+        else if (key == "children")
+            parseIntegerArray(node.children);
+        else if (key == "camera")
+            node.camera = tokenizer.readInteger();
+        else if (key == "mesh")
+            node.mesh = tokenizer.readInteger();
+        else if (key == "environment")
+            node.environment = tokenizer.readInteger();
         else
-        {
-            parseToLineEnd();
-        }
-    }
-    else if (sceneFile[current_index] == 'r')
-    {
-        throw std::logic_error("no translation values found!");
-    }
-    else if (sceneFile[current_index] == 's')
-    {
-        throw std::logic_error("no translation and rotation values found!");
-    }
-    else
-    {
-        current_index--; // no t&r&s
-    }
-
-    moveToken(1); // get first letter of the mesh/camera/environment/children
-    bool onlyChildren = false;
-    if (sceneFile[current_index] == 'm')
-    {
-        moveToken(6); // get first number of the mesh
-        node.mesh = parseInteger();
-    }
-    else if (sceneFile[current_index] == 'c')
-    {
-        if (sceneFile[current_index + 1] == 'a')
-        {
-            moveToken(8); // get first number of the camera
-            node.camera = parseInteger();
-        }
-        else if (sceneFile[current_index + 1] == 'h')
-        {
-            onlyChildren = true;
-            moveToken(11); // get first number of the children
-            while (sceneFile[current_index] != ']')
-            {
-                node.children.push_back(parseInteger());
-                if (sceneFile[current_index] == ']')
-                    break;
-                moveToken(1); // skip ','
-            }
-            current_index++; // skip ']'
-            getNextToken();  // finish parsing node
-        }
-    }
-    else if (sceneFile[current_index] == 'e')
-    {
-        moveToken(13); // get first number of the environment
-        node.environment = parseInteger();
+            tokenizer.skipValue();
     }
 
-    if (sceneFile[current_index] == ',' && !onlyChildren)
-    {
-        parseToLineEnd();
-        moveToken(12); // get first number of the children
-        while (sceneFile[current_index] != ']')
-        {
-            node.children.push_back(parseInteger());
-            if (sceneFile[current_index] == ']')
-                break;
-            moveToken(1); // skip ','
-        }
-        current_index++; // skip ']'
-        getNextToken();  // finish parsing node
-    }
+    if (node.translation.size() != 3 || node.rotation.size() != 4 || node.scale.size() != 3)
+        throw std::logic_error("invalid translation, rotation or scale values found!");
 
     object.object = node;
 
@@ -213,138 +163,56 @@ SceneObject SceneParser::parseMesh()
 
     object.type = Type::T_Mesh;
     mesh.id = object_index;
-    parseToLineEnd();
-
-    moveToken(8); // get first letter of the name
-    mesh.name = parseString();
-    parseToLineEnd();
-
-    moveToken(12); // get first letter of the topology
-    mesh.topology = parseString();
-    parseToLineEnd();
-
-    moveToken(8); // get first number of the count
-    mesh.count = parseInteger();
-    parseToLineEnd();
-
-    /* add indices later */
-
-    MeshAttribute position;
-    getNextToken();
-    current_index += 14; // get to position attribute
-    moveToken(20);       // get first letter of the src
-    position.src = parseString();
-    parseToLineEnd();
-
-    moveToken(9); // get first number of the offset
-    position.offset = parseInteger();
-    parseToLineEnd();
-
-    moveToken(9); // get first number of the stride
-    position.stride = parseInteger();
-    parseToLineEnd();
-
-    moveToken(10); // get first letter of the format
-    position.format = parseString();
-    parseToLineEnd();
-
-    MeshAttribute normal;
-    moveToken(18); // get first letter of the src
-    normal.src = parseString();
-    parseToLineEnd();
-
-    moveToken(9); // get first number of the offset
-    normal.offset = parseInteger();
-    parseToLineEnd();
-
-    moveToken(9); // get first number of the stride
-    normal.stride = parseInteger();
-    parseToLineEnd();
-
-    moveToken(10); // get first letter of the format
-    normal.format = parseString();
-    parseToLineEnd();
-
-    MeshAttribute tangent;
-    MeshAttribute texcoord;
-    bool hasMaterial = false;
-    moveToken(1); // get to tangent or color attribute
-    if (sceneFile[current_index] == 'T')
-    {
-        hasMaterial = true;
-
-        moveToken(18); // get first letter of the src
-        tangent.src = parseString();
-        parseToLineEnd();
-
-        moveToken(9); // get first number of the offset
-        tangent.offset = parseInteger();
-        parseToLineEnd();
-
-        moveToken(9); // get first number of the stride
-        tangent.stride = parseInteger();
-        parseToLineEnd();
 
-        moveToken(10); // get first letter of the format
-        tangent.format = parseString();
-        parseToLineEnd();
+    std::optional<MeshAttribute> position, normal, tangent, texcoord, color;
 
-        moveToken(20); // get first letter of the src
-        texcoord.src = parseString();
-        parseToLineEnd();
-
-        moveToken(9); // get first number of the offset
-        texcoord.offset = parseInteger();
-        parseToLineEnd();
-
-        moveToken(9); // get first number of the stride
-        texcoord.stride = parseInteger();
-        parseToLineEnd();
-
-        moveToken(10); // get first letter of the format
-        texcoord.format = parseString();
-        parseToLineEnd();
-        moveToken(1);
+    std::string_view key;
+    while (tokenizer.nextKey(key))
+    {
+        if (key == "name")
+            mesh.name = tokenizer.readString();
+        else if (key == "topology")
+            mesh.topology = tokenizer.readString();
+        else if (key == "count")
+            mesh.count = tokenizer.readInteger();
+        else if (key == "material")
+            mesh.material = tokenizer.readInteger();
+        else if (key == "attributes")
+        {
+            std::string_view attribute;
+            tokenizer.beginObject();
+            while (tokenizer.nextKey(attribute))
+            {
+                if (attribute == "POSITION")
+                    position = parseMeshAttribute();
+                else if (attribute == "NORMAL")
+                    normal = parseMeshAttribute();
+                else if (attribute == "TANGENT")
+                    tangent = parseMeshAttribute();
+                else if (attribute == "TEXCOORD")
+                    texcoord = parseMeshAttribute();
+                else if (attribute == "COLOR")
+                    color = parseMeshAttribute();
+                else
+                    tokenizer.skipValue();
+            }
+        }
+        else
+            tokenizer.skipValue(); /* add indices later */
     }
 
-    MeshAttribute color;
-    moveToken(16); // get first letter of the src
-    color.src = parseString();
-    parseToLineEnd();
+    if (!position.has_value() || !normal.has_value() || !color.has_value())
+        throw std::logic_error("mesh requires POSITION, NORMAL and COLOR attributes!");
 
-    moveToken(9); // get first number of the offset
-    color.offset = parseInteger();
-    parseToLineEnd();
-
-    moveToken(9); // get first number of the stride
-    color.stride = parseInteger();
-    parseToLineEnd();
-
-    moveToken(10); // get first letter of the format
-    color.format = parseString();
-
-    if (!hasMaterial)
-    {
-        current_index++; // skip '\"'
-        getNextToken();  // finish parsing mesh
-
-        mesh.attributes.push_back(position);
-        mesh.attributes.push_back(normal);
-        mesh.attributes.push_back(color);
-    }
-    else
+    // attributes are always stored in the order the vertex descriptions expect
+    mesh.attributes.push_back(position.value());
+    mesh.attributes.push_back(normal.value());
+    if (tangent.has_value() && texcoord.has_value())
     {
-        parseToLineEnd();
-        moveToken(11); // get first number of the material
-        mesh.material = parseInteger();
-        getNextToken(); // finish parsing mesh
-
-        mesh.attributes.push_back(position);
-        mesh.attributes.push_back(normal);
-        mesh.attributes.push_back(tangent);
-        mesh.attributes.push_back(texcoord);
-        mesh.attributes.push_back(color);
+        mesh.attributes.push_back(tangent.value());
+        mesh.attributes.push_back(texcoord.value());
     }
+    mesh.attributes.push_back(color.value());
 
     object.object = mesh;
 
@@ -358,40 +226,39 @@ SceneObject SceneParser::parseCamera()
 
     object.type = Type::T_Camera;
     camera.id = object_index;
-    parseToLineEnd();
-
-    moveToken(8); // get first letter of the name
-    camera.name = parseString();
-    parseToLineEnd();
 
-    moveToken(1); // get first letter of the perspective
-    if (sceneFile[current_index] == 'p')
+    bool hasPerspective = false;
+    std::string_view key;
+    while (tokenizer.nextKey(key))
     {
-        current_index += 15; // get to aspect attribute
-        moveToken(9);        // get first number of the aspect
-        camera.perspective.aspect = parseFloat();
-        parseToLineEnd();
-
-        moveToken(7); // get first number of the vfov
-        camera.perspective.vfov = parseFloat();
-        parseToLineEnd();
-
-        moveToken(7); // get first number of the near
-        camera.perspective.near = parseFloat();
-
-        if (sceneFile[current_index] == ',')
+        if (key == "name")
+            camera.name = tokenizer.readString();
+        else if (key == "perspective")
         {
-            parseToLineEnd();
-            moveToken(6); // get first number of the far
-            camera.perspective.far = parseFloat();
+            hasPerspective = true;
+
+            std::string_view parameter;
+            tokenizer.beginObject();
+            while (tokenizer.nextKey(parameter))
+            {
+                if (parameter == "aspect")
+                    camera.perspective.aspect = tokenizer.readFloat();
+                else if (parameter == "vfov")
+                    camera.perspective.vfov = tokenizer.readFloat();
+                else if (parameter == "near")
+                    camera.perspective.near = tokenizer.readFloat();
+                else if (parameter == "far")
+                    camera.perspective.far = tokenizer.readFloat();
+                else
+                    tokenizer.skipValue();
+            }
         }
-    }
-    else
-    {
-        throw std::logic_error("require orthographic camera!");
+        else
+            tokenizer.skipValue();
     }
 
-    // finish parsing camera
+    if (!hasPerspective)
+        throw std::logic_error("only perspective cameras are supported!");
 
     object.object = camera;
 
@@ -405,51 +272,47 @@ SceneObject SceneParser::parseDriver()
 
     object.type = Type::T_Driver;
     driver.id = object_index;
-    parseToLineEnd();
-
-    moveToken(8); // get first letter of the name
-    driver.name = parseString();
-    parseToLineEnd();
 
-    moveToken(7); // get first number of the node
-    driver.node = parseInteger();
-    parseToLineEnd();
-
-    moveToken(11); // get first letter of the channel
-    driver.channel = parseString();
-    parseToLineEnd();
-
-    moveToken(9); // get first number of the times
-    while (sceneFile[current_index] != ']')
-    {
-        driver.times.push_back(parseFloat());
-        if (sceneFile[current_index] == ']')
-        {
-            parseToLineEnd();
-            break;
-        }
-        moveToken(1); // skip ','
-    }
-
-    moveToken(10); // get first number of the values
-    while (sceneFile[current_index] != ']')
-    {
-        driver.values.push_back(parseFloat());
-        if (sceneFile[current_index] == ']')
-        {
-            parseToLineEnd();
-            break;
+    std::string_view key;
+    while (tokenizer.nextKey(key))
+    {
+        if (key == "name")
+            driver.name = tokenizer.readString();
+        else if (key == "node")
+            driver.node = tokenizer.readInteger();
+        else if (key == "channel")
+        {
+            // resolved once here so the per-frame evaluation never compares strings
+            std::string_view channel = tokenizer.readString();
+            if (channel == "translation")
+                driver.channel = DriverChannel::T_Translation;
+            else if (channel == "rotation")
+                driver.channel = DriverChannel::T_Rotation;
+            else if (channel == "scale")
+                driver.channel = DriverChannel::T_Scale;
+            else
+                throw std::runtime_error("unknown driver channel in .s72 file!");
+        }
+        else if (key == "times")
+            parseFloatArray(driver.times);
+        else if (key == "values")
+            parseFloatArray(driver.values);
+        else if (key == "interpolation")
+        {
+            std::string_view interpolation = tokenizer.readString();
+            if (interpolation == "STEP")
+                driver.interpolation = Interpolation::T_Step;
+            else if (interpolation == "LINEAR")
+                driver.interpolation = Interpolation::T_Linear;
+            else if (interpolation == "SLERP")
+                driver.interpolation = Interpolation::T_Slerp;
+            else
+                throw std::runtime_error("unknown driver interpolation in .s72 file!");
         }
-        moveToken(1); // skip ','
+        else
+            tokenizer.skipValue();
     }
 
-    /* assume always have interpolation */
-
-    moveToken(17); // get first letter of the interpolation
-    driver.interpolation = parseString();
-    current_index++; // skip '\"'
-    getNextToken();  // finish parsing driver
-
     object.object = driver;
 
     return object;
@@ -463,215 +326,98 @@ SceneObject SceneParser::parseMaterial()
 
     object.type = Type::T_Material;
     material.id = object_index;
-    parseToLineEnd();
-
-    moveToken(8); // get first letter of the name
-    material.name = parseString();
-    parseToLineEnd();
 
-    moveToken(1); // get first letter of next parameter
-    if (sceneFile[current_index] == 'n')
-    {
-        current_index += 20; // get first letter of the normalMap src
-        Texture texture;
-        texture.src = parseString();
-        textures.push_back(texture.src);
-        if (sceneFile[current_index + 1] != ',')
-        {
-            material.normalMap = texture;
-            parseToLineEnd();
-            moveToken(1);
-        }
-        else
-        {
-            /* explicit type and format */
-        }
-    }
-    else
-    {
-        Texture texture;
-        texture.src = "default-normal.png";
-        textures.push_back(texture.src);
-        material.normalMap = texture;
-    }
-    if (sceneFile[current_index] == 'd')
+    std::string_view key;
+    while (tokenizer.nextKey(key))
     {
-        current_index += 26; // get first letter of the displacementMap src
-        Texture texture;
-        texture.src = parseString();
-        textures.push_back(texture.src);
-        if (sceneFile[current_index + 1] != ',')
+        if (key == "name")
+            material.name = tokenizer.readString();
+        else if (key == "normalMap")
+            material.normalMap = parseTexture();
+        else if (key == "displacementMap")
+            material.displacementMap = parseTexture();
+        else if (key == "pbr")
         {
-            material.displacementMap = texture;
-            parseToLineEnd();
-            moveToken(1);
-        }
-        else
-        {
-            /* explicit type and format */
-        }
-    }
-    if (sceneFile[current_index] == 'p')
-    {
-        current_index += 6; // get to albedo
-        moveToken(9);       // get first letter of the albedo
-        if (sceneFile[current_index] == '[')
-        {
-            // constant value
-            moveToken(1); // get first number of the albedo
-            int R = static_cast<int>(parseFloat() * 255);
-            parseToLineEnd();
-            getNextToken();
-            float G = static_cast<int>(parseFloat() * 255);
-            parseToLineEnd();
-            getNextToken();
-            float B = static_cast<int>(parseFloat() * 255);
-            parseToLineEnd();
-
-            std::string filename = std::string("albedo") + std::to_string(object_index) + std::string(".png");
-            createPNG(filename.c_str(), 1, 1, R, G, B, 255);
-            Texture texture;
-            texture.src = filename;
-            textures.push_back(texture.src);
             material.pbr.emplace(); // must give it a empty value before call value()
-            material.pbr.value().albedo = texture;
-        }
-        else
-        {
-            // texture
-            moveToken(9); // get first letter of the albedo src
-            Texture texture;
-            texture.src = parseString();
-            textures.push_back(texture.src);
-            if (sceneFile[current_index + 1] != ',')
-            {
-                material.pbr.emplace(); // must give it a empty value before call value()
-                material.pbr.value().albedo = texture;
-                parseToLineEnd();
-            }
-            else
+            std::optional<Texture> albedo, roughness, metalness;
+
+            std::string_view parameter;
+            tokenizer.beginObject();
+            while (tokenizer.nextKey(parameter))
             {
-                /* explicit type and format */
+                if (parameter == "albedo")
+                    albedo = parseMaterialTexture("albedo");
+                else if (parameter == "roughness")
+                    roughness = parseMaterialTexture("roughness");
+                else if (parameter == "metalness")
+                    metalness = parseMaterialTexture("metalness");
+                else
+                    tokenizer.skipValue();
             }
-        }
 
-        moveToken(12); // get first number/letter of the roughness
-        if (sceneFile[current_index] != '{')
-        {
-            int R = static_cast<int>(parseFloat() * 255);
-            parseToLineEnd();
-            std::string filename = std::string("roughness") + std::to_string(object_index) + std::string(".png");
-            createPNG(filename.c_str(), 1, 1, R, R, R, 255);
-            Texture texture;
-            texture.src = filename;
-            textures.push_back(texture.src);
-            material.pbr.value().roughness = texture;
+            // default values from the s72 spec
+            material.pbr.value().albedo = albedo.has_value() ? albedo.value() : createConstantTexture("albedo", 255, 255, 255);
+            material.pbr.value().roughness = roughness.has_value() ? roughness.value() : createConstantTexture("roughness", 255, 255, 255);
+            material.pbr.value().metalness = metalness.has_value() ? metalness.value() : createConstantTexture("metalness", 0, 0, 0);
         }
-        else
+        else if (key == "lambertian")
         {
-            moveToken(9); // get first letter of the roughness src
-            Texture texture;
-            texture.src = parseString();
-            textures.push_back(texture.src);
-            if (sceneFile[current_index + 1] != ',')
-            {
-                material.pbr.value().roughness = texture;
-                parseToLineEnd();
-            }
-            else
+            material.lambertian.emplace(); // must give it a empty value before call value()
+            std::optional<Texture> albedo;
+
+            std::string_view parameter;
+            tokenizer.beginObject();
+            while (tokenizer.nextKey(parameter))
             {
-                /* explicit type and format */
+                if (parameter == "albedo")
+                    albedo = parseMaterialTexture("albedo");
+                else
+                    tokenizer.skipValue();
             }
-        }
 
-        moveToken(12); // get first number/letter of the metalness
-        if (sceneFile[current_index] != '{')
-        {
-            int R = static_cast<int>(parseFloat() * 255);
-            parseToLineEnd(); // finish parsing material
-
-            std::string filename = std::string("metalness") + std::to_string(object_index) + std::string(".png");
-            createPNG(filename.c_str(), 1, 1, R, R, R, 255);
-            Texture texture;
-            texture.src = filename;
-            textures.push_back(texture.src);
-            material.pbr.value().metalness = texture;
+            material.lambertian.value().albedo = albedo.has_value() ? albedo.value() : createConstantTexture("albedo", 255, 255, 255);
         }
-        else
+        else if (key == "mirror")
         {
-            moveToken(9); // get first letter of the metalness src
-            Texture texture;
-            texture.src = parseString();
-            textures.push_back(texture.src);
-            if (sceneFile[current_index + 1] != ',')
-            {
-                material.pbr.value().metalness = texture;
-                parseToLineEnd(); // finish parsing material
-            }
-            else
-            {
-                /* explicit type and format */
-            }
+            material.mirror = true;
+            tokenizer.skipValue();
         }
-    }
-    else if (sceneFile[current_index] == 'l')
-    {
-        current_index += 14; // get to albedo
-        moveToken(9);        // get first letter of the albedo
-        if (sceneFile[current_index] == '[')
+        else if (key == "environment")
         {
-            // constant value
-            moveToken(1); // get first number of the albedo
-            int R = static_cast<int>(parseFloat() * 255);
-            parseToLineEnd();
-            getNextToken();
-            float G = static_cast<int>(parseFloat() * 255);
-            parseToLineEnd();
-            getNextToken();
-            float B = static_cast<int>(parseFloat() * 255);
-            parseToLineEnd();
-
-            std::string filename = std::string("albedo") + std::to_string(object_index) + std::string(".png");
-            createPNG(filename.c_str(), 1, 1, R, G, B, 255);
-            Texture texture;
-            texture.src = filename;
-            textures.push_back(texture.src);
-            material.lambertian.emplace(); // must give it a empty value before call value()
-            material.lambertian.value().albedo = texture;
+            material.environment = true;
+            tokenizer.skipValue();
         }
-        else
+        else if (key == "simple")
         {
-            // texture
-            moveToken(9); // get first letter of the albedo src
-            Texture texture;
-            texture.src = parseString();
-            textures.push_back(texture.src);
-            if (sceneFile[current_index + 1] != ',')
-            {
-                material.lambertian.emplace(); // must give it a empty value before call value()
-                material.lambertian.value().albedo = texture;
-                parseToLineEnd(); // finish parsing material
-            }
-            else
-            {
-                /* explicit type and format */
-            }
+            material.simple = true;
+            tokenizer.skipValue();
         }
+        else
+            tokenizer.skipValue();
+    }
+
+    if (!material.normalMap.has_value())
+    {
+        Texture texture;
+        texture.src = "default-normal.png";
+        material.normalMap = texture;
     }
-    else if (sceneFile[current_index] == 'm')
+
+    // texture order decides the binding points in the material's descriptor set
+    textures.push_back(material.normalMap.value().src);
+    if (material.displacementMap.has_value())
     {
-        material.mirror = true;
-        parseToLineEnd(); // finish parsing material
+        textures.push_back(material.displacementMap.value().src);
     }
-    else if (sceneFile[current_index] == 'e')
+    if (material.pbr.has_value())
     {
-        material.environment = true;
-        parseToLineEnd(); // finish parsing material
+        textures.push_back(material.pbr.value().albedo.src);
+        textures.push_back(material.pbr.value().roughness.src);
+        textures.push_back(material.pbr.value().metalness.src);
     }
-    else if (sceneFile[current_index] == 's')
+    else if (material.lambertian.has_value())
     {
-        material.simple = true;
-        parseToLineEnd(); // finish parsing material
+        textures.push_back(material.lambertian.value().albedo.src);
     }
 
     materialTexturePair.insert({material.id, textures});
@@ -688,44 +434,153 @@ SceneObject SceneParser::parseEnvironment()
 
     object.type = Type::T_Environment;
     environment.id = object_index;
-    parseToLineEnd();
 
-    moveToken(8); // get first letter of the name
-    environment.name = parseString();
-    parseToLineEnd();
+    std::string_view key;
+    while (tokenizer.nextKey(key))
+    {
+        if (key == "name")
+            environment.name = tokenizer.readString();
+        else if (key == "radiance")
+            environment.radiance = parseTexture();
+        else
+            tokenizer.skipValue();
+    }
 
-    moveToken(20); // get first letter of the radiance src
-    environment.radiance.src = parseString();
-    parseToLineEnd();
+    object.object = environment;
 
-    moveToken(8); // get first letter of the radiance type
-    environment.radiance.type = parseString();
-    parseToLineEnd();
+    return object;
+}
 
-    moveToken(10); // get first letter of the radiance format
-    environment.radiance.format = parseString();
-    parseToLineEnd(); // finish parsing environment
+MeshAttribute SceneParser::parseMeshAttribute()
+{
+    MeshAttribute attribute;
+
+    std::string_view key;
+    tokenizer.beginObject();
+    while (tokenizer.nextKey(key))
+    {
+        if (key == "src")
+            attribute.src = tokenizer.readString();
+        else if (key == "offset")
+            attribute.offset = tokenizer.readInteger();
+        else if (key == "stride")
+            attribute.stride = tokenizer.readInteger();
+        else if (key == "format")
+            attribute.format = tokenizer.readString();
+        else
+            tokenizer.skipValue();
+    }
 
-    object.object = environment;
+    return attribute;
+}
 
-    return object;
+Texture SceneParser::parseTexture()
+{
+    Texture texture;
+
+    std::string_view key;
+    tokenizer.beginObject();
+    while (tokenizer.nextKey(key))
+    {
+        if (key == "src")
+            texture.src = tokenizer.readString();
+        else if (key == "type")
+            texture.type = tokenizer.readString();
+        else if (key == "format")
+            texture.format = tokenizer.readString();
+        else
+            tokenizer.skipValue();
+    }
+
+    return texture;
+}
+
+Texture SceneParser::parseMaterialTexture(const std::string &name)
+{
+    TokenType type = tokenizer.peek().type;
+    if (type == TokenType::T_BeginObject)
+    {
+        return parseTexture();
+    }
+    if (type == TokenType::T_BeginArray)
+    {
+        // constant color
+        float rgb[3] = {};
+        size_t count = 0;
+        tokenizer.beginArray();
+        while (tokenizer.nextElement())
+        {
+            float value = tokenizer.readFloat();
+            if (count < 3)
+                rgb[count++] = value;
+        }
+        return createConstantTexture(name, static_cast<int>(rgb[0] * 255), static_cast<int>(rgb[1] * 255), static_cast<int>(rgb[2] * 255));
+    }
+
+    // constant value
+    int R = static_cast<int>(tokenizer.readFloat() * 255);
+    return createConstantTexture(name, R, R, R);
+}
+
+Texture SceneParser::createConstantTexture(const std::string &name, int R, int G, int B)
+{
+    std::string filename = name + std::to_string(object_index) + std::string(".png");
+    createPNG(filename.c_str(), 1, 1, R, G, B, 255);
+
+    Texture texture;
+    texture.src = filename;
+    return texture;
+}
+
+void SceneParser::parseFloatArray(std::vector<float> &values)
+{
+    values.clear();
+    tokenizer.beginArray();
+    while (tokenizer.nextElement())
+    {
+        values.push_back(tokenizer.readFloat());
+    }
+}
+
+void SceneParser::parseIntegerArray(std::vector<uint32_t> &values)
+{
+    values.clear();
+    tokenizer.beginArray();
+    while (tokenizer.nextElement())
+    {
+        values.push_back(tokenizer.readInteger());
+    }
 }
 
-SceneStructure SceneParser::parseSceneStructure()
+SceneStructure SceneParser::parseSceneStructure(bool parallel)
 {
     SceneStructure sceneStructure;
 
-    while (!finish)
+    if (parallel)
+    {
+        parseObjectsParallel(sceneStructure.objects);
+    }
+    else
     {
-        std::optional<SceneObject> obj = parse();
-        if (obj.has_value())
-            sceneStructure.objects.push_back(obj.value());
+        while (!finish)
+        {
+            std::optional<SceneObject> obj = parse();
+            if (obj.has_value())
+                sceneStructure.objects.push_back(std::move(obj.value()));
+        }
     }
 
     // record all texture file names that used in the scene for initScene
     sceneStructure.materialTexturePair = materialTexturePair;
 
-    for (auto obj : sceneStructure.objects)
+    finalizeSceneStructure(sceneStructure);
+
+    return sceneStructure;
+}
+
+void SceneParser::finalizeSceneStructure(SceneStructure &sceneStructure)
+{
+    for (const auto &obj : sceneStructure.objects)
     {
         if (obj.type == Type::T_Driver)
         {
@@ -745,21 +600,17 @@ SceneStructure SceneParser::parseSceneStructure()
         }
     }
 
-    for (auto root : sceneStructure.scene.roots)
-    {
-        std::vector<glm::mat4> parentTransforms;
-        recordTransform(sceneStructure, std::get<Node>(sceneStructure.objects[root - 1].object), parentTransforms);
-    }
+    buildTransformHierarchy(sceneStructure);
 
     // record the relationship between meshes and materials
     if (!sceneStructure.materials.empty())
     {
         // for each mesh vbo, find the material index in the material list, for binding correct descriptor set
-        for (auto mesh : sceneStructure.meshes)
+        for (const auto &mesh : sceneStructure.meshes)
         {
             uint32_t materialCount = 0;
 
-            for (auto material : sceneStructure.materials)
+            for (const auto &material : sceneStructure.materials)
             {
                 if (mesh.mesh.material == material.id)
                 {
@@ -787,214 +638,286 @@ SceneStructure SceneParser::parseSceneStructure()
             }
         }
     }
-
-    return sceneStructure;
 }
 
-void SceneParser::recordTransform(SceneStructure &structure, Node node, std::vector<glm::mat4> parentTransforms, float time)
+void SceneParser::parseObjectsParallel(std::vector<SceneObject> &objects)
 {
-    glm::mat4 translation = glm::translate(glm::mat4(1.0f), glm::vec3(node.translation[0], node.translation[1], node.translation[2]));
-    glm::mat4 rotation = glm::mat4_cast(glm::quat(node.rotation[3], node.rotation[0], node.rotation[1], node.rotation[2]));
-    glm::mat4 scale = glm::scale(glm::mat4(1.0f), glm::vec3(node.scale[0], node.scale[1], node.scale[2]));
-
-    if (time > 0.0f)
+    // find the object boundaries with a cheap byte scan, every object can then be parsed on its own
+    std::vector<std::string_view> objectTexts;
+    while (tokenizer.nextElement())
     {
-        for (auto driver : structure.drivers)
+        objectTexts.push_back(tokenizer.scanValue());
+    }
+    finish = true;
+
+    objects.resize(objectTexts.size());
+    std::mutex materialMutex;
+
+    JobSystem::instance().parallelFor(objectTexts.size(), 256, [&](size_t first, size_t last)
+                                      {
+        for (size_t i = first; i < last; ++i)
         {
-            if (node.id == driver.node)
+            // object ids are the 1-based position in the top-level array
+            SceneParser objectParser(objectTexts[i], static_cast<uint32_t>(i + 1));
+            objects[i] = objectParser.parseObject();
+
+            if (!objectParser.materialTexturePair.empty())
             {
-                if (driver.channel == "translation")
-                {
-                    glm::vec3 vec3;
-                    getInterpolatedValue(vec3, driver.interpolation, driver, time);
-                    translation = glm::translate(glm::mat4(1.0f), vec3);
-                }
-                else if (driver.channel == "rotation")
-                {
-                    glm::vec4 vec4;
-                    getInterpolatedValue(vec4, driver.interpolation, driver, time);
-                    rotation = glm::mat4_cast(glm::quat(vec4.w, vec4.x, vec4.y, vec4.z));
-                }
-                else if (driver.channel == "scale")
-                {
-                    glm::vec3 vec3;
-                    getInterpolatedValue(vec3, driver.interpolation, driver, time);
-                    scale = glm::scale(glm::mat4(1.0f), vec3);
-                }
+                std::lock_guard<std::mutex> lock(materialMutex);
+                materialTexturePair.merge(objectParser.materialTexturePair);
             }
-        }
-    }
+        } });
+
+    object_index = static_cast<uint32_t>(objectTexts.size());
+}
+
+// chunk size for the parallel transform loops, smaller levels just run on the calling thread
+const size_t TRANSFORM_GRAIN_SIZE = 1024;
+
+static glm::mat4 composeTransform(const glm::vec3 &translation, const glm::quat &rotation, const glm::vec3 &scale)
+{
+    // same as translate * rotate * scale without the two extra matrix products
+    glm::mat4 transform = glm::mat4_cast(rotation);
+    transform[0] *= scale.x;
+    transform[1] *= scale.y;
+    transform[2] *= scale.z;
+    transform[3] = glm::vec4(translation, 1.0f);
+    return transform;
+}
+
+void SceneParser::buildTransformHierarchy(SceneStructure &structure)
+{
+    const uint32_t NO_SLOT = 0xFFFFFFFF;
+    TransformHierarchy &hierarchy = structure.hierarchy;
+    hierarchy = TransformHierarchy();
+    structure.meshes.clear();
+    structure.cameras.clear();
+
+    std::vector<uint32_t> nodeSlotOfObject(structure.objects.size(), NO_SLOT);
+    std::unordered_map<uint32_t, uint32_t> meshSlotOfId;
 
-    glm::mat4 transform = translation * rotation * scale;
-    parentTransforms.push_back(transform);
-    glm::mat4 totalTransform = glm::mat4(1.0f);
-    for (size_t i = parentTransforms.size(); i > 0; --i)
+    // explicit stack of (node id, parent entry), children are pushed in reverse to keep the recursive visiting order
+    std::vector<std::pair<uint32_t, int32_t>> stack;
+    for (auto iter = structure.scene.roots.rbegin(); iter != structure.scene.roots.rend(); ++iter)
     {
-        totalTransform = parentTransforms[i - 1] * totalTransform;
+        stack.push_back({*iter, -1});
     }
 
-    if (node.mesh.has_value())
+    while (!stack.empty())
     {
-        bool hasInstance = false;
-        for (auto &renderInfo : structure.meshes)
+        auto [id, parent] = stack.back();
+        stack.pop_back();
+
+        const Node &node = std::get<Node>(structure.objects[id - 1].object);
+        uint32_t slot = nodeSlotOfObject[id - 1];
+        if (slot == NO_SLOT)
+        {
+            slot = static_cast<uint32_t>(hierarchy.nodeIds.size());
+            nodeSlotOfObject[id - 1] = slot;
+            hierarchy.nodeIds.push_back(id);
+            hierarchy.translations.push_back(glm::vec3(node.translation[0], node.translation[1], node.translation[2]));
+            hierarchy.rotations.push_back(glm::quat(node.rotation[3], node.rotation[0], node.rotation[1], node.rotation[2]));
+            hierarchy.scales.push_back(glm::vec3(node.scale[0], node.scale[1], node.scale[2]));
+            hierarchy.locals.push_back(composeTransform(hierarchy.translations.back(), hierarchy.rotations.back(), hierarchy.scales.back()));
+        }
+
+        int32_t entry = static_cast<int32_t>(hierarchy.nodeSlots.size());
+        hierarchy.nodeSlots.push_back(slot);
+        hierarchy.parents.push_back(parent);
+
+        if (node.mesh.has_value())
         {
-            if (node.mesh.value() == renderInfo.mesh.id)
+            auto meshSlot = meshSlotOfId.find(node.mesh.value());
+            if (meshSlot == meshSlotOfId.end())
             {
-                hasInstance = true;
-                renderInfo.transforms.push_back(totalTransform);
-                break;
+                MeshRenderInfo renderInfo;
+                renderInfo.mesh = std::get<Mesh>(structure.objects[node.mesh.value() - 1].object);
+                meshSlot = meshSlotOfId.insert({node.mesh.value(), static_cast<uint32_t>(structure.meshes.size())}).first;
+                structure.meshes.push_back(std::move(renderInfo));
             }
+
+            MeshRenderInfo &renderInfo = structure.meshes[meshSlot->second];
+            hierarchy.meshEntries.push_back(entry);
+            hierarchy.meshSlots.push_back(meshSlot->second);
+            hierarchy.meshInstances.push_back(static_cast<uint32_t>(renderInfo.transforms.size()));
+            renderInfo.transforms.push_back(glm::mat4(1.0f));
+        }
+        if (node.camera.has_value())
+        {
+            CameraRenderInfo renderInfo;
+            renderInfo.camera = std::get<Camera>(structure.objects[node.camera.value() - 1].object);
+            renderInfo.transform = glm::mat4(1.0f);
+            hierarchy.cameraEntries.push_back(entry);
+            structure.cameras.push_back(renderInfo);
+        }
+        if (node.environment.has_value())
+        {
+            structure.environment.emplace(std::get<Environment>(structure.objects[node.environment.value() - 1].object));
         }
 
-        if (!hasInstance)
+        for (auto iter = node.children.rbegin(); iter != node.children.rend(); ++iter)
         {
-            MeshRenderInfo renderInfo;
-            renderInfo.mesh = std::get<Mesh>(structure.objects[node.mesh.value() - 1].object);
-            renderInfo.transforms.push_back(totalTransform);
-            structure.meshes.push_back(renderInfo);
+            stack.push_back({*iter, entry});
         }
     }
-    if (node.camera.has_value())
+    hierarchy.worlds.resize(hierarchy.nodeSlots.size());
+
+    // a later driver of the same node and channel overrides the earlier ones, so only the last one is kept
+    std::vector<std::array<int32_t, 3>> slotDrivers(hierarchy.nodeIds.size(), {-1, -1, -1});
+    for (size_t i = 0; i < structure.drivers.size(); ++i)
     {
-        CameraRenderInfo renderInfo;
-        renderInfo.camera = std::get<Camera>(structure.objects[node.camera.value() - 1].object);
-        renderInfo.transform = totalTransform;
-        structure.cameras.push_back(renderInfo);
+        uint32_t node = structure.drivers[i].node;
+        if (node == 0 || node > structure.objects.size() || nodeSlotOfObject[node - 1] == NO_SLOT)
+            continue;
+        slotDrivers[nodeSlotOfObject[node - 1]][static_cast<size_t>(structure.drivers[i].channel)] = static_cast<int32_t>(i);
     }
-    if (node.environment.has_value())
+    for (uint32_t slot = 0; slot < slotDrivers.size(); ++slot)
     {
-        Environment environment = std::get<Environment>(structure.objects[node.environment.value() - 1].object);
-        structure.environment.emplace(environment);
+        bool animated = false;
+        for (auto driver : slotDrivers[slot])
+        {
+            if (driver < 0)
+                continue;
+            const Driver &channel = structure.drivers[driver];
+            hierarchy.animation.addChannel(channel.channel, channel.interpolation, channel.times, channel.values, static_cast<uint32_t>(hierarchy.animatedSlots.size()));
+            animated = true;
+        }
+        if (animated)
+            hierarchy.animatedSlots.push_back(slot);
     }
-    if (!node.children.empty())
+    hierarchy.poseTranslations.resize(hierarchy.animatedSlots.size());
+    hierarchy.poseRotations.resize(hierarchy.animatedSlots.size());
+    hierarchy.poseScales.resize(hierarchy.animatedSlots.size());
+
+    // an entry is dynamic if its node is animated or its parent is dynamic, parents are always visited first
+    std::vector<bool> animated(hierarchy.nodeIds.size(), false);
+    for (auto slot : hierarchy.animatedSlots)
+    {
+        animated[slot] = true;
+    }
+    std::vector<bool> dynamic(hierarchy.nodeSlots.size(), false);
+    std::vector<uint32_t> depths(hierarchy.nodeSlots.size(), 0);
+    std::vector<uint32_t> levelCounts;
+    for (size_t i = 0; i < hierarchy.nodeSlots.size(); ++i)
     {
-        for (auto child : node.children)
+        int32_t parent = hierarchy.parents[i];
+        dynamic[i] = animated[hierarchy.nodeSlots[i]] || (parent >= 0 && dynamic[parent]);
+        depths[i] = parent < 0 ? 0 : depths[parent] + 1;
+        if (dynamic[i])
         {
-            recordTransform(structure, std::get<Node>(structure.objects[child - 1].object), parentTransforms, time);
+            hierarchy.dynamicEntries.push_back(static_cast<uint32_t>(i));
+            if (levelCounts.size() <= depths[i])
+                levelCounts.resize(depths[i] + 1, 0);
+            levelCounts[depths[i]]++;
         }
     }
-}
 
-void SceneParser::getInterpolatedValue(glm::vec3 &vec, std::string method, const Driver &driver, float time)
-{
-    auto iter = std::lower_bound(driver.times.begin(), driver.times.end(), time);
-    if (iter == driver.times.end())
+    // bucket the dynamic entries by depth, a level only depends on the ones above it
+    hierarchy.dynamicLevelOffsets.assign(levelCounts.size() + 1, 0);
+    for (size_t i = 0; i < levelCounts.size(); ++i)
     {
-        vec = glm::vec3(*(driver.values.end() - 3), *(driver.values.end() - 2), *(driver.values.end() - 1));
-        return;
+        hierarchy.dynamicLevelOffsets[i + 1] = hierarchy.dynamicLevelOffsets[i] + levelCounts[i];
     }
-
-    uint32_t index = iter - driver.times.begin();
-    if (method == "STEP")
+    std::vector<uint32_t> levelFill(hierarchy.dynamicLevelOffsets.begin(), hierarchy.dynamicLevelOffsets.end() - 1);
+    std::vector<uint32_t> sortedEntries(hierarchy.dynamicEntries.size());
+    for (auto entry : hierarchy.dynamicEntries)
     {
-        vec = glm::vec3(driver.values[(index - 1) * 3], driver.values[(index - 1) * 3 + 1], driver.values[(index - 1) * 3 + 2]);
+        sortedEntries[levelFill[depths[entry]]++] = entry;
     }
-    else if (method == "LINEAR")
+    hierarchy.dynamicEntries = std::move(sortedEntries);
+
+    // uniform data is laid out mesh by mesh, instances in visiting order
+    std::vector<uint32_t> uniformOffsets(structure.meshes.size(), 0);
+    for (size_t i = 1; i < structure.meshes.size(); ++i)
     {
-        float lerpValue = (time - *iter) / (*(iter - 1) - *iter);
-        vec = glm::vec3(lerpValue * driver.values[(index - 1) * 3] + (1 - lerpValue) * driver.values[index * 3], lerpValue * driver.values[(index - 1) * 3 + 1] + (1 - lerpValue) * driver.values[index * 3 + 1], lerpValue * driver.values[(index - 1) * 3 + 2] + (1 - lerpValue) * driver.values[index * 3 + 2]);
+        uniformOffsets[i] = uniformOffsets[i - 1] + static_cast<uint32_t>(structure.meshes[i - 1].transforms.size());
     }
-    else if (method == "SLERP")
+    for (size_t i = 0; i < hierarchy.meshEntries.size(); ++i)
     {
-        // is this even possible?
+        hierarchy.meshUniforms.push_back(uniformOffsets[hierarchy.meshSlots[i]] + hierarchy.meshInstances[i]);
+        if (dynamic[hierarchy.meshEntries[i]])
+            hierarchy.dynamicMeshes.push_back(static_cast<uint32_t>(i));
     }
-}
-
-void SceneParser::getInterpolatedValue(glm::vec4 &vec, std::string method, const Driver &driver, float time)
-{
-    auto iter = std::lower_bound(driver.times.begin(), driver.times.end(), time);
-    if (iter == driver.times.end())
+    for (size_t i = 0; i < hierarchy.cameraEntries.size(); ++i)
     {
-        vec = glm::vec4(*(driver.values.end() - 4), *(driver.values.end() - 3), *(driver.values.end() - 2), *(driver.values.end() - 1));
-        return;
+        if (dynamic[hierarchy.cameraEntries[i]])
+            hierarchy.dynamicCameras.push_back(static_cast<uint32_t>(i));
     }
 
-    uint32_t index = iter - driver.times.begin();
-    if (method == "STEP")
+    // static entries are computed here once and never touched again
+    for (size_t i = 0; i < hierarchy.nodeSlots.size(); ++i)
     {
-        vec = glm::vec4(driver.values[(index - 1) * 4], driver.values[(index - 1) * 4 + 1], driver.values[(index - 1) * 4 + 2], driver.values[(index - 1) * 4 + 3]);
+        const glm::mat4 &local = hierarchy.locals[hierarchy.nodeSlots[i]];
+        int32_t parent = hierarchy.parents[i];
+        hierarchy.worlds[i] = parent < 0 ? local : hierarchy.worlds[parent] * local;
     }
-    else if (method == "LINEAR")
+    for (size_t i = 0; i < hierarchy.meshEntries.size(); ++i)
     {
-        float lerpValue = (time - *iter) / (*(iter - 1) - *iter);
-        vec = glm::vec4(lerpValue * driver.values[(index - 1) * 4] + (1 - lerpValue) * driver.values[index * 4], lerpValue * driver.values[(index - 1) * 4 + 1] + (1 - lerpValue) * driver.values[index * 4 + 1], lerpValue * driver.values[(index - 1) * 4 + 2] + (1 - lerpValue) * driver.values[index * 4 + 2], lerpValue * driver.values[(index - 1) * 4 + 3] + (1 - lerpValue) * driver.values[index * 4 + 3]);
+        structure.meshes[hierarchy.meshSlots[i]].transforms[hierarchy.meshInstances[i]] = hierarchy.worlds[hierarchy.meshEntries[i]];
     }
-    else if (method == "SLERP")
+    for (size_t i = 0; i < hierarchy.cameraEntries.size(); ++i)
     {
-        glm::vec4 q1 = glm::vec4(driver.values[(index - 1) * 4], driver.values[(index - 1) * 4 + 1], driver.values[(index - 1) * 4 + 2], driver.values[(index - 1) * 4 + 3]);
-        glm::vec4 q2 = glm::vec4(driver.values[(index) * 4], driver.values[(index) * 4 + 1], driver.values[(index) * 4 + 2], driver.values[(index) * 4 + 3]);
-        if (glm::dot(q1, q2) < 0.0f)
-        {
-            q2 = glm::vec4(-q2.x, -q2.y, -q2.z, -q2.w); // ensure interpolation is along the shortest path
-        }
-        float theta = std::acosf(glm::dot(q1, q2));
-        float lerpValue = time - *(iter - 1);
-        vec = std::sinf((1 - lerpValue) * theta) / std::sinf(theta) * q1 + std::sinf(lerpValue * theta) / std::sinf(theta) * q2;
+        structure.cameras[i].transform = hierarchy.worlds[hierarchy.cameraEntries[i]];
     }
+    hierarchy.lastTime = 0.0f;
 }
 
-char SceneParser::getNextToken()
+void SceneParser::updateTransforms(SceneStructure &structure, float time)
 {
-    while (std::isspace(sceneFile[current_index]) || sceneFile[current_index] == '}')
-        current_index++;
-
-    if (current_index >= max_index)
-        throw std::logic_error("exceeded the file range!");
-
-    return sceneFile[current_index];
-}
-
-void SceneParser::moveToken(uint32_t number)
-{
-    getNextToken();
-    current_index += number;
-    getNextToken();
-}
-
-void SceneParser::parseToLineEnd()
-{
-    while (sceneFile[current_index] != ',')
-        current_index++;
-    current_index++; // go to the next line
-}
+    TransformHierarchy &hierarchy = structure.hierarchy;
+    hierarchy.dirtyInstances.clear();
 
-std::string SceneParser::parseString()
-{
-    std::string str = "";
+    // nothing moves while the animation is paused
+    if (time == hierarchy.lastTime)
+        return;
+    hierarchy.lastTime = time;
 
-    while (sceneFile[current_index] != '\"')
+    // only animated nodes need a new local matrix, everything else keeps its rest pose
+    for (size_t i = 0; i < hierarchy.animatedSlots.size(); ++i)
     {
-        str += sceneFile[current_index];
-        current_index++;
+        uint32_t slot = hierarchy.animatedSlots[i];
+        hierarchy.poseTranslations[i] = hierarchy.translations[slot];
+        hierarchy.poseRotations[i] = hierarchy.rotations[slot];
+        hierarchy.poseScales[i] = hierarchy.scales[slot];
     }
-
-    return str;
-}
-
-uint32_t SceneParser::parseInteger()
-{
-    std::string str = "";
-
-    while (std::isdigit(sceneFile[current_index]))
+    if (time > 0.0f)
     {
-        str += sceneFile[current_index];
-        current_index++;
+        hierarchy.animation.evaluate(time, hierarchy.poseTranslations.data(), hierarchy.poseRotations.data(), hierarchy.poseScales.data());
+    }
+    for (size_t i = 0; i < hierarchy.animatedSlots.size(); ++i)
+    {
+        hierarchy.locals[hierarchy.animatedSlots[i]] = composeTransform(hierarchy.poseTranslations[i], hierarchy.poseRotations[i], hierarchy.poseScales[i]);
     }
 
-    return static_cast<uint32_t>(std::stoul(str));
-}
-
-float SceneParser::parseFloat()
-{
-    std::string str = "";
-
-    while (std::isdigit(sceneFile[current_index]) || sceneFile[current_index] == '.' || sceneFile[current_index] == '-' || sceneFile[current_index] == 'e')
+    // every world matrix is one product with its parent's, which is finished once the level above is done
+    for (size_t level = 0; level + 1 < hierarchy.dynamicLevelOffsets.size(); ++level)
     {
-        str += sceneFile[current_index];
-        current_index++;
+        uint32_t levelBegin = hierarchy.dynamicLevelOffsets[level];
+        JobSystem::instance().parallelFor(hierarchy.dynamicLevelOffsets[level + 1] - levelBegin, TRANSFORM_GRAIN_SIZE, [&hierarchy, levelBegin](size_t first, size_t last)
+                                          {
+            for (size_t i = levelBegin + first; i < levelBegin + last; ++i)
+            {
+                uint32_t entry = hierarchy.dynamicEntries[i];
+                const glm::mat4 &local = hierarchy.locals[hierarchy.nodeSlots[entry]];
+                int32_t parent = hierarchy.parents[entry];
+                hierarchy.worlds[entry] = parent < 0 ? local : hierarchy.worlds[parent] * local;
+            } });
     }
 
-    return std::stof(str);
+    // instances are disjoint, so they are written in parallel too
+    hierarchy.dirtyInstances.resize(hierarchy.dynamicMeshes.size());
+    JobSystem::instance().parallelFor(hierarchy.dynamicMeshes.size(), TRANSFORM_GRAIN_SIZE, [&structure, &hierarchy](size_t first, size_t last)
+                                      {
+        for (size_t i = first; i < last; ++i)
+        {
+            uint32_t mesh = hierarchy.dynamicMeshes[i];
+            structure.meshes[hierarchy.meshSlots[mesh]].transforms[hierarchy.meshInstances[mesh]] = hierarchy.worlds[hierarchy.meshEntries[mesh]];
+            hierarchy.dirtyInstances[i] = hierarchy.meshUniforms[mesh];
+        } });
+    for (auto camera : hierarchy.dynamicCameras)
+    {
+        structure.cameras[camera].transform = hierarchy.worlds[hierarchy.cameraEntries[camera]];
+    }
 }
 
 bool SceneParser::finishParsing()
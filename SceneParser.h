@@ -12,10 +12,17 @@
 #include <cstdint>
 #include <string>
 #include <vector>
+#include <array>
 #include <variant>
 #include <optional>
 #include <unordered_map>
 
+#include "SceneTokenizer.h"
+#include "PlatformHelper.h"
+#include "JobSystem.h"
+#include "CullingHelper.h"
+#include "AnimationHelper.h"
+
 enum class Type
 {
     T_Scene,
@@ -63,6 +70,7 @@ struct Mesh
     uint32_t count;
     std::vector<MeshAttribute> attributes;
     std::optional<uint32_t> material;
+    std::optional<AABB> bounds; // only known up front when loaded from a compiled scene
 };
 
 struct CameraInfo
@@ -86,10 +94,10 @@ struct Driver
     uint32_t id;
     std::string name;
     uint32_t node;
-    std::string channel;
+    DriverChannel channel;
     std::vector<float> times;
     std::vector<float> values;
-    std::string interpolation = "LINEAR";
+    Interpolation interpolation = Interpolation::T_Linear;
 };
 
 struct Texture
@@ -149,6 +157,46 @@ struct CameraRenderInfo
     glm::mat4 transform;
 };
 
+// scene graph flattened for the per-frame update, a node reached through several parents gets one entry per path
+struct TransformHierarchy
+{
+    // per node slot, every node reachable from the scene roots has one slot
+    std::vector<uint32_t> nodeIds;
+    std::vector<glm::vec3> translations;
+    std::vector<glm::quat> rotations;
+    std::vector<glm::vec3> scales;
+    std::vector<glm::mat4> locals;
+
+    // per entry in depth-first order, so a parent always comes before its children
+    std::vector<uint32_t> nodeSlots;
+    std::vector<int32_t> parents; // -1 for roots
+    std::vector<glm::mat4> worlds;
+
+    // entries that carry a mesh instance or a camera, and where their world matrix goes
+    std::vector<uint32_t> meshEntries;
+    std::vector<uint32_t> meshSlots;
+    std::vector<uint32_t> meshInstances;
+    std::vector<uint32_t> meshUniforms; // index of the instance in the flattened uniform data
+    std::vector<uint32_t> cameraEntries;
+
+    // animated node slots, their pose is rebuilt from the rest pose and the batched driver results every update
+    std::vector<uint32_t> animatedSlots;
+    std::vector<glm::vec3> poseTranslations;
+    std::vector<glm::quat> poseRotations;
+    std::vector<glm::vec3> poseScales;
+    AnimationEvaluator animation; // channel targets are indices into animatedSlots
+
+    // entries that are animated or below an animated node, the only ones recomputed per frame,
+    // sorted by depth so each level of dynamicLevelOffsets can be computed in parallel
+    std::vector<uint32_t> dynamicEntries;
+    std::vector<uint32_t> dynamicLevelOffsets;
+    std::vector<uint32_t> dynamicMeshes;  // into meshEntries
+    std::vector<uint32_t> dynamicCameras; // into cameraEntries
+    // uniform indices whose matrix changed in the last update
+    std::vector<uint32_t> dirtyInstances;
+    float lastTime = 0.0f;
+};
+
 struct SceneStructure
 {
     std::vector<MeshRenderInfo> meshes;
@@ -161,23 +209,41 @@ struct SceneStructure
     std::vector<uint32_t> vboPipelineId;
     std::unordered_map<uint32_t, std::vector<std::string>> materialTexturePair;
     std::vector<SceneObject> objects;
+    TransformHierarchy hierarchy;
 };
 
 class SceneParser
 {
 private:
-    std::vector<char> sceneFile;
-    uint32_t current_index = 0;
-    uint32_t max_index = 0;
+    MappedFile mappedSceneFile;
+    std::vector<char> sceneFile; // fallback when the file can't be memory-mapped
+    SceneTokenizer tokenizer;
     uint32_t object_index = 0;
     bool finish = false;
     std::unordered_map<uint32_t, std::vector<std::string>> materialTexturePair;
 
+    // parser for a single object slice of the file, used by the parallel path
+    SceneParser(std::string_view objectText, uint32_t index);
+    SceneObject parseObject();
+    void parseObjectsParallel(std::vector<SceneObject> &objects);
+
+    MeshAttribute parseMeshAttribute();
+    Texture parseTexture();
+    Texture parseMaterialTexture(const std::string &name);
+    Texture createConstantTexture(const std::string &name, int R, int G, int B);
+    void parseFloatArray(std::vector<float> &values);
+    void parseIntegerArray(std::vector<uint32_t> &values);
+
+    static void buildTransformHierarchy(SceneStructure &structure);
+
 public:
-    SceneParser(const std::string &filename);
+    SceneParser(const std::string &filename, bool useMapping = true);
     ~SceneParser();
 
+    bool isMapped() const;
+
     std::optional<SceneObject> parse();
+    // the object is already open, its keys are read up to the closing brace
     SceneObject parseScene();
     SceneObject parseNode();
     SceneObject parseMesh();
@@ -186,17 +252,13 @@ public:
     SceneObject parseMaterial();
     SceneObject parseEnvironment();
 
-    SceneStructure parseSceneStructure();
-    static void recordTransform(SceneStructure &structure, Node node, std::vector<glm::mat4> parentTransforms, float time = 0.0f);
-    static void getInterpolatedValue(glm::vec3 &vec, std::string method, const Driver &driver, float time);
-    static void getInterpolatedValue(glm::vec4 &vec, std::string method, const Driver &driver, float time);
-
-    char getNextToken();
-    void moveToken(uint32_t number);
-    void parseToLineEnd();
-    std::string parseString();
-    uint32_t parseInteger();
-    float parseFloat();
+    // parallel parsing splits the top-level array into objects first and parses them on the job system
+    SceneStructure parseSceneStructure(bool parallel = false);
+    // fills the per-type lists, mesh instances and material bindings from structure.objects
+    static void finalizeSceneStructure(SceneStructure &structure);
+    // recomputes animated locals and the world matrices of their subtrees, then writes them to meshes and cameras
+    static void updateTransforms(SceneStructure &structure, float time = 0.0f);
+
     bool finishParsing();
 };
 
@@ -0,0 +1,250 @@
+#include "SceneTokenizer.h"
+
+#include <charconv>
+#include <cstring>
+
+SceneTokenizer::SceneTokenizer(const char *data, size_t size)
+{
+    begin = data;
+    current = data;
+    end = data + size;
+}
+
+void SceneTokenizer::skipWhitespace()
+{
+    while (current < end && (*current == ' ' || *current == '\n' || *current == '\r' || *current == '\t'))
+        current++;
+}
+
+Token SceneTokenizer::next()
+{
+    skipWhitespace();
+
+    if (current >= end)
+        return Token{TokenType::T_End, {}};
+
+    const char *start = current;
+    switch (*current)
+    {
+    case '{':
+        current++;
+        return Token{TokenType::T_BeginObject, {start, 1}};
+    case '}':
+        current++;
+        return Token{TokenType::T_EndObject, {start, 1}};
+    case '[':
+        current++;
+        return Token{TokenType::T_BeginArray, {start, 1}};
+    case ']':
+        current++;
+        return Token{TokenType::T_EndArray, {start, 1}};
+    case ':':
+        current++;
+        return Token{TokenType::T_Colon, {start, 1}};
+    case ',':
+        current++;
+        return Token{TokenType::T_Comma, {start, 1}};
+    case '\"':
+    {
+        start++; // skip opening quote
+        const char *quote = start;
+        while (true)
+        {
+            quote = static_cast<const char *>(std::memchr(quote, '\"', end - quote));
+            if (quote == nullptr)
+                throw std::runtime_error("unterminated string in .s72 file!");
+
+            // the quote is escaped if it is preceded by an odd number of backslashes
+            size_t backslashes = 0;
+            while (quote - backslashes > start && *(quote - backslashes - 1) == '\\')
+                backslashes++;
+            if (backslashes % 2 == 0)
+                break;
+            quote++;
+        }
+        current = quote + 1; // skip closing quote
+        return Token{TokenType::T_String, {start, static_cast<size_t>(quote - start)}};
+    }
+    default:
+        break;
+    }
+
+    if (*current == '-' || (*current >= '0' && *current <= '9'))
+    {
+        while (current < end && ((*current >= '0' && *current <= '9') || *current == '-' || *current == '+' || *current == '.' || *current == 'e' || *current == 'E'))
+            current++;
+        return Token{TokenType::T_Number, {start, static_cast<size_t>(current - start)}};
+    }
+    if (*current >= 'a' && *current <= 'z')
+    {
+        while (current < end && *current >= 'a' && *current <= 'z')
+            current++;
+        return Token{TokenType::T_Literal, {start, static_cast<size_t>(current - start)}};
+    }
+
+    throw std::runtime_error("unexpected character in .s72 file!");
+}
+
+Token SceneTokenizer::peek()
+{
+    const char *saved = current;
+    Token token = next();
+    current = saved;
+    return token;
+}
+
+void SceneTokenizer::expect(TokenType type)
+{
+    if (next().type != type)
+        throw std::runtime_error("unexpected token in .s72 file!");
+}
+
+void SceneTokenizer::beginObject()
+{
+    expect(TokenType::T_BeginObject);
+}
+
+bool SceneTokenizer::nextKey(std::string_view &key)
+{
+    Token token = next();
+    if (token.type == TokenType::T_EndObject)
+        return false;
+    if (token.type == TokenType::T_Comma)
+        token = next();
+    if (token.type != TokenType::T_String)
+        throw std::runtime_error("expected an object key in .s72 file!");
+
+    key = token.text;
+    expect(TokenType::T_Colon);
+    return true;
+}
+
+void SceneTokenizer::beginArray()
+{
+    expect(TokenType::T_BeginArray);
+}
+
+bool SceneTokenizer::nextElement()
+{
+    skipWhitespace();
+    if (current < end && *current == ']')
+    {
+        current++;
+        return false;
+    }
+    if (current < end && *current == ',')
+        current++;
+    if (current >= end)
+        throw std::runtime_error("unterminated array in .s72 file!");
+    return true;
+}
+
+std::string_view SceneTokenizer::readString()
+{
+    Token token = next();
+    if (token.type != TokenType::T_String)
+        throw std::runtime_error("expected a string in .s72 file!");
+    return token.text;
+}
+
+float SceneTokenizer::readFloat()
+{
+    Token token = next();
+    float value = 0.0f;
+    if (token.type != TokenType::T_Number)
+        throw std::runtime_error("expected a number in .s72 file!");
+    auto result = std::from_chars(token.text.data(), token.text.data() + token.text.size(), value);
+    if (result.ec != std::errc())
+        throw std::runtime_error("failed to parse float in .s72 file!");
+    return value;
+}
+
+uint32_t SceneTokenizer::readInteger()
+{
+    Token token = next();
+    uint32_t value = 0;
+    if (token.type != TokenType::T_Number)
+        throw std::runtime_error("expected a number in .s72 file!");
+    auto result = std::from_chars(token.text.data(), token.text.data() + token.text.size(), value);
+    if (result.ec != std::errc())
+        throw std::runtime_error("failed to parse integer in .s72 file!");
+    return value;
+}
+
+void SceneTokenizer::skipValue()
+{
+    uint32_t depth = 0;
+    do
+    {
+        Token token = next();
+        switch (token.type)
+        {
+        case TokenType::T_BeginObject:
+        case TokenType::T_BeginArray:
+            depth++;
+            break;
+        case TokenType::T_EndObject:
+        case TokenType::T_EndArray:
+            if (depth == 0)
+                throw std::runtime_error("unexpected token in .s72 file!");
+            depth--;
+            break;
+        case TokenType::T_End:
+            throw std::runtime_error("unexpected end of .s72 file!");
+        default:
+            break;
+        }
+    } while (depth > 0);
+}
+
+std::string_view SceneTokenizer::scanValue()
+{
+    skipWhitespace();
+    const char *start = current;
+
+    if (current < end && *current != '{' && *current != '[')
+    {
+        // scalars are short, the token scanner is good enough for them
+        next();
+        return std::string_view(start, static_cast<size_t>(current - start));
+    }
+
+    uint32_t depth = 0;
+    bool inString = false;
+    while (current < end)
+    {
+        char c = *current++;
+        if (inString)
+        {
+            if (c == '\\')
+                current++; // skip the escaped character
+            else if (c == '\"')
+                inString = false;
+        }
+        else if (c == '\"')
+        {
+            inString = true;
+        }
+        else if (c == '{' || c == '[')
+        {
+            depth++;
+        }
+        else if (c == '}' || c == ']')
+        {
+            if (--depth == 0)
+                return std::string_view(start, static_cast<size_t>(current - start));
+        }
+    }
+
+    throw std::runtime_error("unexpected end of .s72 file!");
+}
+
+size_t SceneTokenizer::position() const
+{
+    return static_cast<size_t>(current - begin);
+}
+
+void SceneTokenizer::seek(size_t position)
+{
+    current = begin + position;
+}
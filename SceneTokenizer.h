@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string_view>
+#include <stdexcept>
+
+enum class TokenType
+{
+    T_BeginObject,
+    T_EndObject,
+    T_BeginArray,
+    T_EndArray,
+    T_Colon,
+    T_Comma,
+    T_String,
+    T_Number,
+    T_Literal, // true, false or null
+    T_End
+};
+
+struct Token
+{
+    TokenType type;
+    std::string_view text; // slice of the scene buffer, strings are returned without quotes and escapes are not decoded
+};
+
+// single-pass JSON tokenizer working in place on a .s72 buffer, never allocates
+class SceneTokenizer
+{
+private:
+    const char *begin = nullptr;
+    const char *current = nullptr;
+    const char *end = nullptr;
+
+    void skipWhitespace();
+
+public:
+    SceneTokenizer() = default;
+    SceneTokenizer(const char *data, size_t size);
+
+    Token next();
+    Token peek();
+    void expect(TokenType type);
+
+    // usage: beginObject(); while (nextKey(key)) { read or skip the value }
+    void beginObject();
+    bool nextKey(std::string_view &key);
+    // usage: beginArray(); while (nextElement()) { read or skip the value }
+    void beginArray();
+    bool nextElement();
+
+    std::string_view readString();
+    float readFloat();
+    uint32_t readInteger();
+    void skipValue();
+    // byte-level skip of the next value without producing tokens, returns its raw text
+    std::string_view scanValue();
+
+    size_t position() const;
+    void seek(size_t position);
+};
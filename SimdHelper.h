@@ -0,0 +1,217 @@
+#pragma once
+
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+
+#if defined(__AVX512F__) || defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <immintrin.h>
+#endif
+
+// widest float vector the build targets, the batched paths are written once against SimdFloat<SIMD_WIDTH>
+#if defined(__AVX512F__)
+#define SIMD_LEVEL 16
+#elif defined(__AVX2__)
+#define SIMD_LEVEL 8
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SIMD_LEVEL 4
+#else
+#define SIMD_LEVEL 1
+#endif
+const uint32_t SIMD_WIDTH = SIMD_LEVEL;
+
+template <uint32_t W>
+struct SimdFloat;
+
+// scalar fallback, also the reference the wider versions have to match
+template <>
+struct SimdFloat<1>
+{
+    static const uint32_t width = 1;
+    float v;
+    // a mask lane is all ones or all zeros, like the vector compares
+    struct Mask
+    {
+        bool m;
+        Mask operator&(Mask o) const { return {m && o.m}; }
+        Mask operator|(Mask o) const { return {m || o.m}; }
+        uint32_t bits() const { return m ? 1u : 0u; }
+    };
+
+    SimdFloat() = default;
+    SimdFloat(float f) : v(f) {}
+
+    static SimdFloat load(const float *p) { return SimdFloat(*p); }
+    void store(float *p) const { *p = v; }
+
+    SimdFloat operator+(SimdFloat o) const { return v + o.v; }
+    SimdFloat operator-(SimdFloat o) const { return v - o.v; }
+    SimdFloat operator*(SimdFloat o) const { return v * o.v; }
+    SimdFloat operator/(SimdFloat o) const { return v / o.v; }
+    SimdFloat operator-() const { return -v; }
+    Mask operator<(SimdFloat o) const { return {v < o.v}; }
+    Mask operator>(SimdFloat o) const { return {v > o.v}; }
+    Mask operator<=(SimdFloat o) const { return {v <= o.v}; }
+    Mask operator>=(SimdFloat o) const { return {v >= o.v}; }
+
+    friend SimdFloat min(SimdFloat a, SimdFloat b) { return std::min(a.v, b.v); }
+    friend SimdFloat max(SimdFloat a, SimdFloat b) { return std::max(a.v, b.v); }
+    friend SimdFloat abs(SimdFloat a) { return std::fabs(a.v); }
+    friend SimdFloat sqrt(SimdFloat a) { return std::sqrt(a.v); }
+    friend SimdFloat select(Mask m, SimdFloat a, SimdFloat b) { return m.m ? a.v : b.v; }
+    friend SimdFloat fmadd(SimdFloat a, SimdFloat b, SimdFloat c) { return a.v * b.v + c.v; }
+};
+
+#if SIMD_LEVEL >= 4
+template <>
+struct SimdFloat<4>
+{
+    static const uint32_t width = 4;
+    __m128 v;
+    struct Mask
+    {
+        __m128 m;
+        Mask operator&(Mask o) const { return {_mm_and_ps(m, o.m)}; }
+        Mask operator|(Mask o) const { return {_mm_or_ps(m, o.m)}; }
+        uint32_t bits() const { return static_cast<uint32_t>(_mm_movemask_ps(m)); }
+    };
+
+    SimdFloat() = default;
+    SimdFloat(float f) : v(_mm_set1_ps(f)) {}
+    SimdFloat(__m128 m) : v(m) {}
+
+    static SimdFloat load(const float *p) { return _mm_loadu_ps(p); }
+    void store(float *p) const { _mm_storeu_ps(p, v); }
+
+    SimdFloat operator+(SimdFloat o) const { return _mm_add_ps(v, o.v); }
+    SimdFloat operator-(SimdFloat o) const { return _mm_sub_ps(v, o.v); }
+    SimdFloat operator*(SimdFloat o) const { return _mm_mul_ps(v, o.v); }
+    SimdFloat operator/(SimdFloat o) const { return _mm_div_ps(v, o.v); }
+    SimdFloat operator-() const { return _mm_xor_ps(v, _mm_set1_ps(-0.0f)); }
+    Mask operator<(SimdFloat o) const { return {_mm_cmplt_ps(v, o.v)}; }
+    Mask operator>(SimdFloat o) const { return {_mm_cmpgt_ps(v, o.v)}; }
+    Mask operator<=(SimdFloat o) const { return {_mm_cmple_ps(v, o.v)}; }
+    Mask operator>=(SimdFloat o) const { return {_mm_cmpge_ps(v, o.v)}; }
+
+    friend SimdFloat min(SimdFloat a, SimdFloat b) { return _mm_min_ps(a.v, b.v); }
+    friend SimdFloat max(SimdFloat a, SimdFloat b) { return _mm_max_ps(a.v, b.v); }
+    friend SimdFloat abs(SimdFloat a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a.v); }
+    friend SimdFloat sqrt(SimdFloat a) { return _mm_sqrt_ps(a.v); }
+    friend SimdFloat select(Mask m, SimdFloat a, SimdFloat b) { return _mm_or_ps(_mm_and_ps(m.m, a.v), _mm_andnot_ps(m.m, b.v)); }
+    friend SimdFloat fmadd(SimdFloat a, SimdFloat b, SimdFloat c) { return _mm_add_ps(_mm_mul_ps(a.v, b.v), c.v); }
+};
+#endif
+
+#if SIMD_LEVEL >= 8
+template <>
+struct SimdFloat<8>
+{
+    static const uint32_t width = 8;
+    __m256 v;
+    struct Mask
+    {
+        __m256 m;
+        Mask operator&(Mask o) const { return {_mm256_and_ps(m, o.m)}; }
+        Mask operator|(Mask o) const { return {_mm256_or_ps(m, o.m)}; }
+        uint32_t bits() const { return static_cast<uint32_t>(_mm256_movemask_ps(m)); }
+    };
+
+    SimdFloat() = default;
+    SimdFloat(float f) : v(_mm256_set1_ps(f)) {}
+    SimdFloat(__m256 m) : v(m) {}
+
+    static SimdFloat load(const float *p) { return _mm256_loadu_ps(p); }
+    void store(float *p) const { _mm256_storeu_ps(p, v); }
+
+    SimdFloat operator+(SimdFloat o) const { return _mm256_add_ps(v, o.v); }
+    SimdFloat operator-(SimdFloat o) const { return _mm256_sub_ps(v, o.v); }
+    SimdFloat operator*(SimdFloat o) const { return _mm256_mul_ps(v, o.v); }
+    SimdFloat operator/(SimdFloat o) const { return _mm256_div_ps(v, o.v); }
+    SimdFloat operator-() const { return _mm256_xor_ps(v, _mm256_set1_ps(-0.0f)); }
+    Mask operator<(SimdFloat o) const { return {_mm256_cmp_ps(v, o.v, _CMP_LT_OQ)}; }
+    Mask operator>(SimdFloat o) const { return {_mm256_cmp_ps(v, o.v, _CMP_GT_OQ)}; }
+    Mask operator<=(SimdFloat o) const { return {_mm256_cmp_ps(v, o.v, _CMP_LE_OQ)}; }
+    Mask operator>=(SimdFloat o) const { return {_mm256_cmp_ps(v, o.v, _CMP_GE_OQ)}; }
+
+    friend SimdFloat min(SimdFloat a, SimdFloat b) { return _mm256_min_ps(a.v, b.v); }
+    friend SimdFloat max(SimdFloat a, SimdFloat b) { return _mm256_max_ps(a.v, b.v); }
+    friend SimdFloat abs(SimdFloat a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a.v); }
+    friend SimdFloat sqrt(SimdFloat a) { return _mm256_sqrt_ps(a.v); }
+    friend SimdFloat select(Mask m, SimdFloat a, SimdFloat b) { return _mm256_blendv_ps(b.v, a.v, m.m); }
+#if defined(__FMA__) || defined(_MSC_VER)
+    friend SimdFloat fmadd(SimdFloat a, SimdFloat b, SimdFloat c) { return _mm256_fmadd_ps(a.v, b.v, c.v); }
+#else
+    friend SimdFloat fmadd(SimdFloat a, SimdFloat b, SimdFloat c) { return _mm256_add_ps(_mm256_mul_ps(a.v, b.v), c.v); }
+#endif
+};
+#endif
+
+#if SIMD_LEVEL >= 16
+// only AVX-512F is assumed, so the sign tricks go through the integer unit instead of the DQ float logic
+template <>
+struct SimdFloat<16>
+{
+    static const uint32_t width = 16;
+    __m512 v;
+    struct Mask
+    {
+        __mmask16 m;
+        Mask operator&(Mask o) const { return {static_cast<__mmask16>(m & o.m)}; }
+        Mask operator|(Mask o) const { return {static_cast<__mmask16>(m | o.m)}; }
+        uint32_t bits() const { return static_cast<uint32_t>(m); }
+    };
+
+    SimdFloat() = default;
+    SimdFloat(float f) : v(_mm512_set1_ps(f)) {}
+    SimdFloat(__m512 m) : v(m) {}
+
+    static SimdFloat load(const float *p) { return _mm512_loadu_ps(p); }
+    void store(float *p) const { _mm512_storeu_ps(p, v); }
+
+    SimdFloat operator+(SimdFloat o) const { return _mm512_add_ps(v, o.v); }
+    SimdFloat operator-(SimdFloat o) const { return _mm512_sub_ps(v, o.v); }
+    SimdFloat operator*(SimdFloat o) const { return _mm512_mul_ps(v, o.v); }
+    SimdFloat operator/(SimdFloat o) const { return _mm512_div_ps(v, o.v); }
+    SimdFloat operator-() const { return _mm512_castsi512_ps(_mm512_xor_si512(_mm512_castps_si512(v), _mm512_set1_epi32(static_cast<int>(0x80000000u)))); }
+    Mask operator<(SimdFloat o) const { return {_mm512_cmp_ps_mask(v, o.v, _CMP_LT_OQ)}; }
+    Mask operator>(SimdFloat o) const { return {_mm512_cmp_ps_mask(v, o.v, _CMP_GT_OQ)}; }
+    Mask operator<=(SimdFloat o) const { return {_mm512_cmp_ps_mask(v, o.v, _CMP_LE_OQ)}; }
+    Mask operator>=(SimdFloat o) const { return {_mm512_cmp_ps_mask(v, o.v, _CMP_GE_OQ)}; }
+
+    friend SimdFloat min(SimdFloat a, SimdFloat b) { return _mm512_min_ps(a.v, b.v); }
+    friend SimdFloat max(SimdFloat a, SimdFloat b) { return _mm512_max_ps(a.v, b.v); }
+    friend SimdFloat abs(SimdFloat a) { return _mm512_abs_ps(a.v); }
+    friend SimdFloat sqrt(SimdFloat a) { return _mm512_sqrt_ps(a.v); }
+    friend SimdFloat select(Mask m, SimdFloat a, SimdFloat b) { return _mm512_mask_blend_ps(m.m, b.v, a.v); }
+    friend SimdFloat fmadd(SimdFloat a, SimdFloat b, SimdFloat c) { return _mm512_fmadd_ps(a.v, b.v, c.v); }
+};
+#endif
+
+// acos on [0, 1], Abramowitz & Stegun 4.4.46, error below 2e-8
+template <uint32_t W>
+SimdFloat<W> acosPositive(SimdFloat<W> x)
+{
+    SimdFloat<W> p(-0.0012624911f);
+    p = fmadd(p, x, SimdFloat<W>(0.0066700901f));
+    p = fmadd(p, x, SimdFloat<W>(-0.0170881256f));
+    p = fmadd(p, x, SimdFloat<W>(0.0308918810f));
+    p = fmadd(p, x, SimdFloat<W>(-0.0501743046f));
+    p = fmadd(p, x, SimdFloat<W>(0.0889789874f));
+    p = fmadd(p, x, SimdFloat<W>(-0.2145988016f));
+    p = fmadd(p, x, SimdFloat<W>(1.5707963050f));
+    return p * sqrt(max(SimdFloat<W>(1.0f) - x, SimdFloat<W>(0.0f)));
+}
+
+// sin on [0, pi / 2], odd Taylor polynomial up to x^11
+template <uint32_t W>
+SimdFloat<W> sinQuarter(SimdFloat<W> x)
+{
+    SimdFloat<W> x2 = x * x;
+    SimdFloat<W> p(-2.5052108e-8f);
+    p = fmadd(p, x2, SimdFloat<W>(2.7557319e-6f));
+    p = fmadd(p, x2, SimdFloat<W>(-1.9841270e-4f));
+    p = fmadd(p, x2, SimdFloat<W>(8.3333333e-3f));
+    p = fmadd(p, x2, SimdFloat<W>(-1.6666667e-1f));
+    p = fmadd(p, x2, SimdFloat<W>(1.0f));
+    return p * x;
+}
@@ -25,39 +25,51 @@ void DestroyDebugUtilsMessengerEXT(VkInstance instance, VkDebugUtilsMessengerEXT
 
 void VulkanHelper::initVulkan(GLFWwindow *window)
 {
+    if (occlusionCulling && softwareOcclusion)
+    {
+        std::cout << "software occlusion replaces the depth readback" << std::endl;
+        occlusionCulling = false;
+    }
+
     createInstance();
     setupDebugMessenger();
     createSurface(window);
     pickPhysicalDevice();
     createLogicalDevice();
+    // the entry point stays the same for the device's lifetime
+    if (vertexInputDynamicState)
+        pfnVkCmdSetVertexInputEXT = (PFN_vkCmdSetVertexInputEXT)vkGetDeviceProcAddr(device, "vkCmdSetVertexInputEXT");
     createSwapChain(window);
     createImageViews();
     createRenderPass();
     createDepthResources();
     createFramebuffers();
     createDescriptorSetLayout();
-    createGraphicsPipeline();
     createSkyboxGraphicsPipeline();
-    createPbrGraphicsPipeline();
-    createLambertianGraphicsPipeline();
-    createMirrorGraphicsPipeline();
     createCommandPool();
     createCommandBuffers();
     createSyncObjects();
 }
 
-void VulkanHelper::initScene(std::vector<std::string> &vertexData, size_t uboSize, std::vector<uint32_t> &in_counts, std::vector<uint32_t> &in_strides, std::vector<uint32_t> &in_posOffsets, std::vector<uint32_t> &in_normalOffsets, std::vector<uint32_t> &in_colorOffsets, std::vector<std::string> &in_posFormats, std::vector<std::string> &in_normalFormats, std::vector<std::string> &in_colorFormats, std::vector<uint32_t> &in_instanceCounts, std::string &cubemap)
+void VulkanHelper::initScene(std::vector<std::string> &vertexData, std::vector<AABB> &in_aabbs, size_t uboSize, std::vector<uint32_t> &in_counts, std::vector<uint32_t> &in_strides, std::vector<uint32_t> &in_posOffsets, std::vector<uint32_t> &in_normalOffsets, std::vector<uint32_t> &in_colorOffsets, std::vector<std::string> &in_posFormats, std::vector<std::string> &in_normalFormats, std::vector<std::string> &in_colorFormats, std::vector<uint32_t> &in_instanceCounts, std::string &cubemap)
 {
     simpleScene = true;
 
-    // create vbos and AABBs
-    for (size_t i = 0; i < vertexData.size(); ++i)
+    // the indirect draws cover whole meshes
+    if (gpuCulling && meshletCulling)
     {
-        const std::vector<char> vertices = readFile(vertexData[i]);
-        createVertexBuffer(vertices.data(), vertices.size());
-        aabbs.push_back(createAABB(vertices, in_strides[i], in_posOffsets[i], in_normalOffsets[i]));
+        std::cout << "meshlet culling runs on the cpu path, it is ignored with gpu culling" << std::endl;
+        meshletCulling = false;
+    }
+    // the gpu path compacts its own list for the same pipeline
+    if (gpuCulling)
+    {
+        std::cout << "gpu culling shades with indirect.frag's hemisphere light rather than the scene's fragment shader, the image differs from the cpu path" << std::endl;
+        instancedDrawing = false;
     }
 
+    createVertexBuffers(vertexData, in_aabbs, in_counts, in_strides, in_posOffsets, in_normalOffsets);
+
     // create skybox
     if (!cubemap.empty())
     {
@@ -86,17 +98,46 @@ void VulkanHelper::initScene(std::vector<std::string> &vertexData, size_t uboSiz
     normalFormats.assign(in_normalFormats.begin(), in_normalFormats.end());
     colorFormats.assign(in_colorFormats.begin(), in_colorFormats.end());
     instanceCounts.assign(in_instanceCounts.begin(), in_instanceCounts.end());
+    createVertexLayouts();
+    createScenePipelines();
+    createInstanceAabbs();
+    if (gpuCulling)
+        createGpuCullingResources();
+    if (instancedDrawing)
+        createInstancingResources();
+    if (gpuCulling && (occlusionCulling || softwareOcclusion))
+    {
+        std::cout << "occlusion culling runs on the cpu path, it is ignored with gpu culling" << std::endl;
+        occlusionCulling = false;
+        softwareOcclusion = false;
+    }
+    // the gpu path records a handful of commands, there is nothing to split
+    if (gpuCulling && parallelRecording)
+    {
+        std::cout << "parallel recording runs on the cpu path, it is ignored with gpu culling" << std::endl;
+        parallelRecording = false;
+    }
+    if (occlusionCulling)
+        createDepthReadbackBuffers();
+    createRenderQueue();
+    if (parallelRecording)
+        createRecordingPools();
+    if (commandBufferCache)
+        createCommandBufferCache();
 }
 
-void VulkanHelper::initScene(std::vector<std::string> &vertexData, size_t uboSize, std::vector<uint32_t> &in_counts, std::vector<uint32_t> &in_strides, std::vector<uint32_t> &in_posOffsets, std::vector<uint32_t> &in_normalOffsets, std::vector<uint32_t> &in_tangentOffsets, std::vector<uint32_t> &in_texcoordOffsets, std::vector<uint32_t> &in_colorOffsets, std::vector<std::string> &in_posFormats, std::vector<std::string> &in_normalFormats, std::vector<std::string> &in_tangentFormats, std::vector<std::string> &in_texcoordFormats, std::vector<std::string> &in_colorFormats, std::vector<uint32_t> &in_instanceCounts, std::vector<uint32_t> &materialId, const std::vector<uint32_t> &in_vboMaterialId, const std::vector<uint32_t> &in_vboPipelineId, const std::unordered_map<uint32_t, std::vector<std::string>> &materialTexturePair, std::string &cubemap)
+void VulkanHelper::initScene(std::vector<std::string> &vertexData, std::vector<AABB> &in_aabbs, size_t uboSize, std::vector<uint32_t> &in_counts, std::vector<uint32_t> &in_strides, std::vector<uint32_t> &in_posOffsets, std::vector<uint32_t> &in_normalOffsets, std::vector<uint32_t> &in_tangentOffsets, std::vector<uint32_t> &in_texcoordOffsets, std::vector<uint32_t> &in_colorOffsets, std::vector<std::string> &in_posFormats, std::vector<std::string> &in_normalFormats, std::vector<std::string> &in_tangentFormats, std::vector<std::string> &in_texcoordFormats, std::vector<std::string> &in_colorFormats, std::vector<uint32_t> &in_instanceCounts, std::vector<uint32_t> &materialId, const std::vector<uint32_t> &in_vboMaterialId, const std::vector<uint32_t> &in_vboPipelineId, const std::unordered_map<uint32_t, std::vector<std::string>> &materialTexturePair, std::string &cubemap)
 {
-    // create vbos and AABBs
-    for (size_t i = 0; i < vertexData.size(); ++i)
+    // the indirect pipeline only has the plain vertex color shading
+    if (gpuCulling)
     {
-        const std::vector<char> vertices = readFile(vertexData[i]);
-        createVertexBuffer(vertices.data(), vertices.size());
-        aabbs.push_back(createAABB(vertices, in_strides[i], in_posOffsets[i], in_normalOffsets[i]));
+        std::cout << "gpu culling only supports scenes without materials, falling back to cpu culling" << std::endl;
+        gpuCulling = false;
     }
+    // the material shaders read their instance from a dynamic ubo offset, so these scenes keep a draw per instance
+    instancedDrawing = false;
+
+    createVertexBuffers(vertexData, in_aabbs, in_counts, in_strides, in_posOffsets, in_normalOffsets);
 
     // create skybox
     if (!cubemap.empty())
@@ -143,251 +184,1047 @@ void VulkanHelper::initScene(std::vector<std::string> &vertexData, size_t uboSiz
     texcoordFormats.assign(in_texcoordFormats.begin(), in_texcoordFormats.end());
     colorFormats.assign(in_colorFormats.begin(), in_colorFormats.end());
     instanceCounts.assign(in_instanceCounts.begin(), in_instanceCounts.end());
+    createVertexLayouts();
+    createScenePipelines();
+    createInstanceAabbs();
+    if (occlusionCulling)
+        createDepthReadbackBuffers();
+    createRenderQueue();
+    if (parallelRecording)
+        createRecordingPools();
+    if (commandBufferCache)
+        createCommandBufferCache();
 }
 
-void VulkanHelper::drawFrame(GLFWwindow *window, const std::vector<glm::mat4> &uniformData, glm::mat4 view, glm::mat4 proj, bool debug)
+void VulkanHelper::createInstanceAabbs()
 {
-    vkWaitForFences(device, 1, &inFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
-
-    uint32_t imageIndex;
-    VkResult result = vkAcquireNextImageKHR(device, swapChain, UINT64_MAX, imageAvailableSemaphores[currentFrame], VK_NULL_HANDLE, &imageIndex);
-
-    if (result == VK_ERROR_OUT_OF_DATE_KHR)
+    instanceAabbs.clear();
+    for (size_t i = 0; i < instanceCounts.size(); ++i)
     {
-        recreateSwapChain(window);
-        return;
+        instanceAabbs.insert(instanceAabbs.end(), instanceCounts[i], aabbs[i]);
     }
-    else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR)
-        throw std::runtime_error("failed to acquire swap chain image!");
-
-    updateUniformBuffer(currentFrame, uniformData, view, debug);
-
-    // only reset the fence if we are submitting work
-    vkResetFences(device, 1, &inFlightFences[currentFrame]);
-
-    vkResetCommandBuffer(commandBuffers[currentFrame], /*VkCommandBufferResetFlagBits*/ 0);
-    recordCommandBuffer(commandBuffers[currentFrame], imageIndex, view, proj);
+    occluderFlags.assign(instanceAabbs.size(), 0);
 
-    VkSubmitInfo submitInfo{
-        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-        .commandBufferCount = 1,
-        .pCommandBuffers = &commandBuffers[currentFrame]};
-
-    VkSemaphore waitSemaphores[] = {imageAvailableSemaphores[currentFrame]};
-    VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
-    submitInfo.waitSemaphoreCount = 1;
-    submitInfo.pWaitSemaphores = waitSemaphores;
-    submitInfo.pWaitDstStageMask = waitStages;
-
-    VkSemaphore signalSemaphores[] = {renderFinishedSemaphores[currentFrame]};
-    submitInfo.signalSemaphoreCount = 1;
-    submitInfo.pSignalSemaphores = signalSemaphores;
-
-    if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, inFlightFences[currentFrame]) != VK_SUCCESS)
-        throw std::runtime_error("failed to submit draw command buffer!");
-
-    VkPresentInfoKHR presentInfo{
-        .sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
-        .waitSemaphoreCount = 1,
-        .pWaitSemaphores = signalSemaphores,
-        .pImageIndices = &imageIndex};
-
-    VkSwapchainKHR swapChains[] = {swapChain};
-    presentInfo.swapchainCount = 1;
-    presentInfo.pSwapchains = swapChains;
-
-    result = vkQueuePresentKHR(presentQueue, &presentInfo);
-
-    if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || framebufferResized)
+    // instances are laid out mesh by mesh, the same order as the ubo
+    meshOccluders.clear();
+    uint32_t firstInstance = 0;
+    for (size_t i = 0; i < instanceCounts.size(); ++i)
     {
-        framebufferResized = false;
-        recreateSwapChain(window);
+        if (std::find(occluderMeshes.begin(), occluderMeshes.end(), static_cast<uint32_t>(i)) != occluderMeshes.end())
+        {
+            for (uint32_t j = 0; j < instanceCounts[i]; ++j)
+                meshOccluders.push_back(firstInstance + j);
+        }
+        firstInstance += instanceCounts[i];
     }
-    else if (result != VK_SUCCESS)
-        throw std::runtime_error("failed to present swap chain image!");
-
-    currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
 }
 
-void VulkanHelper::cleanup()
+void VulkanHelper::createGpuCullingResources()
 {
-    cleanupSwapChain();
-
-    vkDestroyPipeline(device, graphicsPipeline, nullptr);
-    vkDestroyPipeline(device, skyboxGraphicsPipeline, nullptr);
-    vkDestroyPipeline(device, pbrGraphicsPipeline, nullptr);
-    vkDestroyPipeline(device, lambertianGraphicsPipeline, nullptr);
-    vkDestroyPipeline(device, mirrorGraphicsPipeline, nullptr);
-    vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
-    vkDestroyPipelineLayout(device, skyboxPipelineLayout, nullptr);
-    vkDestroyPipelineLayout(device, pbrPipelineLayout, nullptr);
-    vkDestroyPipelineLayout(device, lambertianPipelineLayout, nullptr);
-    vkDestroyPipelineLayout(device, mirrorPipelineLayout, nullptr);
-    vkDestroyRenderPass(device, renderPass, nullptr);
-
-    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
-    {
-        vkDestroyBuffer(device, uniformBuffers[i], nullptr);
-        vkFreeMemory(device, uniformBuffersMemory[i], nullptr);
-    }
-
-    vkDestroyDescriptorPool(device, descriptorPool, nullptr);
-    vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
-
-    vkDestroySampler(device, textureSampler, nullptr);
-    for (auto imageView : textureImageViews)
-    {
-        vkDestroyImageView(device, imageView, nullptr);
-    }
-    for (auto image : textureImages)
+    // local boxes tagged with their mesh, in ubo order; every mesh compacts its visible instances into its own slice
+    std::vector<GpuInstanceBounds> bounds;
+    bounds.reserve(instanceAabbs.size());
+    std::vector<VkDrawIndirectCommand> commands(counts.size());
+    uint32_t firstInstance = 0;
+    for (size_t i = 0; i < counts.size(); ++i)
     {
-        vkDestroyImage(device, image, nullptr);
-    }
-    for (auto imageMemory : textureImageMemorys)
+        commands[i] = {
+            .vertexCount = counts[i],
+            .instanceCount = 0,
+            .firstVertex = 0,
+            .firstInstance = firstInstance};
+        for (uint32_t j = 0; j < instanceCounts[i]; ++j)
+        {
+            bounds.push_back({.min = aabbs[i].min, .mesh = static_cast<uint32_t>(i), .max = aabbs[i].max, .pad = 0});
+        }
+        firstInstance += instanceCounts[i];
+    }
+
+    // vulkan does not allow empty buffers
+    VkDeviceSize boundsSize = sizeof(GpuInstanceBounds) * std::max<size_t>(bounds.size(), 1);
+    VkDeviceSize commandsSize = sizeof(VkDrawIndirectCommand) * std::max<size_t>(commands.size(), 1);
+    VkDeviceSize drawCountsSize = sizeof(uint32_t) * std::max<size_t>(commands.size(), 1);
+    VkDeviceSize visibleSize = sizeof(uint32_t) * std::max<size_t>(bounds.size(), 1);
+    bounds.resize(boundsSize / sizeof(GpuInstanceBounds));
+    commands.resize(commandsSize / sizeof(VkDrawIndirectCommand));
+
+    createDeviceLocalBuffer(bounds.data(), boundsSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, instanceBoundsBuffer, instanceBoundsBufferMemory);
+    createDeviceLocalBuffer(commands.data(), commandsSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, drawCommandTemplateBuffer, drawCommandTemplateBufferMemory);
+
+    drawCommandBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+    drawCommandBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
+    drawCountBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+    drawCountBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
+    visibleInstanceBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+    visibleInstanceBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
+    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
     {
-        vkFreeMemory(device, imageMemory, nullptr);
+        createBuffer(commandsSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, drawCommandBuffers[i], drawCommandBuffersMemory[i]);
+        createBuffer(drawCountsSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, drawCountBuffers[i], drawCountBuffersMemory[i]);
+        createBuffer(visibleSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, visibleInstanceBuffers[i], visibleInstanceBuffersMemory[i]);
     }
 
-    for (auto vb : vertexBuffers)
-    {
-        vkDestroyBuffer(device, vb, nullptr);
-    }
-    for (auto vbm : vertexBufferMemorys)
-    {
-        vkFreeMemory(device, vbm, nullptr);
-    }
+    createGpuCullingDescriptorSets();
+    createCullPipeline();
+    createIndirectGraphicsPipeline(gpuCullingSetLayout);
+}
 
-    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+void VulkanHelper::createGpuCullingDescriptorSets()
+{
+    // 0 ubo as ssbo, 1 local boxes, 2 draw commands, 3 draw counts, 4 visible instance ids
+    std::array<VkDescriptorSetLayoutBinding, 5> bindings{};
+    for (size_t i = 0; i < bindings.size(); ++i)
     {
-        vkDestroySemaphore(device, renderFinishedSemaphores[i], nullptr);
-        vkDestroySemaphore(device, imageAvailableSemaphores[i], nullptr);
-        vkDestroyFence(device, inFlightFences[i], nullptr);
+        bindings[i] = {
+            .binding = static_cast<uint32_t>(i),
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .descriptorCount = 1,
+            .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+            .pImmutableSamplers = nullptr};
     }
+    // the indirect vertex shader looks its instance up through the visible list
+    bindings[0].stageFlags |= VK_SHADER_STAGE_VERTEX_BIT;
+    bindings[4].stageFlags |= VK_SHADER_STAGE_VERTEX_BIT;
 
-    vkDestroyCommandPool(device, commandPool, nullptr);
+    VkDescriptorSetLayoutCreateInfo layoutInfo{
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .bindingCount = static_cast<uint32_t>(bindings.size()),
+        .pBindings = bindings.data()};
 
-    vkDestroyDevice(device, nullptr);
+    if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &gpuCullingSetLayout) != VK_SUCCESS)
+        throw std::runtime_error("failed to create gpu culling descriptor set layout!");
 
-    if (enableValidationLayers)
-    {
-        DestroyDebugUtilsMessengerEXT(instance, debugMessenger, nullptr);
-    }
+    VkDescriptorPoolSize poolSize{
+        .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        .descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT * bindings.size())};
 
-    vkDestroySurfaceKHR(instance, surface, nullptr);
-    vkDestroyInstance(instance, nullptr);
-}
+    VkDescriptorPoolCreateInfo poolInfo{
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .maxSets = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT),
+        .poolSizeCount = 1,
+        .pPoolSizes = &poolSize};
 
-VkDevice VulkanHelper::getDevice()
-{
-    return device;
-}
+    if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &gpuCullingDescriptorPool) != VK_SUCCESS)
+        throw std::runtime_error("failed to create gpu culling descriptor pool!");
 
-void VulkanHelper::setCullingFrustum(float right, float top, float near, float far)
-{
-    frustum.near_right = right;
-    frustum.near_top = top;
-    frustum.near_plane = near;
-    frustum.far_plane = far;
-}
+    std::vector<VkDescriptorSetLayout> layouts(MAX_FRAMES_IN_FLIGHT, gpuCullingSetLayout);
+    VkDescriptorSetAllocateInfo allocInfo{
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .descriptorPool = gpuCullingDescriptorPool,
+        .descriptorSetCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT),
+        .pSetLayouts = layouts.data()};
 
-void VulkanHelper::cleanupSwapChain()
-{
-    vkDestroyImageView(device, depthImageView, nullptr);
-    vkDestroyImage(device, depthImage, nullptr);
-    vkFreeMemory(device, depthImageMemory, nullptr);
+    gpuCullingDescriptorSets.resize(MAX_FRAMES_IN_FLIGHT);
+    if (vkAllocateDescriptorSets(device, &allocInfo, gpuCullingDescriptorSets.data()) != VK_SUCCESS)
+        throw std::runtime_error("failed to allocate gpu culling descriptor sets!");
 
-    for (auto framebuffer : swapChainFramebuffers)
+    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
     {
-        vkDestroyFramebuffer(device, framebuffer, nullptr);
-    }
+        std::array<VkDescriptorBufferInfo, 5> bufferInfos{{
+            {.buffer = uniformBuffers[i], .offset = 0, .range = VK_WHOLE_SIZE},
+            {.buffer = instanceBoundsBuffer, .offset = 0, .range = VK_WHOLE_SIZE},
+            {.buffer = drawCommandBuffers[i], .offset = 0, .range = VK_WHOLE_SIZE},
+            {.buffer = drawCountBuffers[i], .offset = 0, .range = VK_WHOLE_SIZE},
+            {.buffer = visibleInstanceBuffers[i], .offset = 0, .range = VK_WHOLE_SIZE}}};
 
-    for (auto imageView : swapChainImageViews)
-    {
-        vkDestroyImageView(device, imageView, nullptr);
-    }
+        std::array<VkWriteDescriptorSet, 5> descriptorWrites{};
+        for (size_t j = 0; j < descriptorWrites.size(); ++j)
+        {
+            descriptorWrites[j] = {
+                .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                .dstSet = gpuCullingDescriptorSets[i],
+                .dstBinding = static_cast<uint32_t>(j),
+                .dstArrayElement = 0,
+                .descriptorCount = 1,
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .pBufferInfo = &bufferInfos[j]};
+        }
 
-    vkDestroySwapchainKHR(device, swapChain, nullptr);
+        vkUpdateDescriptorSets(device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+    }
 }
 
-void VulkanHelper::createInstance()
+void VulkanHelper::createCullPipeline()
 {
-    if (enableValidationLayers && !checkValidationLayerSupport())
-        throw std::runtime_error("validation layers requested, but not available!");
+    auto compShaderCode = readFile("shaders/spv/cull.spv");
+    VkShaderModule compShaderModule = createShaderModule(compShaderCode);
 
-    VkApplicationInfo appinfo{
-        .sType = VK_STRUCTURE_TYPE_APPLICATION_INFO,
-        .pApplicationName = "Vulkan Renderer",
-        .applicationVersion = VK_MAKE_API_VERSION(0, 1, 0, 0),
-        .pEngineName = "No Engine",
-        .engineVersion = VK_MAKE_API_VERSION(0, 1, 0, 0),
-        .apiVersion = VK_API_VERSION_1_3};
+    VkPipelineShaderStageCreateInfo compShaderStageInfo{
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+        .stage = VK_SHADER_STAGE_COMPUTE_BIT,
+        .module = compShaderModule,
+        .pName = "main"};
 
-    auto extensions = getRequiredExtensions();
+    VkPushConstantRange pushConstantRange{
+        .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+        .offset = 0,
+        .size = sizeof(CullPushConstants)};
 
-    VkInstanceCreateInfo createinfo{
-        .sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO,
-        .pApplicationInfo = &appinfo,
-        .enabledExtensionCount = static_cast<uint32_t>(extensions.size()),
-        .ppEnabledExtensionNames = extensions.data()};
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        .setLayoutCount = 1,
+        .pSetLayouts = &gpuCullingSetLayout,
+        .pushConstantRangeCount = 1,
+        .pPushConstantRanges = &pushConstantRange};
 
-    VkDebugUtilsMessengerCreateInfoEXT debugcreateinfo{};
-    if (enableValidationLayers)
-    {
-        createinfo.enabledLayerCount = static_cast<uint32_t>(validationLayers.size());
-        createinfo.ppEnabledLayerNames = validationLayers.data();
+    if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &cullPipelineLayout) != VK_SUCCESS)
+        throw std::runtime_error("failed to create cull pipeline layout!");
 
-        populateDebugMessengerCreateInfo(debugcreateinfo);
-        createinfo.pNext = (VkDebugUtilsMessengerCreateInfoEXT *)&debugcreateinfo;
-    }
-    else
-    {
-        createinfo.enabledLayerCount = 0;
-        createinfo.pNext = nullptr;
-    }
+    VkComputePipelineCreateInfo pipelineInfo{
+        .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+        .stage = compShaderStageInfo,
+        .layout = cullPipelineLayout,
+        .basePipelineHandle = VK_NULL_HANDLE};
 
-    if (vkCreateInstance(&createinfo, nullptr, &instance) != VK_SUCCESS)
-        throw std::runtime_error("failed to create instance!");
-}
+    if (vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &cullPipeline) != VK_SUCCESS)
+        throw std::runtime_error("failed to create cull pipeline!");
 
-void VulkanHelper::populateDebugMessengerCreateInfo(VkDebugUtilsMessengerCreateInfoEXT &createInfo)
-{
-    createInfo.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_MESSENGER_CREATE_INFO_EXT;
-    // createInfo.messageSeverity = VK_DEBUG_UTILS_MESSAGE_SEVERITY_VERBOSE_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT;
-    createInfo.messageSeverity = VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT;
-    createInfo.messageType = VK_DEBUG_UTILS_MESSAGE_TYPE_GENERAL_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT;
-    createInfo.pfnUserCallback = debugCallback;
+    vkDestroyShaderModule(device, compShaderModule, nullptr);
 }
 
-void VulkanHelper::setupDebugMessenger()
+void VulkanHelper::createIndirectGraphicsPipeline(VkDescriptorSetLayout setLayout)
 {
-    if (!enableValidationLayers)
-        return;
-
-    VkDebugUtilsMessengerCreateInfoEXT createInfo{};
-    populateDebugMessengerCreateInfo(createInfo);
+    auto vertShaderCode = readFile("shaders/spv/indirect_vert.spv");
+    auto fragShaderCode = readFile("shaders/spv/indirect_frag.spv");
 
-    if (CreateDebugUtilsMessengerEXT(instance, &createInfo, nullptr, &debugMessenger) != VK_SUCCESS)
-        throw std::runtime_error("failed to set up debug messenger!");
-}
+    VkShaderModule vertShaderModule = createShaderModule(vertShaderCode);
+    VkShaderModule fragShaderModule = createShaderModule(fragShaderCode);
 
-std::vector<const char *> VulkanHelper::getRequiredExtensions()
-{
-    uint32_t glfwExtensionCount = 0;
-    const char **glfwExtensions;
+    VkPipelineShaderStageCreateInfo vertShaderStageInfo{
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+        .stage = VK_SHADER_STAGE_VERTEX_BIT,
+        .module = vertShaderModule,
+        .pName = "main"};
 
-    glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
-    std::vector<const char *> extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
-    extensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME); // for vertex dynamic state
+    VkPipelineShaderStageCreateInfo fragShaderStageInfo{
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+        .stage = VK_SHADER_STAGE_FRAGMENT_BIT,
+        .module = fragShaderModule,
+        .pName = "main"};
 
-    if (enableValidationLayers)
-    {
-        extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
-    }
+    VkPipelineShaderStageCreateInfo shaderStages[] = {vertShaderStageInfo, fragShaderStageInfo};
 
-    return extensions;
-}
+    // Input assembly
+    VkPipelineInputAssemblyStateCreateInfo inputAssembly{
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
+        .topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
+        .primitiveRestartEnable = VK_FALSE};
 
-bool VulkanHelper::checkValidationLayerSupport()
+    // Viewports and scissors
+    VkPipelineViewportStateCreateInfo viewportState{
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
+        .viewportCount = 1,
+        .scissorCount = 1};
+
+    // Rasterizer
+    VkPipelineRasterizationStateCreateInfo rasterizer{
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
+        .depthClampEnable = VK_FALSE,
+        .rasterizerDiscardEnable = VK_FALSE,
+        .polygonMode = VK_POLYGON_MODE_FILL,
+        .cullMode = VK_CULL_MODE_BACK_BIT,
+        .frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE,
+        .depthBiasEnable = VK_FALSE,
+        .lineWidth = 1.0f};
+
+    // Multisampling
+    VkPipelineMultisampleStateCreateInfo multisampling{
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
+        .rasterizationSamples = VK_SAMPLE_COUNT_1_BIT,
+        .sampleShadingEnable = VK_FALSE};
+
+    // Depth and stencil testing
+    VkPipelineDepthStencilStateCreateInfo depthStencil{
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO,
+        .depthTestEnable = VK_TRUE,
+        .depthWriteEnable = VK_TRUE,
+        .depthCompareOp = VK_COMPARE_OP_LESS,
+        .depthBoundsTestEnable = VK_FALSE,
+        .stencilTestEnable = VK_FALSE};
+
+    // Color blending
+    VkPipelineColorBlendAttachmentState colorBlendAttachment{
+        .blendEnable = VK_FALSE,
+        .colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT};
+
+    VkPipelineColorBlendStateCreateInfo colorBlending{
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
+        .logicOpEnable = VK_FALSE,
+        .attachmentCount = 1,
+        .pAttachments = &colorBlendAttachment};
+
+    // Dynamic state
+    std::vector<VkDynamicState> dynamicStates = {
+        VK_DYNAMIC_STATE_VIEWPORT,
+        VK_DYNAMIC_STATE_SCISSOR,
+        VK_DYNAMIC_STATE_VERTEX_INPUT_EXT};
+
+    VkPipelineDynamicStateCreateInfo dynamicState{
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
+        .dynamicStateCount = static_cast<uint32_t>(dynamicStates.size()),
+        .pDynamicStates = dynamicStates.data()};
+
+    VkPushConstantRange pushConstantRange{
+        .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
+        .offset = 0,
+        .size = sizeof(PushConstants)};
+
+    // Pipeline layout
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        .setLayoutCount = 1,
+        .pSetLayouts = &setLayout,
+        .pushConstantRangeCount = 1,
+        .pPushConstantRanges = &pushConstantRange};
+
+    if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &indirectPipelineLayout) != VK_SUCCESS)
+        throw std::runtime_error("failed to create indirect pipeline layout!");
+
+    VkGraphicsPipelineCreateInfo pipelineInfo{
+        .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+        .stageCount = 2,
+        .pStages = shaderStages,
+        .pVertexInputState = nullptr, // for vertex dynamic state
+        .pInputAssemblyState = &inputAssembly,
+        .pViewportState = &viewportState,
+        .pRasterizationState = &rasterizer,
+        .pMultisampleState = &multisampling,
+        .pDepthStencilState = &depthStencil,
+        .pColorBlendState = &colorBlending,
+        .pDynamicState = &dynamicState,
+        .layout = indirectPipelineLayout,
+        .renderPass = renderPass,
+        .subpass = 0,
+        .basePipelineHandle = VK_NULL_HANDLE};
+
+    createPipelineVariants(pipelineInfo, 3, indirectGraphicsPipelines);
+
+    vkDestroyShaderModule(device, fragShaderModule, nullptr);
+    vkDestroyShaderModule(device, vertShaderModule, nullptr);
+}
+
+void VulkanHelper::destroyGpuCullingResources()
+{
+    vkDestroyPipeline(device, cullPipeline, nullptr);
+    destroyPipelineVariants(indirectGraphicsPipelines);
+    vkDestroyPipelineLayout(device, cullPipelineLayout, nullptr);
+    vkDestroyPipelineLayout(device, indirectPipelineLayout, nullptr);
+    vkDestroyDescriptorPool(device, gpuCullingDescriptorPool, nullptr);
+    vkDestroyDescriptorSetLayout(device, gpuCullingSetLayout, nullptr);
+
+    vkDestroyBuffer(device, instanceBoundsBuffer, nullptr);
+    vkFreeMemory(device, instanceBoundsBufferMemory, nullptr);
+    vkDestroyBuffer(device, drawCommandTemplateBuffer, nullptr);
+    vkFreeMemory(device, drawCommandTemplateBufferMemory, nullptr);
+    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+    {
+        vkDestroyBuffer(device, drawCommandBuffers[i], nullptr);
+        vkFreeMemory(device, drawCommandBuffersMemory[i], nullptr);
+        vkDestroyBuffer(device, drawCountBuffers[i], nullptr);
+        vkFreeMemory(device, drawCountBuffersMemory[i], nullptr);
+        vkDestroyBuffer(device, visibleInstanceBuffers[i], nullptr);
+        vkFreeMemory(device, visibleInstanceBuffersMemory[i], nullptr);
+    }
+}
+
+void VulkanHelper::createInstancingResources()
+{
+    // the cpu writes the visible list every frame, so it stays mapped
+    VkDeviceSize listSize = sizeof(uint32_t) * std::max<size_t>(instanceAabbs.size(), 1);
+    visibleListBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+    visibleListBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
+    visibleListBuffersMapped.resize(MAX_FRAMES_IN_FLIGHT);
+    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+    {
+        createBuffer(listSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, visibleListBuffers[i], visibleListBuffersMemory[i]);
+        vkMapMemory(device, visibleListBuffersMemory[i], 0, listSize, 0, &visibleListBuffersMapped[i]);
+    }
+    drawList.reserve(instanceAabbs.size());
+
+    // same binding numbers as the gpu culling set, so indirect.vert serves both paths
+    std::array<VkDescriptorSetLayoutBinding, 2> bindings{};
+    bindings[0] = {
+        .binding = 0,
+        .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        .descriptorCount = 1,
+        .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
+        .pImmutableSamplers = nullptr};
+    bindings[1] = bindings[0];
+    bindings[1].binding = 4;
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo{
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .bindingCount = static_cast<uint32_t>(bindings.size()),
+        .pBindings = bindings.data()};
+
+    if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &instancingSetLayout) != VK_SUCCESS)
+        throw std::runtime_error("failed to create instancing descriptor set layout!");
+
+    VkDescriptorPoolSize poolSize{
+        .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        .descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT * bindings.size())};
+
+    VkDescriptorPoolCreateInfo poolInfo{
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .maxSets = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT),
+        .poolSizeCount = 1,
+        .pPoolSizes = &poolSize};
+
+    if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &instancingDescriptorPool) != VK_SUCCESS)
+        throw std::runtime_error("failed to create instancing descriptor pool!");
+
+    std::vector<VkDescriptorSetLayout> layouts(MAX_FRAMES_IN_FLIGHT, instancingSetLayout);
+    VkDescriptorSetAllocateInfo allocInfo{
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .descriptorPool = instancingDescriptorPool,
+        .descriptorSetCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT),
+        .pSetLayouts = layouts.data()};
+
+    instancingDescriptorSets.resize(MAX_FRAMES_IN_FLIGHT);
+    if (vkAllocateDescriptorSets(device, &allocInfo, instancingDescriptorSets.data()) != VK_SUCCESS)
+        throw std::runtime_error("failed to allocate instancing descriptor sets!");
+
+    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+    {
+        std::array<VkDescriptorBufferInfo, 2> bufferInfos{{
+            {.buffer = uniformBuffers[i], .offset = 0, .range = VK_WHOLE_SIZE},
+            {.buffer = visibleListBuffers[i], .offset = 0, .range = VK_WHOLE_SIZE}}};
+
+        std::array<VkWriteDescriptorSet, 2> descriptorWrites{};
+        for (size_t j = 0; j < descriptorWrites.size(); ++j)
+        {
+            descriptorWrites[j] = {
+                .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                .dstSet = instancingDescriptorSets[i],
+                .dstBinding = bindings[j].binding,
+                .dstArrayElement = 0,
+                .descriptorCount = 1,
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .pBufferInfo = &bufferInfos[j]};
+        }
+
+        vkUpdateDescriptorSets(device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+    }
+
+    createIndirectGraphicsPipeline(instancingSetLayout);
+}
+
+void VulkanHelper::destroyInstancingResources()
+{
+    destroyPipelineVariants(indirectGraphicsPipelines);
+    vkDestroyPipelineLayout(device, indirectPipelineLayout, nullptr);
+    vkDestroyDescriptorPool(device, instancingDescriptorPool, nullptr);
+    vkDestroyDescriptorSetLayout(device, instancingSetLayout, nullptr);
+
+    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+    {
+        vkDestroyBuffer(device, visibleListBuffers[i], nullptr);
+        vkFreeMemory(device, visibleListBuffersMemory[i], nullptr);
+    }
+}
+
+void VulkanHelper::recordGpuCulling(VkCommandBuffer commandBuffer)
+{
+    // every mesh starts the frame with zero instances and no draw, the compute pass counts them back up
+    VkBufferCopy copyRegion{.size = sizeof(VkDrawIndirectCommand) * counts.size()};
+    if (copyRegion.size > 0)
+        vkCmdCopyBuffer(commandBuffer, drawCommandTemplateBuffer, drawCommandBuffers[currentFrame], 1, &copyRegion);
+    vkCmdFillBuffer(commandBuffer, drawCountBuffers[currentFrame], 0, VK_WHOLE_SIZE, 0);
+
+    VkMemoryBarrier resetBarrier{
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT};
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &resetBarrier, 0, nullptr, 0, nullptr);
+
+    // same world space planes as the cpu path, taken from the culling view so the debug camera still shows the result
+    CullPushConstants pushConstants{.instanceCount = static_cast<uint32_t>(instanceAabbs.size())};
+    std::array<glm::vec4, 6> planes = getFrustumPlanes(frustum, cullingView);
+    std::copy(planes.begin(), planes.end(), pushConstants.planes);
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipelineLayout, 0, 1, &gpuCullingDescriptorSets[currentFrame], 0, nullptr);
+    vkCmdPushConstants(commandBuffer, cullPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(CullPushConstants), &pushConstants);
+    vkCmdDispatch(commandBuffer, (pushConstants.instanceCount + CULL_WORKGROUP_SIZE - 1) / CULL_WORKGROUP_SIZE, 1, 1);
+
+    VkMemoryBarrier cullBarrier{
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT};
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, 0, 1, &cullBarrier, 0, nullptr, 0, nullptr);
+
+    // the visible count stays on the gpu, reading it back would stall the frame
+    cullingStats = CullingStats{.instances = pushConstants.instanceCount};
+}
+
+void VulkanHelper::createDepthReadbackBuffers()
+{
+    // the depth aspect of every supported format copies out as 4 bytes per texel
+    depthReadbackFormat = findDepthFormat();
+    VkDeviceSize bufferSize = sizeof(float) * swapChainExtent.width * swapChainExtent.height;
+
+    depthReadbackBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+    depthReadbackBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
+    depthReadbackBuffersMapped.resize(MAX_FRAMES_IN_FLIGHT);
+    depthViewProjs.resize(MAX_FRAMES_IN_FLIGHT);
+    depthReadbackValid.assign(MAX_FRAMES_IN_FLIGHT, false);
+
+    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+    {
+        createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, depthReadbackBuffers[i], depthReadbackBuffersMemory[i]);
+        vkMapMemory(device, depthReadbackBuffersMemory[i], 0, bufferSize, 0, &depthReadbackBuffersMapped[i]);
+    }
+}
+
+void VulkanHelper::destroyDepthReadbackBuffers()
+{
+    for (size_t i = 0; i < depthReadbackBuffers.size(); i++)
+    {
+        vkDestroyBuffer(device, depthReadbackBuffers[i], nullptr);
+        vkFreeMemory(device, depthReadbackBuffersMemory[i], nullptr);
+    }
+    depthReadbackBuffers.clear();
+    depthReadbackBuffersMemory.clear();
+    depthReadbackBuffersMapped.clear();
+    hiZValid = false;
+}
+
+void VulkanHelper::recordDepthReadback(VkCommandBuffer commandBuffer, glm::mat4 viewProj)
+{
+    VkImageMemoryBarrier barrier{
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
+        .oldLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+        .newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = depthImage};
+
+    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+    if (hasStencilComponent(depthReadbackFormat))
+        barrier.subresourceRange.aspectMask |= VK_IMAGE_ASPECT_STENCIL_BIT;
+    barrier.subresourceRange.baseMipLevel = 0;
+    barrier.subresourceRange.levelCount = 1;
+    barrier.subresourceRange.baseArrayLayer = 0;
+    barrier.subresourceRange.layerCount = 1;
+
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+    VkBufferImageCopy region{
+        .bufferOffset = 0,
+        .bufferRowLength = 0,
+        .bufferImageHeight = 0,
+        .imageOffset = {0, 0, 0},
+        .imageExtent = {swapChainExtent.width, swapChainExtent.height, 1}};
+
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+    region.imageSubresource.mipLevel = 0;
+    region.imageSubresource.baseArrayLayer = 0;
+    region.imageSubresource.layerCount = 1;
+    vkCmdCopyImageToBuffer(commandBuffer, depthImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, depthReadbackBuffers[currentFrame], 1, &region);
+
+    // back to the attachment layout, this also keeps the next frame's depth clear behind the copy
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    barrier.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+    VkBufferMemoryBarrier hostBarrier{
+        .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_HOST_READ_BIT,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .buffer = depthReadbackBuffers[currentFrame],
+        .offset = 0,
+        .size = VK_WHOLE_SIZE};
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &hostBarrier, 0, nullptr);
+
+    depthViewProjs[currentFrame] = viewProj;
+    depthReadbackValid[currentFrame] = true;
+}
+
+void VulkanHelper::buildHiZ(glm::mat4 viewProj, bool debug)
+{
+    // the fence of this frame in flight has been waited on, so its readback holds the depth of the frame that last used the slot;
+    // a debug camera's depth says nothing about what the culling camera sees
+    hiZValid = false;
+    if (debug || !depthReadbackValid[currentFrame])
+        return;
+
+    const float *depth = static_cast<const float *>(depthReadbackBuffersMapped[currentFrame]);
+    if (depthReadbackFormat == VK_FORMAT_D24_UNORM_S8_UINT)
+    {
+        // 24-bit unorm depth in the low bits of every texel
+        const uint32_t *packed = static_cast<const uint32_t *>(depthReadbackBuffersMapped[currentFrame]);
+        depthScratch.resize(static_cast<size_t>(swapChainExtent.width) * swapChainExtent.height);
+        for (size_t i = 0; i < depthScratch.size(); ++i)
+        {
+            depthScratch[i] = static_cast<float>(packed[i] & 0xffffff) / 16777215.0f;
+        }
+        depth = depthScratch.data();
+    }
+
+    hiZ.build(depth, swapChainExtent.width, swapChainExtent.height, depthViewProjs[currentFrame], viewProj);
+    hiZValid = true;
+}
+
+bool VulkanHelper::isInstanceVisible(uint32_t instance)
+{
+    if (!((visibility[instance / 32] >> (instance % 32)) & 1))
+        return false;
+    if (hiZValid && !occluderFlags[instance] && hiZ.isOccluded(worldAabbs[instance]))
+    {
+        cullingStats.occlusionRejected++;
+        return false;
+    }
+    return true;
+}
+
+void VulkanHelper::compactDrawList()
+{
+    // runs before any recording, so the occlusion counters and the list itself are only written by this thread
+    drawList.clear();
+    drawListOffsets.resize(vertexBuffers.size() + 1);
+    uint32_t instance = 0;
+    for (size_t i = 0; i < vertexBuffers.size(); ++i)
+    {
+        drawListOffsets[i] = static_cast<uint32_t>(drawList.size());
+        for (uint32_t j = 0; j < instanceCounts[i]; ++j, ++instance)
+        {
+            if (isInstanceVisible(instance))
+                drawList.push_back(instance);
+        }
+    }
+    drawListOffsets.back() = static_cast<uint32_t>(drawList.size());
+}
+
+void VulkanHelper::drawMeshlets(VkCommandBuffer commandBuffer, size_t mesh, uint32_t instance, uint32_t firstInstance, const std::array<glm::vec4, 6> &planes, glm::vec3 cameraPosition, CullingStats &stats)
+{
+    // the cone test runs in object space, a mirroring transform flips which side the rasterizer culls
+    const glm::mat4 &transform = cullingTransforms[instance];
+    glm::vec3 localCamera = glm::vec3(glm::inverse(transform) * glm::vec4(cameraPosition, 1.0f));
+    bool mirrored = glm::determinant(glm::mat3(transform)) < 0.0f;
+
+    // meshlets are consecutive in the vertex buffer, each run of visible ones is a single draw
+    uint32_t runFirst = 0;
+    uint32_t runCount = 0;
+    for (const auto &meshlet : meshlets[mesh])
+    {
+        uint32_t planeMask = 0x3f;
+        bool visible = false;
+        if (testPlanes(planes, transformAABB(transform, meshlet.bounds), planeMask) == PlaneTest::T_Outside)
+        {
+            stats.meshletFrustumRejected++;
+        }
+        else if (isBackfacing(meshlet, localCamera, mirrored))
+        {
+            stats.meshletBackfaceRejected++;
+        }
+        else
+        {
+            stats.meshletAccepted++;
+            visible = true;
+        }
+
+        if (visible && runCount > 0 && runFirst + runCount == meshlet.firstVertex)
+        {
+            runCount += meshlet.vertexCount;
+            continue;
+        }
+        if (runCount > 0)
+            vkCmdDraw(commandBuffer, runCount, 1, runFirst, firstInstance);
+        runFirst = meshlet.firstVertex;
+        runCount = visible ? meshlet.vertexCount : 0;
+    }
+    if (runCount > 0)
+        vkCmdDraw(commandBuffer, runCount, 1, runFirst, firstInstance);
+}
+
+void VulkanHelper::rasterizeOccluders(glm::mat4 viewProj)
+{
+    // boxes only hide things correctly for meshes that fill them, so occluders only come from the meshes named solid:
+    // every frustum-visible instance of them, or just the ones likely to cover the most screen when picked automatically
+    for (auto occluder : occluders)
+    {
+        occluderFlags[occluder] = 0;
+    }
+    visibleInstances.clear();
+    for (auto instance : meshOccluders)
+    {
+        if ((visibility[instance / 32] >> (instance % 32)) & 1)
+            visibleInstances.push_back(instance);
+    }
+    if (autoOccluders)
+        selectOccluders(worldAabbs, visibleInstances, glm::vec3(glm::inverse(cullingView)[3]), MAX_AUTO_OCCLUDERS, occluders);
+    else
+        occluders.swap(visibleInstances);
+    if (occluders.empty())
+    {
+        // nothing solid in view, a pyramid built from the depth readback this frame stays
+        hiZValid = hiZValid && occlusionCulling;
+        return;
+    }
+
+    uint32_t rasterHeight = std::max(1u, OCCLUSION_RASTER_WIDTH * swapChainExtent.height / swapChainExtent.width);
+    if (occlusionRasterizer.getHeight() != rasterHeight)
+        occlusionRasterizer.resize(OCCLUSION_RASTER_WIDTH, rasterHeight);
+    occlusionRasterizer.clear(viewProj);
+    for (auto occluder : occluders)
+    {
+        occlusionRasterizer.drawBox(cullingTransforms[occluder], instanceAabbs[occluder]);
+        occluderFlags[occluder] = 1;
+    }
+
+    hiZ.build(occlusionRasterizer.data(), occlusionRasterizer.getWidth(), occlusionRasterizer.getHeight(), viewProj);
+    hiZValid = true;
+}
+
+void VulkanHelper::drawFrame(GLFWwindow *window, const std::vector<glm::mat4> &uniformData, const std::vector<uint32_t> &dirtyInstances, glm::mat4 view, glm::mat4 proj, bool debug)
+{
+    vkWaitForFences(device, 1, &inFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
+
+    uint32_t imageIndex;
+    VkResult result = vkAcquireNextImageKHR(device, swapChain, UINT64_MAX, imageAvailableSemaphores[currentFrame], VK_NULL_HANDLE, &imageIndex);
+
+    if (result == VK_ERROR_OUT_OF_DATE_KHR)
+    {
+        recreateSwapChain(window);
+        return;
+    }
+    else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR)
+        throw std::runtime_error("failed to acquire swap chain image!");
+
+    updateUniformBuffer(currentFrame, uniformData, dirtyInstances, view, debug);
+    if (occlusionCulling)
+        buildHiZ(proj * view, debug);
+
+    // only reset the fence if we are submitting work
+    vkResetFences(device, 1, &inFlightFences[currentFrame]);
+
+    if (!gpuCulling)
+    {
+        cullScene(proj);
+        // the draws only read the list once the frame is submitted, a cached frame reads it from here as well
+        if (instancedDrawing)
+            std::memcpy(visibleListBuffersMapped[currentFrame], drawList.data(), drawList.size() * sizeof(uint32_t));
+    }
+
+    VkCommandBuffer commandBuffer = commandBuffers[currentFrame];
+    if (commandBufferCache)
+    {
+        // the same frame in flight and image with the same signature would record exactly the commands it already has
+        size_t slot = currentFrame * swapChainImages.size() + imageIndex;
+        commandBuffer = cachedCommandBuffers[slot];
+        CommandSignature &signature = cachedSignatures[slot];
+        if (!signature.matches(view, proj, cullingView, sceneVersion, drawList))
+        {
+            signature.valid = false;
+            vkResetCommandBuffer(commandBuffer, /*VkCommandBufferResetFlagBits*/ 0);
+            recordCommandBuffer(commandBuffer, imageIndex, view, proj);
+            signature = CommandSignature{view, proj, cullingView, sceneVersion, drawList, true};
+        }
+        else if (occlusionCulling)
+        {
+            // another image of this frame in flight may have recorded its readback from a different view since
+            depthViewProjs[currentFrame] = proj * view;
+            depthReadbackValid[currentFrame] = true;
+        }
+    }
+    else
+    {
+        vkResetCommandBuffer(commandBuffer, /*VkCommandBufferResetFlagBits*/ 0);
+        recordCommandBuffer(commandBuffer, imageIndex, view, proj);
+    }
+
+    VkSubmitInfo submitInfo{
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .commandBufferCount = 1,
+        .pCommandBuffers = &commandBuffer};
+
+    VkSemaphore waitSemaphores[] = {imageAvailableSemaphores[currentFrame]};
+    VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
+    submitInfo.waitSemaphoreCount = 1;
+    submitInfo.pWaitSemaphores = waitSemaphores;
+    submitInfo.pWaitDstStageMask = waitStages;
+
+    VkSemaphore signalSemaphores[] = {renderFinishedSemaphores[currentFrame]};
+    submitInfo.signalSemaphoreCount = 1;
+    submitInfo.pSignalSemaphores = signalSemaphores;
+
+    if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, inFlightFences[currentFrame]) != VK_SUCCESS)
+        throw std::runtime_error("failed to submit draw command buffer!");
+
+    VkPresentInfoKHR presentInfo{
+        .sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
+        .waitSemaphoreCount = 1,
+        .pWaitSemaphores = signalSemaphores,
+        .pImageIndices = &imageIndex};
+
+    VkSwapchainKHR swapChains[] = {swapChain};
+    presentInfo.swapchainCount = 1;
+    presentInfo.pSwapchains = swapChains;
+
+    result = vkQueuePresentKHR(presentQueue, &presentInfo);
+
+    if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || framebufferResized)
+    {
+        framebufferResized = false;
+        recreateSwapChain(window);
+    }
+    else if (result != VK_SUCCESS)
+        throw std::runtime_error("failed to present swap chain image!");
+
+    currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+}
+
+void VulkanHelper::cleanup()
+{
+    cleanupSwapChain();
+
+    destroyPipelineVariants(graphicsPipelines);
+    vkDestroyPipeline(device, skyboxGraphicsPipeline, nullptr);
+    destroyPipelineVariants(pbrGraphicsPipelines);
+    destroyPipelineVariants(lambertianGraphicsPipelines);
+    destroyPipelineVariants(mirrorGraphicsPipelines);
+    vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+    vkDestroyPipelineLayout(device, skyboxPipelineLayout, nullptr);
+    vkDestroyPipelineLayout(device, pbrPipelineLayout, nullptr);
+    vkDestroyPipelineLayout(device, lambertianPipelineLayout, nullptr);
+    vkDestroyPipelineLayout(device, mirrorPipelineLayout, nullptr);
+    vkDestroyRenderPass(device, renderPass, nullptr);
+
+    if (gpuCulling)
+        destroyGpuCullingResources();
+    if (instancedDrawing)
+        destroyInstancingResources();
+    if (occlusionCulling)
+        destroyDepthReadbackBuffers();
+    if (commandBufferCache)
+        destroyCommandBufferCache();
+    if (parallelRecording)
+        destroyRecordingPools();
+
+    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+    {
+        vkDestroyBuffer(device, uniformBuffers[i], nullptr);
+        vkFreeMemory(device, uniformBuffersMemory[i], nullptr);
+    }
+
+    vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+    vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+
+    vkDestroySampler(device, textureSampler, nullptr);
+    for (auto imageView : textureImageViews)
+    {
+        vkDestroyImageView(device, imageView, nullptr);
+    }
+    for (auto image : textureImages)
+    {
+        vkDestroyImage(device, image, nullptr);
+    }
+    for (auto imageMemory : textureImageMemorys)
+    {
+        vkFreeMemory(device, imageMemory, nullptr);
+    }
+
+    for (auto vb : vertexBuffers)
+    {
+        vkDestroyBuffer(device, vb, nullptr);
+    }
+    for (auto vbm : vertexBufferMemorys)
+    {
+        vkFreeMemory(device, vbm, nullptr);
+    }
+
+    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+    {
+        vkDestroySemaphore(device, renderFinishedSemaphores[i], nullptr);
+        vkDestroySemaphore(device, imageAvailableSemaphores[i], nullptr);
+        vkDestroyFence(device, inFlightFences[i], nullptr);
+    }
+
+    vkDestroyCommandPool(device, commandPool, nullptr);
+
+    vkDestroyDevice(device, nullptr);
+
+    if (enableValidationLayers)
+    {
+        DestroyDebugUtilsMessengerEXT(instance, debugMessenger, nullptr);
+    }
+
+    vkDestroySurfaceKHR(instance, surface, nullptr);
+    vkDestroyInstance(instance, nullptr);
+}
+
+VkDevice VulkanHelper::getDevice()
+{
+    return device;
+}
+
+void VulkanHelper::setCullingFrustum(float right, float top, float near, float far)
+{
+    frustum.near_right = right;
+    frustum.near_top = top;
+    frustum.near_plane = near;
+    frustum.far_plane = far;
+}
+
+void VulkanHelper::setTemporalCulling(bool enabled)
+{
+    temporalCulling = enabled;
+}
+
+const CullingStats &VulkanHelper::getCullingStats() const
+{
+    return cullingStats;
+}
+
+void VulkanHelper::setGpuCulling(bool enabled)
+{
+    gpuCulling = enabled;
+}
+
+void VulkanHelper::setOcclusionCulling(bool enabled)
+{
+    occlusionCulling = enabled;
+}
+
+void VulkanHelper::setInstancedDrawing(bool enabled)
+{
+    instancedDrawing = enabled;
+}
+
+void VulkanHelper::setParallelRecording(bool enabled)
+{
+    parallelRecording = enabled;
+}
+
+void VulkanHelper::setCommandBufferCache(bool enabled)
+{
+    commandBufferCache = enabled;
+}
+
+void VulkanHelper::setMeshletCulling(bool enabled)
+{
+    meshletCulling = enabled;
+}
+
+void VulkanHelper::setSoftwareOcclusion(bool enabled)
+{
+    softwareOcclusion = enabled;
+}
+
+void VulkanHelper::setOccluderMeshes(const std::vector<uint32_t> &meshes)
+{
+    occluderMeshes = meshes;
+}
+
+void VulkanHelper::setAutoOccluders(bool enabled)
+{
+    autoOccluders = enabled;
+}
+
+void VulkanHelper::cleanupSwapChain()
+{
+    vkDestroyImageView(device, depthImageView, nullptr);
+    vkDestroyImage(device, depthImage, nullptr);
+    vkFreeMemory(device, depthImageMemory, nullptr);
+
+    for (auto framebuffer : swapChainFramebuffers)
+    {
+        vkDestroyFramebuffer(device, framebuffer, nullptr);
+    }
+
+    for (auto imageView : swapChainImageViews)
+    {
+        vkDestroyImageView(device, imageView, nullptr);
+    }
+
+    vkDestroySwapchainKHR(device, swapChain, nullptr);
+}
+
+void VulkanHelper::createInstance()
+{
+    if (enableValidationLayers && !checkValidationLayerSupport())
+        throw std::runtime_error("validation layers requested, but not available!");
+
+    VkApplicationInfo appinfo{
+        .sType = VK_STRUCTURE_TYPE_APPLICATION_INFO,
+        .pApplicationName = "Vulkan Renderer",
+        .applicationVersion = VK_MAKE_API_VERSION(0, 1, 0, 0),
+        .pEngineName = "No Engine",
+        .engineVersion = VK_MAKE_API_VERSION(0, 1, 0, 0),
+        .apiVersion = VK_API_VERSION_1_3};
+
+    auto extensions = getRequiredExtensions();
+
+    VkInstanceCreateInfo createinfo{
+        .sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO,
+        .pApplicationInfo = &appinfo,
+        .enabledExtensionCount = static_cast<uint32_t>(extensions.size()),
+        .ppEnabledExtensionNames = extensions.data()};
+
+    VkDebugUtilsMessengerCreateInfoEXT debugcreateinfo{};
+    if (enableValidationLayers)
+    {
+        createinfo.enabledLayerCount = static_cast<uint32_t>(validationLayers.size());
+        createinfo.ppEnabledLayerNames = validationLayers.data();
+
+        populateDebugMessengerCreateInfo(debugcreateinfo);
+        createinfo.pNext = (VkDebugUtilsMessengerCreateInfoEXT *)&debugcreateinfo;
+    }
+    else
+    {
+        createinfo.enabledLayerCount = 0;
+        createinfo.pNext = nullptr;
+    }
+
+    if (vkCreateInstance(&createinfo, nullptr, &instance) != VK_SUCCESS)
+        throw std::runtime_error("failed to create instance!");
+}
+
+void VulkanHelper::populateDebugMessengerCreateInfo(VkDebugUtilsMessengerCreateInfoEXT &createInfo)
+{
+    createInfo.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_MESSENGER_CREATE_INFO_EXT;
+    // createInfo.messageSeverity = VK_DEBUG_UTILS_MESSAGE_SEVERITY_VERBOSE_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT;
+    createInfo.messageSeverity = VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT;
+    createInfo.messageType = VK_DEBUG_UTILS_MESSAGE_TYPE_GENERAL_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT;
+    createInfo.pfnUserCallback = debugCallback;
+}
+
+void VulkanHelper::setupDebugMessenger()
+{
+    if (!enableValidationLayers)
+        return;
+
+    VkDebugUtilsMessengerCreateInfoEXT createInfo{};
+    populateDebugMessengerCreateInfo(createInfo);
+
+    if (CreateDebugUtilsMessengerEXT(instance, &createInfo, nullptr, &debugMessenger) != VK_SUCCESS)
+        throw std::runtime_error("failed to set up debug messenger!");
+}
+
+std::vector<const char *> VulkanHelper::getRequiredExtensions()
+{
+    uint32_t glfwExtensionCount = 0;
+    const char **glfwExtensions;
+
+    glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+    std::vector<const char *> extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
+    extensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME); // for vertex dynamic state
+
+    if (enableValidationLayers)
+    {
+        extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
+    }
+
+    return extensions;
+}
+
+bool VulkanHelper::checkValidationLayerSupport()
 {
     uint32_t LayerCount = 0;
     vkEnumerateInstanceLayerProperties(&LayerCount, nullptr);
@@ -470,19 +1307,58 @@ void VulkanHelper::createLogicalDevice()
         queueCreateInfos.push_back(queueCreateInfo);
     }
 
+    // indirect count draws are core since 1.2, they are only turned on for the gpu culling path
+    VkPhysicalDeviceVulkan12Features supportedVulkan12Features{
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES};
+    VkPhysicalDeviceFeatures2 supportedFeatures{
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+        .pNext = &supportedVulkan12Features};
+    vkGetPhysicalDeviceFeatures2(physicalDevice, &supportedFeatures);
+    if (gpuCulling && (!supportedVulkan12Features.drawIndirectCount || !supportedFeatures.features.drawIndirectFirstInstance))
+    {
+        std::cout << "device has no indirect count draws, falling back to cpu culling" << std::endl;
+        gpuCulling = false;
+    }
+
     VkPhysicalDeviceFeatures deviceFeatures{};
     deviceFeatures.samplerAnisotropy = VK_TRUE;
+    deviceFeatures.drawIndirectFirstInstance = gpuCulling ? VK_TRUE : VK_FALSE;
+    VkPhysicalDeviceVulkan12Features vulkan12Features{
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES,
+        .drawIndirectCount = gpuCulling ? VK_TRUE : VK_FALSE};
+    // dynamic vertex input is only the fallback for scenes with more layouts than baked pipelines, it is optional
+    uint32_t extensionCount = 0;
+    vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, nullptr);
+    std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+    vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, availableExtensions.data());
+    vertexInputDynamicState = std::any_of(availableExtensions.begin(), availableExtensions.end(), [](const VkExtensionProperties &extension)
+                                          { return std::strcmp(extension.extensionName, VK_EXT_VERTEX_INPUT_DYNAMIC_STATE_EXTENSION_NAME) == 0; });
+    if (vertexInputDynamicState)
+    {
+        VkPhysicalDeviceVertexInputDynamicStateFeaturesEXT supportedVertexInputFeatures{
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VERTEX_INPUT_DYNAMIC_STATE_FEATURES_EXT};
+        VkPhysicalDeviceFeatures2 extensionFeatures{
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+            .pNext = &supportedVertexInputFeatures};
+        vkGetPhysicalDeviceFeatures2(physicalDevice, &extensionFeatures);
+        vertexInputDynamicState = supportedVertexInputFeatures.vertexInputDynamicState;
+    }
+
+    std::vector<const char *> enabledExtensions = deviceExtensions;
     VkPhysicalDeviceVertexInputDynamicStateFeaturesEXT vertexInputDynamicStateFeatures{
         .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VERTEX_INPUT_DYNAMIC_STATE_FEATURES_EXT,
+        .pNext = &vulkan12Features,
         .vertexInputDynamicState = VK_TRUE};
+    if (vertexInputDynamicState)
+        enabledExtensions.push_back(VK_EXT_VERTEX_INPUT_DYNAMIC_STATE_EXTENSION_NAME);
 
     VkDeviceCreateInfo createInfo{
         .sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
-        .pNext = &vertexInputDynamicStateFeatures,
+        .pNext = vertexInputDynamicState ? static_cast<void *>(&vertexInputDynamicStateFeatures) : static_cast<void *>(&vulkan12Features),
         .queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size()),
         .pQueueCreateInfos = queueCreateInfos.data(),
-        .enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size()),
-        .ppEnabledExtensionNames = deviceExtensions.data(),
+        .enabledExtensionCount = static_cast<uint32_t>(enabledExtensions.size()),
+        .ppEnabledExtensionNames = enabledExtensions.data(),
         .pEnabledFeatures = &deviceFeatures};
 
     if (enableValidationLayers)
@@ -577,6 +1453,19 @@ void VulkanHelper::recreateSwapChain(GLFWwindow *window)
     createImageViews();
     createDepthResources();
     createFramebuffers();
+
+    // the readbacks follow the size of the depth buffer
+    if (occlusionCulling)
+    {
+        destroyDepthReadbackBuffers();
+        createDepthReadbackBuffers();
+    }
+    // cached frames point at the old framebuffers and the image count may have changed
+    if (commandBufferCache)
+    {
+        destroyCommandBufferCache();
+        createCommandBufferCache();
+    }
 }
 
 void VulkanHelper::createImageViews()
@@ -605,7 +1494,7 @@ void VulkanHelper::createRenderPass()
         .format = findDepthFormat(),
         .samples = VK_SAMPLE_COUNT_1_BIT,
         .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
-        .storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+        .storeOp = occlusionCulling ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE, // kept for the hi-z readback
         .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
         .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
         .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
@@ -651,7 +1540,10 @@ void VulkanHelper::createDepthResources()
 {
     VkFormat depthFormat = findDepthFormat();
 
-    createImage(swapChainExtent.width, swapChainExtent.height, depthFormat, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, depthImage, depthImageMemory);
+    VkImageUsageFlags usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+    if (occlusionCulling)
+        usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    createImage(swapChainExtent.width, swapChainExtent.height, depthFormat, VK_IMAGE_TILING_OPTIMAL, usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, depthImage, depthImageMemory);
     depthImageView = createImageView(depthImage, depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT);
 }
 
@@ -835,8 +1727,7 @@ void VulkanHelper::createGraphicsPipeline()
         .subpass = 0,
         .basePipelineHandle = VK_NULL_HANDLE};
 
-    if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &graphicsPipeline) != VK_SUCCESS)
-        throw std::runtime_error("failed to create graphics pipeline!");
+    createPipelineVariants(pipelineInfo, 3, graphicsPipelines);
 
     vkDestroyShaderModule(device, fragShaderModule, nullptr);
     vkDestroyShaderModule(device, vertShaderModule, nullptr);
@@ -1085,8 +1976,7 @@ void VulkanHelper::createPbrGraphicsPipeline()
         .subpass = 0,
         .basePipelineHandle = VK_NULL_HANDLE};
 
-    if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pbrGraphicsPipeline) != VK_SUCCESS)
-        throw std::runtime_error("failed to create pbr graphics pipeline!");
+    createPipelineVariants(pipelineInfo, 5, pbrGraphicsPipelines);
 
     vkDestroyShaderModule(device, fragShaderModule, nullptr);
     vkDestroyShaderModule(device, vertShaderModule, nullptr);
@@ -1209,8 +2099,7 @@ void VulkanHelper::createLambertianGraphicsPipeline()
         .subpass = 0,
         .basePipelineHandle = VK_NULL_HANDLE};
 
-    if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &lambertianGraphicsPipeline) != VK_SUCCESS)
-        throw std::runtime_error("failed to create lambertian graphics pipeline!");
+    createPipelineVariants(pipelineInfo, 5, lambertianGraphicsPipelines);
 
     vkDestroyShaderModule(device, fragShaderModule, nullptr);
     vkDestroyShaderModule(device, vertShaderModule, nullptr);
@@ -1333,27 +2222,90 @@ void VulkanHelper::createMirrorGraphicsPipeline()
         .subpass = 0,
         .basePipelineHandle = VK_NULL_HANDLE};
 
-    if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &mirrorGraphicsPipeline) != VK_SUCCESS)
-        throw std::runtime_error("failed to create mirror graphics pipeline!");
+    createPipelineVariants(pipelineInfo, 5, mirrorGraphicsPipelines);
 
     vkDestroyShaderModule(device, fragShaderModule, nullptr);
     vkDestroyShaderModule(device, vertShaderModule, nullptr);
 }
 
-void VulkanHelper::bindSuitableGraphicsPipeline(VkCommandBuffer commandBuffer, uint32_t pipelineId)
+const std::vector<VkPipeline> &VulkanHelper::getSuitableGraphicsPipelines(uint32_t pipelineId) const
 {
     if (pipelineId == 0)
+        return pbrGraphicsPipelines;
+    else if (pipelineId == 1)
+        return lambertianGraphicsPipelines;
+    else if (pipelineId == 2)
+        return mirrorGraphicsPipelines;
+    throw std::logic_error("undefined pipeline id!");
+}
+
+void VulkanHelper::createScenePipelines()
+{
+    // baked against the scene's vertex layouts, so they are only created once those are known
+    createGraphicsPipeline();
+    createPbrGraphicsPipeline();
+    createLambertianGraphicsPipeline();
+    createMirrorGraphicsPipeline();
+}
+
+void VulkanHelper::createPipelineVariants(const VkGraphicsPipelineCreateInfo &pipelineInfo, uint32_t attributeCount, std::vector<VkPipeline> &pipelines)
+{
+    // the static variants take the vertex input out of the dynamic states the caller set up
+    std::vector<VkDynamicState> staticStates;
+    for (uint32_t i = 0; i < pipelineInfo.pDynamicState->dynamicStateCount; ++i)
     {
-        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pbrGraphicsPipeline);
+        if (pipelineInfo.pDynamicState->pDynamicStates[i] != VK_DYNAMIC_STATE_VERTEX_INPUT_EXT)
+            staticStates.push_back(pipelineInfo.pDynamicState->pDynamicStates[i]);
     }
-    else if (pipelineId == 1)
+    VkPipelineDynamicStateCreateInfo staticDynamicState = *pipelineInfo.pDynamicState;
+    staticDynamicState.dynamicStateCount = static_cast<uint32_t>(staticStates.size());
+    staticDynamicState.pDynamicStates = staticStates.data();
+
+    // layouts with a different attribute count belong to the other kind of scene, their slots stay empty
+    pipelines.assign(dynamicPipelineVariant + 1, VK_NULL_HANDLE);
+    for (uint32_t layoutId = 0; layoutId < dynamicPipelineVariant; ++layoutId)
     {
-        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, lambertianGraphicsPipeline);
+        const VertexLayout &layout = vertexLayouts[layoutId];
+        if (layout.attributeCount != attributeCount)
+            continue;
+
+        VkVertexInputBindingDescription binding{
+            .binding = 0,
+            .stride = layout.stride,
+            .inputRate = VK_VERTEX_INPUT_RATE_VERTEX};
+        std::array<VkVertexInputAttributeDescription, 5> attributes{};
+        for (uint32_t a = 0; a < layout.attributeCount; ++a)
+        {
+            attributes[a] = {.location = a, .binding = 0, .format = layout.formats[a], .offset = layout.offsets[a]};
+        }
+        VkPipelineVertexInputStateCreateInfo vertexInputInfo{
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
+            .vertexBindingDescriptionCount = 1,
+            .pVertexBindingDescriptions = &binding,
+            .vertexAttributeDescriptionCount = layout.attributeCount,
+            .pVertexAttributeDescriptions = attributes.data()};
+
+        VkGraphicsPipelineCreateInfo variantInfo = pipelineInfo;
+        variantInfo.pVertexInputState = &vertexInputInfo;
+        variantInfo.pDynamicState = &staticDynamicState;
+        if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &variantInfo, nullptr, &pipelines[layoutId]) != VK_SUCCESS)
+            throw std::runtime_error("failed to create graphics pipeline!");
     }
-    else if (pipelineId == 2)
+
+    if (vertexLayouts.size() > dynamicPipelineVariant)
+    {
+        if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipelines[dynamicPipelineVariant]) != VK_SUCCESS)
+            throw std::runtime_error("failed to create graphics pipeline!");
+    }
+}
+
+void VulkanHelper::destroyPipelineVariants(std::vector<VkPipeline> &pipelines)
+{
+    for (auto pipeline : pipelines)
     {
-        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, mirrorGraphicsPipeline);
+        vkDestroyPipeline(device, pipeline, nullptr);
     }
+    pipelines.clear();
 }
 
 void VulkanHelper::createCommandPool()
@@ -1379,8 +2331,109 @@ void VulkanHelper::createCommandBuffers()
         .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
         .commandBufferCount = static_cast<uint32_t>(commandBuffers.size())};
 
-    if (vkAllocateCommandBuffers(device, &allocInfo, commandBuffers.data()) != VK_SUCCESS)
-        throw std::runtime_error("failed to allocate command buffers!");
+    if (vkAllocateCommandBuffers(device, &allocInfo, commandBuffers.data()) != VK_SUCCESS)
+        throw std::runtime_error("failed to allocate command buffers!");
+}
+
+void VulkanHelper::createRecordingPools()
+{
+    QueueFamilyIndices queueFamilyIndices = findQueueFamilies(physicalDevice);
+    uint32_t sliceCount = JobSystem::instance().getThreadCount();
+
+    recordingPools.resize(MAX_FRAMES_IN_FLIGHT);
+    secondaryCommandBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+    {
+        recordingPools[i].resize(sliceCount);
+        secondaryCommandBuffers[i].resize(sliceCount);
+        for (uint32_t slice = 0; slice < sliceCount; ++slice)
+        {
+            // buffers are reset one by one when recording begins, cached frames keep theirs from the same pool
+            VkCommandPoolCreateInfo poolInfo{
+                .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+                .flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+                .queueFamilyIndex = queueFamilyIndices.graphicsFamily.value()};
+
+            if (vkCreateCommandPool(device, &poolInfo, nullptr, &recordingPools[i][slice]) != VK_SUCCESS)
+                throw std::runtime_error("failed to create recording command pool!");
+
+            VkCommandBufferAllocateInfo allocInfo{
+                .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+                .commandPool = recordingPools[i][slice],
+                .level = VK_COMMAND_BUFFER_LEVEL_SECONDARY,
+                .commandBufferCount = 1};
+
+            if (vkAllocateCommandBuffers(device, &allocInfo, &secondaryCommandBuffers[i][slice]) != VK_SUCCESS)
+                throw std::runtime_error("failed to allocate secondary command buffers!");
+        }
+    }
+    sliceStats.resize(sliceCount);
+}
+
+void VulkanHelper::destroyRecordingPools()
+{
+    // destroying a pool frees the buffers allocated from it
+    for (auto &pools : recordingPools)
+    {
+        for (auto pool : pools)
+        {
+            vkDestroyCommandPool(device, pool, nullptr);
+        }
+    }
+}
+
+void VulkanHelper::createCommandBufferCache()
+{
+    size_t slotCount = MAX_FRAMES_IN_FLIGHT * swapChainImages.size();
+    cachedCommandBuffers.resize(slotCount);
+    cachedSignatures.assign(slotCount, CommandSignature{});
+
+    VkCommandBufferAllocateInfo allocInfo{
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+        .commandPool = commandPool,
+        .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+        .commandBufferCount = static_cast<uint32_t>(slotCount)};
+
+    if (vkAllocateCommandBuffers(device, &allocInfo, cachedCommandBuffers.data()) != VK_SUCCESS)
+        throw std::runtime_error("failed to allocate cached command buffers!");
+
+    if (!parallelRecording)
+        return;
+
+    // a cached primary keeps executing its secondaries, so every slot needs a set of its own
+    cachedSecondaryBuffers.resize(slotCount);
+    for (size_t slot = 0; slot < slotCount; ++slot)
+    {
+        const std::vector<VkCommandPool> &pools = recordingPools[slot / swapChainImages.size()];
+        cachedSecondaryBuffers[slot].resize(pools.size());
+        for (size_t slice = 0; slice < pools.size(); ++slice)
+        {
+            VkCommandBufferAllocateInfo secondaryInfo{
+                .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+                .commandPool = pools[slice],
+                .level = VK_COMMAND_BUFFER_LEVEL_SECONDARY,
+                .commandBufferCount = 1};
+
+            if (vkAllocateCommandBuffers(device, &secondaryInfo, &cachedSecondaryBuffers[slot][slice]) != VK_SUCCESS)
+                throw std::runtime_error("failed to allocate cached secondary command buffers!");
+        }
+    }
+}
+
+void VulkanHelper::destroyCommandBufferCache()
+{
+    vkFreeCommandBuffers(device, commandPool, static_cast<uint32_t>(cachedCommandBuffers.size()), cachedCommandBuffers.data());
+    for (size_t slot = 0; slot < cachedSecondaryBuffers.size(); ++slot)
+    {
+        const std::vector<VkCommandPool> &pools = recordingPools[slot / (cachedSecondaryBuffers.size() / MAX_FRAMES_IN_FLIGHT)];
+        for (size_t slice = 0; slice < pools.size(); ++slice)
+        {
+            vkFreeCommandBuffers(device, pools[slice], 1, &cachedSecondaryBuffers[slot][slice]);
+        }
+    }
+    cachedCommandBuffers.clear();
+    cachedSecondaryBuffers.clear();
+    cachedSignatures.clear();
 }
 
 void VulkanHelper::createSyncObjects()
@@ -1405,6 +2458,206 @@ void VulkanHelper::createSyncObjects()
     }
 }
 
+void VulkanHelper::recordFrameState(VkCommandBuffer commandBuffer, const PushConstants &pushConstants, bool drawSkybox)
+{
+    VkViewport viewport{};
+    viewport.x = 0.0f;
+    viewport.y = 0.0f;
+    viewport.width = static_cast<float>(swapChainExtent.width);
+    viewport.height = static_cast<float>(swapChainExtent.height);
+    viewport.minDepth = 0.0f;
+    viewport.maxDepth = 1.0f;
+    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+    VkRect2D scissor{};
+    scissor.offset = {0, 0};
+    scissor.extent = swapChainExtent;
+    vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+    vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(PushConstants), &pushConstants);
+
+    if (drawSkybox && hasSkybox)
+    {
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, skyboxGraphicsPipeline);
+
+        uint32_t offsets[] = {0};
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, skyboxPipelineLayout, 0, 1, &descriptorSets[currentFrame], 1, offsets);
+
+        // draw a quad to represent sky
+        vkCmdDraw(commandBuffer, 6, 1, 0, 0);
+    }
+}
+
+void VulkanHelper::recordMeshes(VkCommandBuffer commandBuffer, size_t firstEntry, size_t lastEntry, const PushConstants &pushConstants, const std::array<glm::vec4, 6> &planes, glm::vec3 cameraPosition, CullingStats &stats)
+{
+    // every command buffer starts out with nothing bound
+    MeshBindState bound;
+
+    VkDeviceSize offsets[] = {0};
+    if (instancedDrawing)
+    {
+        // the visible instances are already compacted mesh by mesh, each mesh is one instanced draw
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, indirectPipelineLayout, 0, 1, &instancingDescriptorSets[currentFrame], 0, nullptr);
+        vkCmdPushConstants(commandBuffer, indirectPipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(PushConstants), &pushConstants);
+
+        for (size_t entry = firstEntry; entry < lastEntry; ++entry)
+        {
+            uint32_t i = renderQueue[entry];
+            uint32_t firstSlot = drawListOffsets[i];
+            uint32_t visibleCount = drawListOffsets[i + 1] - firstSlot;
+            if (visibleCount == 0)
+                continue;
+
+            bindMeshState(commandBuffer, indirectGraphicsPipelines, i, bound, stats);
+            vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffers[i], offsets);
+
+            // meshlets differ per instance, those instances keep a draw of their own
+            if (meshlets[i].size() > 1)
+            {
+                for (uint32_t slot = firstSlot; slot < firstSlot + visibleCount; ++slot)
+                {
+                    drawMeshlets(commandBuffer, i, drawList[slot], slot, planes, cameraPosition, stats);
+                }
+            }
+            else
+            {
+                vkCmdDraw(commandBuffer, counts[i], visibleCount, 0, firstSlot);
+            }
+        }
+        return;
+    }
+
+    for (size_t entry = firstEntry; entry < lastEntry; ++entry)
+    {
+        uint32_t i = renderQueue[entry];
+        if (drawListOffsets[i] == drawListOffsets[i + 1])
+            continue;
+
+        // the descriptor set is bound per instance anyway, its dynamic offset picks the instance
+        bindMeshState(commandBuffer, simpleScene ? graphicsPipelines : getSuitableGraphicsPipelines(vboPipelineId[i]), i, bound, stats);
+        vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffers[i], offsets);
+
+        for (uint32_t slot = drawListOffsets[i]; slot < drawListOffsets[i + 1]; ++slot)
+        {
+            uint32_t instance = drawList[slot];
+            uint32_t uboOffsets[] = {instance * static_cast<uint32_t>(sizeof(UniformBufferObject))};
+            if (simpleScene)
+            {
+                vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets[currentFrame], 1, uboOffsets);
+            }
+            else
+            {
+                bindSuitableDescriptorSet(commandBuffer, vboPipelineId[i], vboMaterialId[i], uboOffsets);
+            }
+            if (meshlets[i].size() > 1)
+                drawMeshlets(commandBuffer, i, instance, 0, planes, cameraPosition, stats);
+            else
+                vkCmdDraw(commandBuffer, counts[i], 1, 0, 0);
+        }
+    }
+}
+
+void VulkanHelper::recordSecondaryCommandBuffers(const std::vector<VkCommandBuffer> &secondaries, uint32_t imageIndex, const PushConstants &pushConstants, const std::array<glm::vec4, 6> &planes, glm::vec3 cameraPosition)
+{
+    // contiguous render queue ranges of about the same cost, a mesh costs its visible instances plus its binds
+    size_t sliceCount = secondaries.size();
+    size_t entryCount = renderQueue.size();
+    size_t totalCost = drawList.size() + entryCount;
+    sliceFirstEntries.assign(sliceCount + 1, entryCount);
+    sliceFirstEntries[0] = 0;
+    size_t slice = 1;
+    size_t cost = 0;
+    for (size_t entry = 0; entry < entryCount && slice < sliceCount; ++entry)
+    {
+        uint32_t i = renderQueue[entry];
+        cost += drawListOffsets[i + 1] - drawListOffsets[i] + 1;
+        if (cost * sliceCount >= totalCost * slice)
+            sliceFirstEntries[slice++] = entry + 1;
+    }
+
+    VkCommandBufferInheritanceInfo inheritanceInfo{
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO,
+        .renderPass = renderPass,
+        .subpass = 0,
+        .framebuffer = swapChainFramebuffers[imageIndex]};
+
+    // a cached primary is submitted again with the secondaries it executes, so those must stay valid after a submit
+    VkCommandBufferUsageFlags usage = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+    if (!commandBufferCache)
+        usage |= VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+    // one slice per job, so the pool a secondary comes from is only ever used by the thread recording that slice
+    JobSystem::instance().parallelFor(sliceCount, 1, [&](size_t first, size_t last)
+                                      {
+        for (size_t s = first; s < last; ++s)
+        {
+            VkCommandBuffer secondary = secondaries[s];
+            VkCommandBufferBeginInfo beginInfo{
+                .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+                .flags = usage,
+                .pInheritanceInfo = &inheritanceInfo};
+
+            if (vkBeginCommandBuffer(secondary, &beginInfo) != VK_SUCCESS)
+                throw std::runtime_error("failed to begin recording secondary command buffer!");
+
+            // the sky goes first like on the inline path, the primary executes the slices in order
+            sliceStats[s] = CullingStats{};
+            recordFrameState(secondary, pushConstants, s == 0);
+            recordMeshes(secondary, sliceFirstEntries[s], sliceFirstEntries[s + 1], pushConstants, planes, cameraPosition, sliceStats[s]);
+
+            if (vkEndCommandBuffer(secondary) != VK_SUCCESS)
+                throw std::runtime_error("failed to record secondary command buffer!");
+        } });
+
+    for (const auto &stats : sliceStats)
+    {
+        cullingStats.meshletFrustumRejected += stats.meshletFrustumRejected;
+        cullingStats.meshletBackfaceRejected += stats.meshletBackfaceRejected;
+        cullingStats.meshletAccepted += stats.meshletAccepted;
+        cullingStats.pipelineBindsElided += stats.pipelineBindsElided;
+        cullingStats.vertexInputsElided += stats.vertexInputsElided;
+    }
+}
+
+void VulkanHelper::cullScene(glm::mat4 proj)
+{
+    // the same view over the same scene culls to the same list, except hi-z which follows every readback
+    if (commandBufferCache && !occlusionCulling && cullSignature.matches(glm::mat4(1.0f), proj, cullingView, sceneVersion, {}))
+        return;
+
+    // tiered culling, whole subtrees first, then instance spheres and boxes, only what still crosses a plane gets the exact test;
+    // the temporal mode skips the subtrees and reuses last frame's results the camera has not moved enough to change
+    std::array<glm::vec4, 6> planes = getFrustumPlanes(frustum, cullingView);
+    if (temporalCulling)
+        temporalCuller.cull(planes, glm::vec3(glm::inverse(cullingView)[3]), worldAabbs, worldSpheres, visibility, cullCandidates, cullingStats);
+    else
+        bvh.cull(planes, worldAabbs, worldSpheres, visibility, cullCandidates, cullingStats);
+    candidateTransforms.resize(cullCandidates.size());
+    candidateAabbs.resize(cullCandidates.size());
+    for (size_t i = 0; i < cullCandidates.size(); ++i)
+    {
+        candidateTransforms[i] = cullingView * cullingTransforms[cullCandidates[i]];
+        candidateAabbs[i] = instanceAabbs[cullCandidates[i]];
+    }
+    candidateVisibility.resize((cullCandidates.size() + 31) / 32);
+    cullInstances(frustum, candidateTransforms.data(), candidateAabbs.data(), cullCandidates.size(), candidateVisibility.data());
+    for (size_t i = 0; i < cullCandidates.size(); ++i)
+    {
+        if ((candidateVisibility[i / 32] >> (i % 32)) & 1)
+        {
+            visibility[cullCandidates[i] / 32] |= 1u << (cullCandidates[i] % 32);
+            cullingStats.satAccepted++;
+        }
+    }
+    cullingStats.satRejected = static_cast<uint32_t>(cullCandidates.size()) - cullingStats.satAccepted;
+
+    if (softwareOcclusion)
+        rasterizeOccluders(proj * cullingView);
+
+    compactDrawList();
+    cullSignature = CommandSignature{glm::mat4(1.0f), proj, cullingView, sceneVersion, {}, true};
+}
+
 void VulkanHelper::recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex, glm::mat4 view, glm::mat4 proj)
 {
     VkCommandBufferBeginInfo beginInfo{
@@ -1418,6 +2671,9 @@ void VulkanHelper::recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t i
         throw std::runtime_error("failed to begin recording command buffer!");
     }
 
+    if (gpuCulling)
+        recordGpuCulling(commandBuffer);
+
     std::array<VkClearValue, 2> clearValues{};
     clearValues[0].color = {{0.0f, 0.0f, 0.0f, 1.0f}};
     clearValues[1].depthStencil = {1.0f, 0};
@@ -1432,170 +2688,403 @@ void VulkanHelper::recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t i
     renderPassInfo.renderArea.offset = {0, 0};
     renderPassInfo.renderArea.extent = swapChainExtent;
 
-    vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+    PushConstants pushConstants{.view = view, .proj = proj};
 
-    VkViewport viewport{};
-    viewport.x = 0.0f;
-    viewport.y = 0.0f;
-    viewport.width = static_cast<float>(swapChainExtent.width);
-    viewport.height = static_cast<float>(swapChainExtent.height);
-    viewport.minDepth = 0.0f;
-    viewport.maxDepth = 1.0f;
-    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+    if (gpuCulling)
+    {
+        vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+        recordFrameState(commandBuffer, pushConstants, true);
 
-    VkRect2D scissor{};
-    scissor.offset = {0, 0};
-    scissor.extent = swapChainExtent;
-    vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+        // the compute pass already compacted the visible instances, every mesh is a single indirect call
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, indirectPipelineLayout, 0, 1, &gpuCullingDescriptorSets[currentFrame], 0, nullptr);
+        vkCmdPushConstants(commandBuffer, indirectPipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(PushConstants), &pushConstants);
 
-    PushConstants pushConstants{.view = view, .proj = proj};
-    vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(PushConstants), &pushConstants);
+        VkDeviceSize offsets[] = {0};
+        MeshBindState bound;
+        for (uint32_t i : renderQueue)
+        {
+            bindMeshState(commandBuffer, indirectGraphicsPipelines, i, bound, cullingStats);
+            vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffers[i], offsets);
+            vkCmdDrawIndirectCount(commandBuffer, drawCommandBuffers[currentFrame], i * sizeof(VkDrawIndirectCommand), drawCountBuffers[currentFrame], i * sizeof(uint32_t), 1, sizeof(VkDrawIndirectCommand));
+        }
 
-    if (hasSkybox)
+        vkCmdEndRenderPass(commandBuffer);
+
+        if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+            throw std::runtime_error("failed to record command buffer!");
+        return;
+    }
+
+    std::array<glm::vec4, 6> planes = getFrustumPlanes(frustum, cullingView);
+    glm::vec3 cameraPosition = glm::vec3(glm::inverse(cullingView)[3]);
+    // meshlets and elided binds are counted while recording, the cull of this list may have been skipped
+    cullingStats.meshletFrustumRejected = 0;
+    cullingStats.meshletBackfaceRejected = 0;
+    cullingStats.meshletAccepted = 0;
+    cullingStats.pipelineBindsElided = 0;
+    cullingStats.vertexInputsElided = 0;
+
+    if (parallelRecording)
     {
-        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, skyboxGraphicsPipeline);
+        // a subpass holds either inline commands or secondary buffers, so the sky is recorded by the first slice
+        vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+        const std::vector<VkCommandBuffer> &secondaries = commandBufferCache ? cachedSecondaryBuffers[currentFrame * swapChainImages.size() + imageIndex] : secondaryCommandBuffers[currentFrame];
+        recordSecondaryCommandBuffers(secondaries, imageIndex, pushConstants, planes, cameraPosition);
+        vkCmdExecuteCommands(commandBuffer, static_cast<uint32_t>(secondaries.size()), secondaries.data());
+    }
+    else
+    {
+        vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+        recordFrameState(commandBuffer, pushConstants, true);
+        recordMeshes(commandBuffer, 0, renderQueue.size(), pushConstants, planes, cameraPosition, cullingStats);
+    }
 
-        uint32_t offsets[] = {0};
-        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, skyboxPipelineLayout, 0, 1, &descriptorSets[currentFrame], 1, offsets);
+    vkCmdEndRenderPass(commandBuffer);
 
-        // draw a quad to represent sky
-        vkCmdDraw(commandBuffer, 6, 1, 0, 0);
+    if (occlusionCulling)
+        recordDepthReadback(commandBuffer, proj * view);
+
+    if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+        throw std::runtime_error("failed to record command buffer!");
+}
+
+// formats the .s72 files name for vertex attributes, anything else is rejected at load
+static VkFormat parseVertexFormat(const std::string &format)
+{
+    static const std::unordered_map<std::string, VkFormat> formats = {
+        {"R32G32_SFLOAT", VK_FORMAT_R32G32_SFLOAT},
+        {"R32G32B32_SFLOAT", VK_FORMAT_R32G32B32_SFLOAT},
+        {"R32G32B32A32_SFLOAT", VK_FORMAT_R32G32B32A32_SFLOAT},
+        {"R8G8B8A8_UNORM", VK_FORMAT_R8G8B8A8_UNORM}};
+    auto iter = formats.find(format);
+    return iter == formats.end() ? VK_FORMAT_UNDEFINED : iter->second;
+}
+
+size_t VertexLayoutHash::operator()(const VertexLayout &layout) const
+{
+    // fnv-1a over the fields, unused attribute slots are zero
+    uint64_t hash = 14695981039346656037ull;
+    auto mix = [&](uint32_t value)
+    {
+        hash = (hash ^ value) * 1099511628211ull;
+    };
+    mix(layout.stride);
+    mix(layout.attributeCount);
+    for (uint32_t a = 0; a < layout.attributeCount; ++a)
+    {
+        mix(static_cast<uint32_t>(layout.formats[a]));
+        mix(layout.offsets[a]);
     }
+    return static_cast<size_t>(hash);
+}
 
-    pfnVkCmdSetVertexInputEXT = (PFN_vkCmdSetVertexInputEXT)vkGetDeviceProcAddr(device, "vkCmdSetVertexInputEXT");
+void VulkanHelper::createVertexLayouts()
+{
+    // shader input locations in order, the simple shaders have no tangent and texcoord
+    static const VkFormat simpleFormats[] = {VK_FORMAT_R32G32B32_SFLOAT, VK_FORMAT_R32G32B32_SFLOAT, VK_FORMAT_R8G8B8A8_UNORM};
+    static const VkFormat materialFormats[] = {VK_FORMAT_R32G32B32_SFLOAT, VK_FORMAT_R32G32B32_SFLOAT, VK_FORMAT_R32G32B32A32_SFLOAT, VK_FORMAT_R32G32_SFLOAT, VK_FORMAT_R8G8B8A8_UNORM};
+    static const char *simpleNames[] = {"position", "normal", "color"};
+    static const char *materialNames[] = {"position", "normal", "tangent", "texcoord", "color"};
 
-    VkDeviceSize offsets[] = {0};
-    uint32_t uboOffsets[] = {-static_cast<uint32_t>(sizeof(UniformBufferObject))}; // dummy offset
+    // the format strings are compared once per mesh here, recording only sees the ids
+    std::unordered_map<VertexLayout, uint32_t, VertexLayoutHash> layoutIds;
+    std::vector<VertexLayout> layouts;
+    std::vector<uint64_t> layoutInstances;
+    meshLayoutIds.resize(vertexBuffers.size());
     for (size_t i = 0; i < vertexBuffers.size(); ++i)
     {
+        VertexLayout layout;
+        layout.stride = strides[i];
+        const std::string *formatNames[5];
         if (simpleScene)
         {
-            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
+            layout.attributeCount = 3;
+            layout.offsets = {posOffsets[i], normalOffsets[i], colorOffsets[i]};
+            formatNames[0] = &posFormats[i];
+            formatNames[1] = &normalFormats[i];
+            formatNames[2] = &colorFormats[i];
         }
         else
         {
-            bindSuitableGraphicsPipeline(commandBuffer, vboPipelineId[i]);
+            layout.attributeCount = 5;
+            layout.offsets = {posOffsets[i], normalOffsets[i], tangentOffsets[i], texcoordOffsets[i], colorOffsets[i]};
+            formatNames[0] = &posFormats[i];
+            formatNames[1] = &normalFormats[i];
+            formatNames[2] = &tangentFormats[i];
+            formatNames[3] = &texcoordFormats[i];
+            formatNames[4] = &colorFormats[i];
         }
-
-        if (simpleScene)
+        for (uint32_t a = 0; a < layout.attributeCount; ++a)
         {
-            updateVertexDescriptions(strides[i], posOffsets[i], normalOffsets[i], colorOffsets[i], posFormats[i], normalFormats[i], colorFormats[i]);
-            pfnVkCmdSetVertexInputEXT(commandBuffer, 1, &vertexBindingDescriptions, 3, vertexAttributeDescriptions);
+            layout.formats[a] = parseVertexFormat(*formatNames[a]);
+            if (layout.formats[a] != (simpleScene ? simpleFormats[a] : materialFormats[a]))
+                throw std::logic_error(std::string("undefined ") + (simpleScene ? simpleNames[a] : materialNames[a]) + " format!");
         }
-        else
+
+        auto [iter, inserted] = layoutIds.try_emplace(layout, static_cast<uint32_t>(layouts.size()));
+        if (inserted)
         {
-            updateVertexDescriptions2(strides[i], posOffsets[i], normalOffsets[i], tangentOffsets[i], texcoordOffsets[i], colorOffsets[i], posFormats[i], normalFormats[i], tangentFormats[i], texcoordFormats[i], colorFormats[i]);
-            pfnVkCmdSetVertexInputEXT(commandBuffer, 1, &vertexBindingDescriptions2, 5, vertexAttributeDescriptions2);
+            layouts.push_back(layout);
+            layoutInstances.push_back(0);
         }
+        meshLayoutIds[i] = iter->second;
+        layoutInstances[iter->second] += instanceCounts[i];
+    }
 
-        vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffers[i], offsets);
-
-        for (uint32_t j = 0; j < instanceCounts[i]; ++j)
-        {
-            uboOffsets[0] += static_cast<uint32_t>(sizeof(UniformBufferObject));
+    // the layouts drawing the most instances get the static pipelines
+    std::vector<uint32_t> order(layouts.size());
+    for (uint32_t l = 0; l < order.size(); ++l)
+    {
+        order[l] = l;
+    }
+    std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b)
+                     { return layoutInstances[a] > layoutInstances[b]; });
+    std::vector<uint32_t> remap(layouts.size());
+    vertexLayouts.resize(layouts.size());
+    for (uint32_t l = 0; l < order.size(); ++l)
+    {
+        remap[order[l]] = l;
+        vertexLayouts[l] = layouts[order[l]];
+    }
 
-            bool visible = test_using_separating_axis_theorem(frustum, aabbTransforms[uboOffsets[0] / static_cast<uint32_t>(sizeof(UniformBufferObject))], aabbs[i]);
+    dynamicPipelineVariant = std::min(static_cast<uint32_t>(vertexLayouts.size()), MAX_STATIC_VERTEX_LAYOUTS);
+    if (vertexLayouts.size() > dynamicPipelineVariant && !vertexInputDynamicState)
+        throw std::runtime_error("scene has more vertex layouts than static pipelines and no dynamic vertex input!");
+    meshPipelineVariants.resize(vertexBuffers.size());
+    for (size_t i = 0; i < vertexBuffers.size(); ++i)
+    {
+        meshLayoutIds[i] = remap[meshLayoutIds[i]];
+        meshPipelineVariants[i] = std::min(meshLayoutIds[i], dynamicPipelineVariant);
+    }
 
-            if (visible)
-            {
-                if (simpleScene)
-                {
-                    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets[currentFrame], 1, uboOffsets);
-                }
-                else
-                {
-                    bindSuitableDescriptorSet(commandBuffer, vboPipelineId[i], vboMaterialId[i], uboOffsets);
-                }
-                vkCmdDraw(commandBuffer, counts[i], 1, 0, 0);
-            }
+    // state for vkCmdSetVertexInputEXT, only the layouts past the static ones ever use it
+    layoutVertexInputs.resize(vertexLayouts.size());
+    for (size_t l = 0; l < vertexLayouts.size(); ++l)
+    {
+        const VertexLayout &layout = vertexLayouts[l];
+        DynamicVertexInput &input = layoutVertexInputs[l];
+        input.binding = {
+            .sType = VK_STRUCTURE_TYPE_VERTEX_INPUT_BINDING_DESCRIPTION_2_EXT,
+            .binding = 0,
+            .stride = layout.stride,
+            .inputRate = VK_VERTEX_INPUT_RATE_VERTEX,
+            .divisor = 1};
+        for (uint32_t a = 0; a < layout.attributeCount; ++a)
+        {
+            input.attributes[a] = {
+                .sType = VK_STRUCTURE_TYPE_VERTEX_INPUT_ATTRIBUTE_DESCRIPTION_2_EXT,
+                .location = a,
+                .binding = 0,
+                .format = layout.formats[a],
+                .offset = layout.offsets[a]};
         }
+        input.attributeCount = layout.attributeCount;
     }
+}
 
-    vkCmdEndRenderPass(commandBuffer);
+void VulkanHelper::createRenderQueue()
+{
+    // 4 bits each of pipeline and variant, 16 of material set, 16 of vertex layout and 24 of mesh, sorting the keys
+    // sorts by all of them; the variant goes before the material since a variant change rebinds the pipeline
+    if (vertexBuffers.size() >= (1u << 24) || vertexLayouts.size() >= (1u << 16))
+        throw std::runtime_error("too many meshes for the render queue!");
+    std::vector<uint64_t> keys(vertexBuffers.size());
+    for (size_t i = 0; i < vertexBuffers.size(); ++i)
+    {
+        uint64_t pipelineId = simpleScene ? 0 : vboPipelineId[i];
+        uint64_t materialId = simpleScene ? 0 : vboMaterialId[i];
+        if (materialId >= (1u << 16))
+            throw std::runtime_error("too many materials for the render queue!");
+        keys[i] = (pipelineId << 60) | (static_cast<uint64_t>(meshPipelineVariants[i]) << 56) | (materialId << 40) | (static_cast<uint64_t>(meshLayoutIds[i]) << 24) | i;
+    }
+    std::sort(keys.begin(), keys.end());
 
-    if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
-        throw std::runtime_error("failed to record command buffer!");
+    renderQueue.resize(keys.size());
+    for (size_t i = 0; i < keys.size(); ++i)
+    {
+        renderQueue[i] = static_cast<uint32_t>(keys[i] & 0xffffff);
+    }
 }
 
-void VulkanHelper::updateVertexDescriptions(uint32_t stride, uint32_t posOffset, uint32_t normalOffset, uint32_t colorOffset, std::string posFormat, std::string normalFormat, std::string colorFormat)
+void VulkanHelper::bindMeshState(VkCommandBuffer commandBuffer, const std::vector<VkPipeline> &pipelines, uint32_t mesh, MeshBindState &bound, CullingStats &stats)
 {
-    VkFormat posF, normalF, colorF;
-    if (posFormat == "R32G32B32_SFLOAT")
-        posF = VK_FORMAT_R32G32B32_SFLOAT;
-    else
-        throw std::logic_error("undefined position format!");
-    if (normalFormat == "R32G32B32_SFLOAT")
-        normalF = VK_FORMAT_R32G32B32_SFLOAT;
-    else
-        throw std::logic_error("undefined normal format!");
-    if (colorFormat == "R8G8B8A8_UNORM")
-        colorF = VK_FORMAT_R8G8B8A8_UNORM;
+    uint32_t variant = meshPipelineVariants[mesh];
+    if (pipelines[variant] != bound.pipeline)
+    {
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines[variant]);
+        bound.pipeline = pipelines[variant];
+        // a static vertex input replaces whatever was set dynamically before
+        if (variant != dynamicPipelineVariant)
+            bound.layoutId = UINT32_MAX;
+    }
     else
-        throw std::logic_error("undefined color format!");
+    {
+        stats.pipelineBindsElided++;
+    }
+    if (variant != dynamicPipelineVariant)
+        return;
 
-    vertexBindingDescriptions.stride = stride;
-    vertexAttributeDescriptions[0].offset = posOffset;
-    vertexAttributeDescriptions[0].format = posF;
-    vertexAttributeDescriptions[1].offset = normalOffset;
-    vertexAttributeDescriptions[1].format = normalF;
-    vertexAttributeDescriptions[2].offset = colorOffset;
-    vertexAttributeDescriptions[2].format = colorF;
+    uint32_t layoutId = meshLayoutIds[mesh];
+    if (layoutId != bound.layoutId)
+    {
+        const DynamicVertexInput &input = layoutVertexInputs[layoutId];
+        pfnVkCmdSetVertexInputEXT(commandBuffer, 1, &input.binding, input.attributeCount, input.attributes.data());
+        bound.layoutId = layoutId;
+    }
+    else
+    {
+        stats.vertexInputsElided++;
+    }
 }
 
-void VulkanHelper::updateVertexDescriptions2(uint32_t stride, uint32_t posOffset, uint32_t normalOffset, uint32_t tangentOffset, uint32_t texcoordOffset, uint32_t colorOffset, std::string posFormat, std::string normalFormat, std::string tangentFormat, std::string texcoordFormat, std::string colorFormat)
+void VulkanHelper::updateUniformBuffer(uint32_t currentImage, const std::vector<glm::mat4> &uniformData, const std::vector<uint32_t> &dirtyInstances, glm::mat4 view, bool debug)
 {
-    VkFormat posF, normalF, tangentF, texcoordF, colorF;
-    if (posFormat == "R32G32B32_SFLOAT")
-        posF = VK_FORMAT_R32G32B32_SFLOAT;
-    else
-        throw std::logic_error("undefined position format!");
-    if (normalFormat == "R32G32B32_SFLOAT")
-        normalF = VK_FORMAT_R32G32B32_SFLOAT;
-    else
-        throw std::logic_error("undefined normal format!");
-    if (tangentFormat == "R32G32B32A32_SFLOAT")
-        tangentF = VK_FORMAT_R32G32B32A32_SFLOAT;
-    else
-        throw std::logic_error("undefined tangent format!");
-    if (texcoordFormat == "R32G32_SFLOAT")
-        texcoordF = VK_FORMAT_R32G32_SFLOAT;
+    if (uniformCount != uniformData.size())
+    {
+        // first frame, every frame in flight gets the whole buffer
+        uniformCount = uniformData.size();
+        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i)
+        {
+            uniformBufferStale[i] = true;
+            pendingUniforms[i].clear();
+            pendingUniformFlags[i].assign(uniformData.size(), 0);
+        }
+    }
     else
-        throw std::logic_error("undefined texcoord format!");
-    if (colorFormat == "R8G8B8A8_UNORM")
-        colorF = VK_FORMAT_R8G8B8A8_UNORM;
+    {
+        // the other frames in flight still hold the old matrix until their turn comes
+        for (auto instance : dirtyInstances)
+        {
+            for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i)
+            {
+                if (!uniformBufferStale[i] && !pendingUniformFlags[i][instance])
+                {
+                    pendingUniformFlags[i][instance] = 1;
+                    pendingUniforms[i].push_back(instance);
+                }
+            }
+        }
+    }
+
+    // model and normal matrices go straight into the mapped memory, split across the job system
+    UniformBufferObject *mapped = static_cast<UniformBufferObject *>(uniformBuffersMapped[currentImage]);
+    JobSystem &jobs = JobSystem::instance();
+    if (uniformBufferStale[currentImage])
+    {
+        jobs.parallelFor(uniformData.size(), UNIFORM_GRAIN_SIZE, [mapped, &uniformData](size_t first, size_t last)
+                         {
+            for (size_t i = first; i < last; ++i)
+            {
+                mapped[i].model = uniformData[i];
+                mapped[i].normal = glm::transpose(glm::inverse(uniformData[i]));
+            } });
+        uniformBufferStale[currentImage] = false;
+    }
     else
-        throw std::logic_error("undefined color format!");
+    {
+        const std::vector<uint32_t> &pending = pendingUniforms[currentImage];
+        jobs.parallelFor(pending.size(), UNIFORM_GRAIN_SIZE, [mapped, &uniformData, &pending](size_t first, size_t last)
+                         {
+            for (size_t i = first; i < last; ++i)
+            {
+                uint32_t instance = pending[i];
+                mapped[instance].model = uniformData[instance];
+                mapped[instance].normal = glm::transpose(glm::inverse(uniformData[instance]));
+            } });
+    }
+    for (auto instance : pendingUniforms[currentImage])
+    {
+        pendingUniformFlags[currentImage][instance] = 0;
+    }
+    pendingUniforms[currentImage].clear();
+
+    // the compute pass reads the matrices straight from the ubo, no cpu side culling data to keep up
+    if (gpuCulling)
+    {
+        if (!debug)
+            cullingView = view;
+        return;
+    }
 
-    vertexBindingDescriptions2.stride = stride;
-    vertexAttributeDescriptions2[0].offset = posOffset;
-    vertexAttributeDescriptions2[0].format = posF;
-    vertexAttributeDescriptions2[1].offset = normalOffset;
-    vertexAttributeDescriptions2[1].format = normalF;
-    vertexAttributeDescriptions2[2].offset = tangentOffset;
-    vertexAttributeDescriptions2[2].format = tangentF;
-    vertexAttributeDescriptions2[3].offset = texcoordOffset;
-    vertexAttributeDescriptions2[3].format = texcoordF;
-    vertexAttributeDescriptions2[4].offset = colorOffset;
-    vertexAttributeDescriptions2[4].format = colorF;
+    // world boxes of the moved instances, the bvh is built on the first frame and only refitted after that
+    if (bvh.size() != uniformData.size())
+    {
+        cullingTransforms = uniformData;
+        worldAabbs.resize(uniformData.size());
+        worldSpheres.resize(uniformData.size());
+        jobs.parallelFor(uniformData.size(), UNIFORM_GRAIN_SIZE, [this](size_t first, size_t last)
+                         {
+            for (size_t i = first; i < last; ++i)
+            {
+                worldAabbs[i] = transformAABB(cullingTransforms[i], instanceAabbs[i]);
+                worldSpheres[i] = transformBoundingSphere(cullingTransforms[i], instanceAabbs[i]);
+            } });
+        bvh.build(worldAabbs);
+        temporalCuller.resize(uniformData.size());
+        sceneVersion++;
+    }
+    else if (!dirtyInstances.empty())
+    {
+        sceneVersion++;
+        jobs.parallelFor(dirtyInstances.size(), UNIFORM_GRAIN_SIZE, [this, &uniformData, &dirtyInstances](size_t first, size_t last)
+                         {
+            for (size_t i = first; i < last; ++i)
+            {
+                uint32_t instance = dirtyInstances[i];
+                cullingTransforms[instance] = uniformData[instance];
+                worldAabbs[instance] = transformAABB(uniformData[instance], instanceAabbs[instance]);
+                worldSpheres[instance] = transformBoundingSphere(uniformData[instance], instanceAabbs[instance]);
+            } });
+        bvh.refit(worldAabbs, dirtyInstances);
+        temporalCuller.invalidate(dirtyInstances);
+    }
+    if (!debug)
+        cullingView = view;
 }
 
-void VulkanHelper::updateUniformBuffer(uint32_t currentImage, const std::vector<glm::mat4> &uniformData, glm::mat4 view, bool debug)
+void VulkanHelper::createVertexBuffers(const std::vector<std::string> &vertexData, const std::vector<AABB> &in_aabbs, const std::vector<uint32_t> &in_counts, const std::vector<uint32_t> &in_strides, const std::vector<uint32_t> &in_posOffsets, const std::vector<uint32_t> &in_normalOffsets)
 {
-    std::vector<UniformBufferObject> ubo;
-    ubo.resize(uniformData.size());
-    aabbTransforms.resize(uniformData.size());
-
-    for (size_t i = 0; i < uniformData.size(); ++i)
+    // all vertex files stay mapped until the upload, so the bounds of every mesh are computed in one parallel pass
+    std::vector<MappedFile> mappedFiles(vertexData.size());
+    std::vector<std::vector<char>> readFiles(vertexData.size());
+    std::vector<VertexSource> sources(vertexData.size());
+    for (size_t i = 0; i < vertexData.size(); ++i)
     {
-        ubo[i].model = uniformData[i];
-        ubo[i].normal = glm::transpose(glm::inverse(uniformData[i]));
-        if (!debug)
+        sources[i] = VertexSource{.stride = in_strides[i], .posOffset = in_posOffsets[i], .normalOffset = in_normalOffsets[i]};
+        if (mappedFiles[i].open(vertexData[i]))
+        {
+            sources[i].vertices = mappedFiles[i].data();
+            sources[i].size = mappedFiles[i].size();
+        }
+        else
         {
-            aabbTransforms[i] = view * uniformData[i];
+            readFiles[i] = readFile(vertexData[i]);
+            sources[i].vertices = readFiles[i].data();
+            sources[i].size = readFiles[i].size();
         }
     }
 
-    memcpy(uniformBuffersMapped[currentImage], ubo.data(), sizeof(UniformBufferObject) * ubo.size());
+    // bounds coming from a compiled scene are taken as they are
+    if (in_aabbs.empty())
+        createAABBs(sources, aabbs);
+    else
+        aabbs.assign(in_aabbs.begin(), in_aabbs.end());
+
+    // with meshlet culling the triangles are uploaded in meshlet order instead of the file order
+    meshlets.assign(sources.size(), {});
+    std::vector<char> reordered;
+    for (size_t i = 0; i < sources.size(); ++i)
+    {
+        if (meshletCulling)
+        {
+            buildMeshlets(sources[i], in_counts[i], reordered, meshlets[i]);
+            createVertexBuffer(reordered.data(), reordered.size());
+        }
+        else
+        {
+            createVertexBuffer(sources[i].vertices, sources[i].size);
+        }
+    }
 }
 
 void VulkanHelper::createVertexBuffer(const char *meshData, size_t size)
@@ -1630,14 +3119,39 @@ void VulkanHelper::createUniformBuffers(size_t size)
     uniformBuffers.resize(MAX_FRAMES_IN_FLIGHT);
     uniformBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
     uniformBuffersMapped.resize(MAX_FRAMES_IN_FLIGHT);
+    uniformBufferStale.assign(MAX_FRAMES_IN_FLIGHT, true);
+    pendingUniforms.resize(MAX_FRAMES_IN_FLIGHT);
+    pendingUniformFlags.resize(MAX_FRAMES_IN_FLIGHT);
 
     for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
     {
-        createBuffer(bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, uniformBuffers[i], uniformBuffersMemory[i]);
+        // the culling compute pass and the indirect vertex shader read the same buffer as an ssbo
+        VkBufferUsageFlags usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
+        if (gpuCulling || instancedDrawing)
+            usage |= VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+        createBuffer(bufferSize, usage, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, uniformBuffers[i], uniformBuffersMemory[i]);
         vkMapMemory(device, uniformBuffersMemory[i], 0, bufferSize, 0, &uniformBuffersMapped[i]);
     }
 }
 
+void VulkanHelper::createDeviceLocalBuffer(const void *data, VkDeviceSize size, VkBufferUsageFlags usage, VkBuffer &buffer, VkDeviceMemory &bufferMemory)
+{
+    VkBuffer stagingBuffer;
+    VkDeviceMemory stagingBufferMemory;
+    createBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+
+    void *mapped;
+    vkMapMemory(device, stagingBufferMemory, 0, size, 0, &mapped);
+    memcpy(mapped, data, (size_t)size);
+    vkUnmapMemory(device, stagingBufferMemory);
+
+    createBuffer(size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buffer, bufferMemory);
+    copyBuffer(stagingBuffer, buffer, size);
+
+    vkDestroyBuffer(device, stagingBuffer, nullptr);
+    vkFreeMemory(device, stagingBufferMemory, nullptr);
+}
+
 void VulkanHelper::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer &buffer, VkDeviceMemory &bufferMemory)
 {
     VkBufferCreateInfo bufferInfo{
@@ -21,17 +21,31 @@
 #include <cstdint> // for uint32_t
 #include <limits>  // for std::numeric_limits
 #include <array>
+#include <bit>
 #include <optional>
 #include <set>
 #include <unordered_map>
 
+#include "BvhHelper.h"
 #include "CullingHelper.h"
+#include "JobSystem.h"
+#include "MeshletHelper.h"
+#include "OcclusionHelper.h"
+#include "PlatformHelper.h"
 
 const int MAX_FRAMES_IN_FLIGHT = 2;
 const int MAX_TEXTURE_COUNTS = 16;
+// instances per job when the uniform matrices and culling boxes are built in parallel
+const size_t UNIFORM_GRAIN_SIZE = 1024;
+// must match local_size_x in shaders/cull.comp
+const uint32_t CULL_WORKGROUP_SIZE = 64;
+// occluders the software rasterizer picks among the named meshes' instances when picking automatically
+const size_t MAX_AUTO_OCCLUDERS = 32;
+// the most used vertex layouts of a scene get pipelines baked for them, the rest share the dynamic vertex input one
+const uint32_t MAX_STATIC_VERTEX_LAYOUTS = 8;
 
 const std::vector<const char *> validationLayers = {"VK_LAYER_KHRONOS_validation"};
-const std::vector<const char *> deviceExtensions = {VK_KHR_SWAPCHAIN_EXTENSION_NAME, VK_EXT_VERTEX_INPUT_DYNAMIC_STATE_EXTENSION_NAME};
+const std::vector<const char *> deviceExtensions = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
 
 #ifdef NDEBUG
 const bool enableValidationLayers = false;
@@ -77,6 +91,53 @@ struct Vertex2
     glm::vec4 color;
 };
 
+// vertex layout of a mesh with its format strings resolved at load, meshes with equal layouts share one pipeline variant
+struct VertexLayout
+{
+    uint32_t stride = 0;
+    uint32_t attributeCount = 0;
+    std::array<VkFormat, 5> formats{};
+    std::array<uint32_t, 5> offsets{};
+
+    bool operator==(const VertexLayout &other) const = default;
+};
+
+struct VertexLayoutHash
+{
+    size_t operator()(const VertexLayout &layout) const;
+};
+
+// the same layout for vkCmdSetVertexInputEXT, only used by the dynamic fallback pipeline
+struct DynamicVertexInput
+{
+    VkVertexInputBindingDescription2EXT binding;
+    std::array<VkVertexInputAttributeDescription2EXT, 5> attributes;
+    uint32_t attributeCount;
+};
+
+// what the last mesh bound in a command buffer
+struct MeshBindState
+{
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    uint32_t layoutId = UINT32_MAX; // dynamic vertex input only
+};
+
+// everything a recorded frame depends on besides its frame in flight and swap chain image
+struct CommandSignature
+{
+    glm::mat4 view;
+    glm::mat4 proj;
+    glm::mat4 cullingView;
+    uint64_t sceneVersion; // bumped whenever an instance moves
+    std::vector<uint32_t> drawList;
+    bool valid = false;
+
+    bool matches(glm::mat4 in_view, glm::mat4 in_proj, glm::mat4 in_cullingView, uint64_t in_sceneVersion, const std::vector<uint32_t> &in_drawList) const
+    {
+        return valid && view == in_view && proj == in_proj && cullingView == in_cullingView && sceneVersion == in_sceneVersion && drawList == in_drawList;
+    }
+};
+
 struct UniformBufferObject
 {
     alignas(16) glm::mat4 model;
@@ -89,17 +150,55 @@ struct PushConstants
     glm::mat4 proj;
 };
 
+// local box of one instance for the culling compute pass, std430 layout
+struct GpuInstanceBounds
+{
+    glm::vec3 min;
+    uint32_t mesh;
+    glm::vec3 max;
+    uint32_t pad;
+};
+
+struct CullPushConstants
+{
+    glm::vec4 planes[6];
+    uint32_t instanceCount;
+};
+
 class VulkanHelper
 {
 public:
     void initVulkan(GLFWwindow *window);
-    void initScene(std::vector<std::string> &vertexData, size_t uboSize, std::vector<uint32_t> &in_counts, std::vector<uint32_t> &in_strides, std::vector<uint32_t> &in_posOffsets, std::vector<uint32_t> &in_normalOffsets, std::vector<uint32_t> &in_colorOffsets, std::vector<std::string> &in_posFormats, std::vector<std::string> &in_normalFormats, std::vector<std::string> &in_colorFormats, std::vector<uint32_t> &in_instanceCounts, std::string &cubemap);
-    void initScene(std::vector<std::string> &vertexData, size_t uboSize, std::vector<uint32_t> &in_counts, std::vector<uint32_t> &in_strides, std::vector<uint32_t> &in_posOffsets, std::vector<uint32_t> &in_normalOffsets, std::vector<uint32_t> &in_tangentOffsets, std::vector<uint32_t> &in_texcoordOffsets, std::vector<uint32_t> &in_colorOffsets, std::vector<std::string> &in_posFormats, std::vector<std::string> &in_normalFormats, std::vector<std::string> &in_tangentFormats, std::vector<std::string> &in_texcoordFormats, std::vector<std::string> &in_colorFormats, std::vector<uint32_t> &in_instanceCounts, std::vector<uint32_t> &materialId, const std::vector<uint32_t> &in_vboMaterialId, const std::vector<uint32_t> &in_vboPipelineId, const std::unordered_map<uint32_t, std::vector<std::string>> &materialTexturePair, std::string &cubemap);
-    void drawFrame(GLFWwindow *window, const std::vector<glm::mat4> &uniformData, glm::mat4 view, glm::mat4 proj, bool debug);
+    void initScene(std::vector<std::string> &vertexData, std::vector<AABB> &in_aabbs, size_t uboSize, std::vector<uint32_t> &in_counts, std::vector<uint32_t> &in_strides, std::vector<uint32_t> &in_posOffsets, std::vector<uint32_t> &in_normalOffsets, std::vector<uint32_t> &in_colorOffsets, std::vector<std::string> &in_posFormats, std::vector<std::string> &in_normalFormats, std::vector<std::string> &in_colorFormats, std::vector<uint32_t> &in_instanceCounts, std::string &cubemap);
+    void initScene(std::vector<std::string> &vertexData, std::vector<AABB> &in_aabbs, size_t uboSize, std::vector<uint32_t> &in_counts, std::vector<uint32_t> &in_strides, std::vector<uint32_t> &in_posOffsets, std::vector<uint32_t> &in_normalOffsets, std::vector<uint32_t> &in_tangentOffsets, std::vector<uint32_t> &in_texcoordOffsets, std::vector<uint32_t> &in_colorOffsets, std::vector<std::string> &in_posFormats, std::vector<std::string> &in_normalFormats, std::vector<std::string> &in_tangentFormats, std::vector<std::string> &in_texcoordFormats, std::vector<std::string> &in_colorFormats, std::vector<uint32_t> &in_instanceCounts, std::vector<uint32_t> &materialId, const std::vector<uint32_t> &in_vboMaterialId, const std::vector<uint32_t> &in_vboPipelineId, const std::unordered_map<uint32_t, std::vector<std::string>> &materialTexturePair, std::string &cubemap);
+    void drawFrame(GLFWwindow *window, const std::vector<glm::mat4> &uniformData, const std::vector<uint32_t> &dirtyInstances, glm::mat4 view, glm::mat4 proj, bool debug);
     void cleanup();
 
     VkDevice getDevice();
     void setCullingFrustum(float right, float top, float near, float far);
+    void setTemporalCulling(bool enabled);
+    // has to be set before initVulkan, the device features depend on it; like instanced drawing it shades with
+    // indirect.frag rather than the scene's own fragment shader, so the image is not the cpu path's
+    void setGpuCulling(bool enabled);
+    // has to be set before initVulkan, the depth attachment is only stored when it is on
+    void setOcclusionCulling(bool enabled);
+    // the cpu path draws every mesh of a scene without materials as one instanced call, off by default since
+    // the instanced pipeline shades with indirect.frag rather than the scene's own fragment shader
+    void setInstancedDrawing(bool enabled);
+    // records the meshes on the job threads into secondary command buffers, the cpu culling path only
+    void setParallelRecording(bool enabled);
+    // keeps a recorded frame per frame in flight and swap chain image and submits it again while nothing changed
+    void setCommandBufferCache(bool enabled);
+    // splits meshes into meshlets at load and culls those against the frustum and by their normal cone
+    void setMeshletCulling(bool enabled);
+    // rasterizes a few large occluders on the cpu instead of reading depth back, replaces the readback when both are set
+    void setSoftwareOcclusion(bool enabled);
+    // indices of the meshes that fill their bounds, only their instances are rasterized as occluders, none hides nothing
+    void setOccluderMeshes(const std::vector<uint32_t> &meshes);
+    // rasterizes only the biggest visible instances of the occluder meshes every frame instead of all of them
+    void setAutoOccluders(bool enabled);
+    // tier counters of the last recorded frame
+    const CullingStats &getCullingStats() const;
 
 private:
     VkInstance instance;
@@ -126,11 +225,12 @@ private:
     VkPipelineLayout pbrPipelineLayout;
     VkPipelineLayout lambertianPipelineLayout;
     VkPipelineLayout mirrorPipelineLayout;
-    VkPipeline graphicsPipeline;
+    // mesh pipelines have a variant per static vertex layout, indexed by meshPipelineVariants
+    std::vector<VkPipeline> graphicsPipelines;
     VkPipeline skyboxGraphicsPipeline;
-    VkPipeline pbrGraphicsPipeline;
-    VkPipeline lambertianGraphicsPipeline;
-    VkPipeline mirrorGraphicsPipeline;
+    std::vector<VkPipeline> pbrGraphicsPipelines;
+    std::vector<VkPipeline> lambertianGraphicsPipelines;
+    std::vector<VkPipeline> mirrorGraphicsPipelines;
 
     VkCommandPool commandPool;
     std::vector<VkCommandBuffer> commandBuffers;
@@ -167,71 +267,114 @@ private:
     std::vector<std::string> texcoordFormats;
     std::vector<std::string> colorFormats;
     std::vector<uint32_t> instanceCounts;
-
-    VkVertexInputBindingDescription2EXT vertexBindingDescriptions{
-        .sType = VK_STRUCTURE_TYPE_VERTEX_INPUT_BINDING_DESCRIPTION_2_EXT,
-        .binding = 0,
-        .stride = sizeof(Vertex),
-        .inputRate = VK_VERTEX_INPUT_RATE_VERTEX,
-        .divisor = 1};
-    VkVertexInputBindingDescription2EXT vertexBindingDescriptions2{
-        .sType = VK_STRUCTURE_TYPE_VERTEX_INPUT_BINDING_DESCRIPTION_2_EXT,
-        .binding = 0,
-        .stride = sizeof(Vertex2),
-        .inputRate = VK_VERTEX_INPUT_RATE_VERTEX,
-        .divisor = 1};
-    VkVertexInputAttributeDescription2EXT vertexAttributeDescriptions[3]{
-        {.sType = VK_STRUCTURE_TYPE_VERTEX_INPUT_ATTRIBUTE_DESCRIPTION_2_EXT,
-         .location = 0,
-         .binding = 0,
-         .format = VK_FORMAT_R32G32B32_SFLOAT,
-         .offset = offsetof(Vertex, pos)},
-        {.sType = VK_STRUCTURE_TYPE_VERTEX_INPUT_ATTRIBUTE_DESCRIPTION_2_EXT,
-         .location = 1,
-         .binding = 0,
-         .format = VK_FORMAT_R32G32B32_SFLOAT,
-         .offset = offsetof(Vertex, normal)},
-        {.sType = VK_STRUCTURE_TYPE_VERTEX_INPUT_ATTRIBUTE_DESCRIPTION_2_EXT,
-         .location = 2,
-         .binding = 0,
-         .format = VK_FORMAT_R8G8B8A8_UNORM,
-         .offset = offsetof(Vertex, color)}};
-    VkVertexInputAttributeDescription2EXT vertexAttributeDescriptions2[5]{
-        {.sType = VK_STRUCTURE_TYPE_VERTEX_INPUT_ATTRIBUTE_DESCRIPTION_2_EXT,
-         .location = 0,
-         .binding = 0,
-         .format = VK_FORMAT_R32G32B32_SFLOAT,
-         .offset = offsetof(Vertex2, pos)},
-         {.sType = VK_STRUCTURE_TYPE_VERTEX_INPUT_ATTRIBUTE_DESCRIPTION_2_EXT,
-         .location = 1,
-         .binding = 0,
-         .format = VK_FORMAT_R32G32B32_SFLOAT,
-         .offset = offsetof(Vertex2, normal)},
-         {.sType = VK_STRUCTURE_TYPE_VERTEX_INPUT_ATTRIBUTE_DESCRIPTION_2_EXT,
-         .location = 2,
-         .binding = 0,
-         .format = VK_FORMAT_R32G32B32A32_SFLOAT,
-         .offset = offsetof(Vertex2, tangent)},
-        {.sType = VK_STRUCTURE_TYPE_VERTEX_INPUT_ATTRIBUTE_DESCRIPTION_2_EXT,
-         .location = 3,
-         .binding = 0,
-         .format = VK_FORMAT_R32G32_SFLOAT,
-         .offset = offsetof(Vertex2, texcoord)},
-        {.sType = VK_STRUCTURE_TYPE_VERTEX_INPUT_ATTRIBUTE_DESCRIPTION_2_EXT,
-         .location = 4,
-         .binding = 0,
-         .format = VK_FORMAT_R8G8B8A8_UNORM,
-         .offset = offsetof(Vertex2, color)}};
-
+    // only read while recording, so any thread can use them
+    bool vertexInputDynamicState = false; // the device has VK_EXT_vertex_input_dynamic_state
+    std::vector<VertexLayout> vertexLayouts; // most used first
+    std::vector<DynamicVertexInput> layoutVertexInputs;
+    std::vector<uint32_t> meshLayoutIds;
+    std::vector<uint32_t> meshPipelineVariants; // the layout id for static layouts, else dynamicPipelineVariant
+    uint32_t dynamicPipelineVariant = 0;
+    // meshes in sort key order, pipeline and its variant first, then material set, vertex layout and the mesh itself,
+    // so recording only has to bind what differs from the mesh before
+    std::vector<uint32_t> renderQueue;
     std::vector<VkBuffer> vertexBuffers;
     std::vector<VkDeviceMemory> vertexBufferMemorys;
     std::vector<VkBuffer> uniformBuffers;
     std::vector<VkDeviceMemory> uniformBuffersMemory;
     std::vector<void *> uniformBuffersMapped;
+    // the ubo is written in place, every frame in flight only gets the instances changed since it was last written
+    size_t uniformCount = 0;
+    std::vector<std::vector<uint32_t>> pendingUniforms;
+    std::vector<std::vector<uint8_t>> pendingUniformFlags;
+    std::vector<bool> uniformBufferStale;
     std::vector<AABB> aabbs;
-    std::vector<glm::mat4> aabbTransforms;
+    // local and world boxes per ubo instance, the bvh is built over the world ones
+    std::vector<AABB> instanceAabbs;
+    std::vector<AABB> worldAabbs;
+    std::vector<glm::vec4> worldSpheres;
+    std::vector<glm::mat4> cullingTransforms;
+    glm::mat4 cullingView = glm::mat4(1.0f);
+    InstanceBvh bvh;
+    std::vector<uint32_t> visibility;
+    std::vector<uint32_t> cullCandidates;
+    std::vector<glm::mat4> candidateTransforms;
+    std::vector<AABB> candidateAabbs;
+    std::vector<uint32_t> candidateVisibility;
+    CullingStats cullingStats;
+    bool temporalCulling = false;
+    TemporalCuller temporalCuller;
     CullingFrustum frustum;
 
+    // gpu-driven path, a compute pass culls and compacts the instances and every mesh is one indirect count draw
+    bool gpuCulling = false;
+    VkDescriptorSetLayout gpuCullingSetLayout;
+    VkDescriptorPool gpuCullingDescriptorPool;
+    std::vector<VkDescriptorSet> gpuCullingDescriptorSets;
+    VkPipelineLayout cullPipelineLayout;
+    VkPipeline cullPipeline;
+    VkPipelineLayout indirectPipelineLayout;
+    std::vector<VkPipeline> indirectGraphicsPipelines;
+    VkBuffer instanceBoundsBuffer;
+    VkDeviceMemory instanceBoundsBufferMemory;
+    VkBuffer drawCommandTemplateBuffer;
+    VkDeviceMemory drawCommandTemplateBufferMemory;
+    std::vector<VkBuffer> drawCommandBuffers;
+    std::vector<VkDeviceMemory> drawCommandBuffersMemory;
+    std::vector<VkBuffer> drawCountBuffers;
+    std::vector<VkDeviceMemory> drawCountBuffersMemory;
+    std::vector<VkBuffer> visibleInstanceBuffers;
+    std::vector<VkDeviceMemory> visibleInstanceBuffersMemory;
+
+    // instanced cpu path, shares the indirect pipeline and fills its visible list from the cpu culling results
+    bool instancedDrawing = false;
+    VkDescriptorSetLayout instancingSetLayout;
+    VkDescriptorPool instancingDescriptorPool;
+    std::vector<VkDescriptorSet> instancingDescriptorSets;
+    std::vector<VkBuffer> visibleListBuffers;
+    std::vector<VkDeviceMemory> visibleListBuffersMemory;
+    std::vector<void *> visibleListBuffersMapped;
+    std::vector<uint32_t> drawList; // visible instance ids grouped by mesh, the order the list is written in
+    std::vector<uint32_t> drawListOffsets; // first slot of every mesh in drawList, one past the last slot at the back
+
+    // parallel recording, every job slice records a range of meshes into its own secondary buffer, allocated from
+    // a pool per slice and frame in flight so no two threads ever touch the same pool
+    bool parallelRecording = false;
+    std::vector<std::vector<VkCommandPool>> recordingPools; // [frame][slice]
+    std::vector<std::vector<VkCommandBuffer>> secondaryCommandBuffers;
+    std::vector<size_t> sliceFirstEntries; // render queue ranges, one past the last entry at the back
+    std::vector<CullingStats> sliceStats;
+
+    // static views submit the frame they recorded before, the cull is skipped too while its inputs hold
+    bool commandBufferCache = false;
+    uint64_t sceneVersion = 0;
+    std::vector<VkCommandBuffer> cachedCommandBuffers; // [frame * swap chain images + image]
+    std::vector<std::vector<VkCommandBuffer>> cachedSecondaryBuffers; // [slot][slice], only with parallel recording
+    std::vector<CommandSignature> cachedSignatures;
+    CommandSignature cullSignature; // inputs of the last cull, its draw list stays empty
+
+    // hi-z occlusion on the cpu path, every frame in flight reads its depth back and the next frame using the same
+    // slot reprojects it into its own view
+    bool occlusionCulling = false;
+    VkFormat depthReadbackFormat;
+    std::vector<VkBuffer> depthReadbackBuffers;
+    std::vector<VkDeviceMemory> depthReadbackBuffersMemory;
+    std::vector<void *> depthReadbackBuffersMapped;
+    std::vector<glm::mat4> depthViewProjs;
+    std::vector<bool> depthReadbackValid;
+    std::vector<float> depthScratch;
+    HiZBuffer hiZ;
+    bool hiZValid = false;
+    bool softwareOcclusion = false;
+    bool meshletCulling = false;
+    std::vector<std::vector<Meshlet>> meshlets; // per mesh, empty without meshlet culling
+    std::vector<uint32_t> occluderMeshes;
+    std::vector<uint32_t> meshOccluders; // instances of the named occluder meshes
+    bool autoOccluders = false;
+    OcclusionRasterizer occlusionRasterizer;
+    std::vector<uint32_t> visibleInstances;
+    std::vector<uint32_t> occluders;
+    std::vector<uint8_t> occluderFlags; // occluders are drawn without testing them against themselves
+
     VkDescriptorPool descriptorPool;
     std::vector<VkDescriptorSet> descriptorSets;
 
@@ -262,19 +405,54 @@ private:
     void createPbrGraphicsPipeline();
     void createLambertianGraphicsPipeline();
     void createMirrorGraphicsPipeline();
-    void bindSuitableGraphicsPipeline(VkCommandBuffer commandBuffer, uint32_t pipelineId);
+    const std::vector<VkPipeline> &getSuitableGraphicsPipelines(uint32_t pipelineId) const;
+    void createScenePipelines();
+    // a pipeline per static vertex layout with as many attributes as the shaders read, then the dynamic one if needed
+    void createPipelineVariants(const VkGraphicsPipelineCreateInfo &pipelineInfo, uint32_t attributeCount, std::vector<VkPipeline> &pipelines);
+    void destroyPipelineVariants(std::vector<VkPipeline> &pipelines);
 
     void createCommandPool();
     void createCommandBuffers();
     void createSyncObjects();
 
+    void createInstanceAabbs();
+    void createGpuCullingResources();
+    void createGpuCullingDescriptorSets();
+    void createCullPipeline();
+    void createIndirectGraphicsPipeline(VkDescriptorSetLayout setLayout);
+    void destroyGpuCullingResources();
+    void createInstancingResources();
+    void destroyInstancingResources();
+    void recordGpuCulling(VkCommandBuffer commandBuffer);
+    void createDepthReadbackBuffers();
+    void destroyDepthReadbackBuffers();
+    void recordDepthReadback(VkCommandBuffer commandBuffer, glm::mat4 viewProj);
+    void buildHiZ(glm::mat4 viewProj, bool debug);
+    void rasterizeOccluders(glm::mat4 viewProj);
+    // frustum bit of the instance and the occlusion test on top of it
+    bool isInstanceVisible(uint32_t instance);
+    void drawMeshlets(VkCommandBuffer commandBuffer, size_t mesh, uint32_t instance, uint32_t firstInstance, const std::array<glm::vec4, 6> &planes, glm::vec3 cameraPosition, CullingStats &stats);
+    void compactDrawList();
+    void createRecordingPools();
+    void destroyRecordingPools();
+    // viewport, scissor and push constants, every secondary buffer starts without any state
+    void recordFrameState(VkCommandBuffer commandBuffer, const PushConstants &pushConstants, bool drawSkybox);
+    void recordMeshes(VkCommandBuffer commandBuffer, size_t firstEntry, size_t lastEntry, const PushConstants &pushConstants, const std::array<glm::vec4, 6> &planes, glm::vec3 cameraPosition, CullingStats &stats);
+    void recordSecondaryCommandBuffers(const std::vector<VkCommandBuffer> &secondaries, uint32_t imageIndex, const PushConstants &pushConstants, const std::array<glm::vec4, 6> &planes, glm::vec3 cameraPosition);
+    void cullScene(glm::mat4 proj);
+    void createCommandBufferCache();
+    void destroyCommandBufferCache();
     void recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex, glm::mat4 view, glm::mat4 proj);
-    void updateVertexDescriptions(uint32_t stride, uint32_t posOffset, uint32_t normalOffset, uint32_t colorOffset, std::string posFormat, std::string normalFormat, std::string colorFormat);
-    void updateVertexDescriptions2(uint32_t stride, uint32_t posOffset, uint32_t normalOffset, uint32_t tangentOffset, uint32_t texcoordOffset, uint32_t colorOffset, std::string posFormat, std::string normalFormat, std::string tangentFormat, std::string texcoordFormat, std::string colorFormat);
-    void updateUniformBuffer(uint32_t currentImage, const std::vector<glm::mat4> &uniformData, glm::mat4 view, bool debug);
+    void createVertexLayouts();
+    void createRenderQueue();
+    // binds the pipeline variant of the mesh and its dynamic vertex input, skipping whatever is bound already
+    void bindMeshState(VkCommandBuffer commandBuffer, const std::vector<VkPipeline> &pipelines, uint32_t mesh, MeshBindState &bound, CullingStats &stats);
+    void updateUniformBuffer(uint32_t currentImage, const std::vector<glm::mat4> &uniformData, const std::vector<uint32_t> &dirtyInstances, glm::mat4 view, bool debug);
 
+    void createVertexBuffers(const std::vector<std::string> &vertexData, const std::vector<AABB> &in_aabbs, const std::vector<uint32_t> &in_counts, const std::vector<uint32_t> &in_strides, const std::vector<uint32_t> &in_posOffsets, const std::vector<uint32_t> &in_normalOffsets);
     void createVertexBuffer(const char *meshData, size_t size);
     void createUniformBuffers(size_t size);
+    void createDeviceLocalBuffer(const void *data, VkDeviceSize size, VkBufferUsageFlags usage, VkBuffer &buffer, VkDeviceMemory &bufferMemory);
     void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer &buffer, VkDeviceMemory &bufferMemory);
     void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
     VkCommandBuffer beginSingleTimeCommands();
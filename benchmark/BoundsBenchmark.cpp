@@ -0,0 +1,57 @@
+#include "../CullingHelper.h"
+#include "../SimdHelper.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+
+// compares the mesh bounds kernel with a plain loop over interleaved position, normal and color vertices
+// usage: BoundsBenchmark [vertices] [iterations]
+int main(int argc, char **argv)
+{
+    size_t count = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+    size_t iterations = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 20;
+
+    // the simple material layout, position and normal as three floats and a packed color
+    const uint32_t stride = 28, posOffset = 0, normalOffset = 12;
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> dist(-100.0f, 100.0f);
+    std::vector<char> vertices(count * stride);
+    for (size_t i = 0; i < count * stride / sizeof(float); ++i)
+    {
+        float value = dist(rng);
+        std::memcpy(vertices.data() + i * sizeof(float), &value, sizeof(float));
+    }
+
+    AABB reference{.min = glm::vec3(FLT_MAX), .max = glm::vec3(-FLT_MAX)};
+    auto start = std::chrono::steady_clock::now();
+    for (size_t iteration = 0; iteration < iterations; ++iteration)
+    {
+        reference = AABB{.min = glm::vec3(FLT_MAX), .max = glm::vec3(-FLT_MAX)};
+        for (size_t i = 0; i < count; ++i)
+        {
+            glm::vec3 position;
+            std::memcpy(&position, vertices.data() + i * stride + posOffset, sizeof(position));
+            reference.min = glm::min(reference.min, position);
+            reference.max = glm::max(reference.max, position);
+        }
+    }
+    auto middle = std::chrono::steady_clock::now();
+
+    AABB aabb;
+    for (size_t iteration = 0; iteration < iterations; ++iteration)
+    {
+        aabb = createAABB(vertices.data(), vertices.size(), stride, posOffset, normalOffset);
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    bool match = aabb.min == reference.min && aabb.max == reference.max;
+    double scalarTime = std::chrono::duration<double, std::nano>(middle - start).count() / static_cast<double>(count * iterations);
+    double kernelTime = std::chrono::duration<double, std::nano>(end - middle).count() / static_cast<double>(count * iterations);
+    std::cout << count << " vertices, " << stride << " byte stride, bounds " << (match ? "match" : "differ") << std::endl;
+    std::cout << "scalar: " << scalarTime << " ns per vertex" << std::endl;
+    std::cout << "kernel, " << SIMD_WIDTH << " lanes: " << kernelTime << " ns per vertex (" << scalarTime / kernelTime << "x)" << std::endl;
+    return match ? 0 : 1;
+}
@@ -0,0 +1,68 @@
+#include "../CullingHelper.h"
+#include "../SimdHelper.h"
+
+#include <glm/gtc/quaternion.hpp>
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+
+// compares the per-instance SAT test with the batched one on a random scene
+// usage: CullingBenchmark [instances] [iterations]
+int main(int argc, char **argv)
+{
+    size_t count = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 100000;
+    size_t iterations = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 20;
+
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+
+    // a 1.5 aspect camera with a 0.8 rad vertical fov, instances spread around it so most of them get culled
+    float top = std::tan(0.4f) * 0.1f;
+    CullingFrustum frustum{1.5f * top, top, -0.1f, -100.0f};
+
+    std::vector<glm::mat4> transforms(count);
+    std::vector<AABB> aabbs(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        glm::quat rotation = glm::normalize(glm::quat(dist(rng), dist(rng), dist(rng), dist(rng)));
+        glm::vec3 translation(dist(rng) * 60.0f, dist(rng) * 60.0f, dist(rng) * 80.0f - 40.0f);
+        transforms[i] = glm::translate(glm::mat4(1.0f), translation) * glm::mat4_cast(rotation);
+        glm::vec3 extents(std::abs(dist(rng)) + 0.1f, std::abs(dist(rng)) + 0.1f, std::abs(dist(rng)) + 0.1f);
+        aabbs[i] = {-extents, extents};
+    }
+
+    std::vector<uint8_t> reference(count);
+    auto start = std::chrono::steady_clock::now();
+    for (size_t iteration = 0; iteration < iterations; ++iteration)
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            reference[i] = test_using_separating_axis_theorem(frustum, transforms[i], aabbs[i]);
+        }
+    }
+    auto middle = std::chrono::steady_clock::now();
+
+    std::vector<uint32_t> visibility((count + 31) / 32);
+    for (size_t iteration = 0; iteration < iterations; ++iteration)
+    {
+        cullInstances(frustum, transforms.data(), aabbs.data(), count, visibility.data());
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    size_t visible = 0, mismatches = 0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        bool batched = (visibility[i / 32] >> (i % 32)) & 1;
+        visible += reference[i];
+        mismatches += batched != static_cast<bool>(reference[i]);
+    }
+
+    double scalarTime = std::chrono::duration<double, std::nano>(middle - start).count() / static_cast<double>(count * iterations);
+    double batchedTime = std::chrono::duration<double, std::nano>(end - middle).count() / static_cast<double>(count * iterations);
+    std::cout << count << " instances, " << visible << " visible, " << mismatches << " mismatches" << std::endl;
+    std::cout << "per instance: " << scalarTime << " ns" << std::endl;
+    std::cout << "batched, " << SIMD_WIDTH << " lanes: " << batchedTime << " ns (" << scalarTime / batchedTime << "x)" << std::endl;
+    return mismatches == 0 ? 0 : 1;
+}
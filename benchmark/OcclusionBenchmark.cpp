@@ -0,0 +1,181 @@
+#include "../OcclusionHelper.h"
+#include "../SimdHelper.h"
+
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+
+// true if the segment from origin to target passes through the box before reaching target
+static bool segmentHitsBox(glm::vec3 origin, glm::vec3 target, const AABB &box)
+{
+    glm::vec3 direction = target - origin;
+    float enter = 0.0f, exit = 1.0f;
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        if (std::abs(direction[axis]) < 1e-12f)
+        {
+            if (origin[axis] < box.min[axis] || origin[axis] > box.max[axis])
+                return false;
+            continue;
+        }
+        float t0 = (box.min[axis] - origin[axis]) / direction[axis];
+        float t1 = (box.max[axis] - origin[axis]) / direction[axis];
+        enter = std::max(enter, std::min(t0, t1));
+        exit = std::min(exit, std::max(t0, t1));
+    }
+    return enter <= exit && enter < 0.999f;
+}
+
+// renders a wall with a narrow slit from one camera, reprojects it for a camera that stepped back and sideways,
+// and counts the props seen through the slit that the pyramid reports hidden and the props behind the wall it lets through
+static size_t countHiddenThroughSlit(size_t &visibleBehindWall)
+{
+    const uint32_t width = 1920, height = 1080;
+    const float slitMin = 2.0f, slitMax = 2.06f, propX = 6.0f;
+    glm::mat4 proj = glm::perspective(0.8f, 16.0f / 9.0f, 0.1f, 500.0f);
+    proj[1][1] *= -1;
+    glm::vec3 sourceEye(-10.0f, 0.0f, 1.7f), targetEye(-13.0f, 0.5f, 1.7f);
+    glm::mat4 sourceViewProj = proj * glm::lookAt(sourceEye, sourceEye + glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+    glm::mat4 targetViewProj = proj * glm::lookAt(targetEye, targetEye + glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+
+    // the wall is the plane x = 0, open between slitMin and slitMax along y
+    glm::mat4 inverse = glm::inverse(sourceViewProj);
+    std::vector<float> depth(static_cast<size_t>(width) * height, 1.0f);
+    for (uint32_t y = 0; y < height; ++y)
+    {
+        for (uint32_t x = 0; x < width; ++x)
+        {
+            glm::vec2 ndc((x + 0.5f) / width * 2.0f - 1.0f, (y + 0.5f) / height * 2.0f - 1.0f);
+            glm::vec4 farPoint = inverse * glm::vec4(ndc, 1.0f, 1.0f);
+            glm::vec3 direction = glm::vec3(farPoint) / farPoint.w - sourceEye;
+            if (direction.x <= 0.0f)
+                continue;
+            glm::vec3 hit = sourceEye + direction * (-sourceEye.x / direction.x);
+            if (hit.y >= slitMin && hit.y <= slitMax)
+                continue;
+            glm::vec4 clip = sourceViewProj * glm::vec4(hit, 1.0f);
+            depth[y * width + x] = clip.z / clip.w;
+        }
+    }
+    HiZBuffer hiZ;
+    hiZ.build(depth.data(), width, height, sourceViewProj, targetViewProj);
+
+    // thin props behind the slit on the line of sight through its middle
+    float slope = ((slitMin + slitMax) * 0.5f - targetEye.y) / -targetEye.x;
+    float propY = (slitMin + slitMax) * 0.5f + slope * propX;
+    size_t hiddenCount = 0;
+    visibleBehindWall = 0;
+    for (int i = 0; i < 8; ++i)
+    {
+        glm::vec3 center(propX, propY, 0.25f + 0.5f * i);
+        AABB box = {center - glm::vec3(0.02f), center + glm::vec3(0.02f)};
+        hiddenCount += hiZ.isOccluded(box);
+        box.min.y -= 4.0f;
+        box.max.y -= 4.0f;
+        visibleBehindWall += !hiZ.isOccluded(box);
+    }
+    return hiddenCount;
+}
+
+// rasterizes the biggest buildings of a street grid and tests small props against them,
+// every prop reported hidden is checked by casting rays to points on its box, then a reprojected slit is checked
+// usage: OcclusionBenchmark [props] [occluders] [iterations]
+int main(int argc, char **argv)
+{
+    size_t count = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 100000;
+    size_t occluderCount = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 32;
+    size_t iterations = argc > 3 ? std::strtoull(argv[3], nullptr, 10) : 20;
+
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> dist(0.0f, 1.0f);
+
+    // 20 by 20 blocks of buildings on a 10 unit grid, streets in between, z is up
+    std::vector<AABB> bounds;
+    for (int bx = 0; bx < 20; ++bx)
+    {
+        for (int by = 0; by < 20; ++by)
+        {
+            glm::vec3 corner(bx * 10.0f - 100.0f + 1.0f, by * 10.0f - 100.0f + 1.0f, 0.0f);
+            bounds.push_back({corner, corner + glm::vec3(8.0f, 8.0f, 5.0f + 20.0f * dist(rng))});
+        }
+    }
+    size_t buildingCount = bounds.size();
+    for (size_t i = 0; i < count; ++i)
+    {
+        glm::vec3 center(dist(rng) * 200.0f - 100.0f, dist(rng) * 200.0f - 100.0f, dist(rng) * 3.0f);
+        glm::vec3 extents(0.2f + 0.3f * dist(rng));
+        bounds.push_back({center - extents, center + extents});
+    }
+
+    // standing in a street, looking along it
+    glm::vec3 eye(-95.0f, 0.0f, 1.7f);
+    glm::mat4 proj = glm::perspective(0.8f, 16.0f / 9.0f, 0.1f, 500.0f);
+    proj[1][1] *= -1;
+    glm::mat4 viewProj = proj * glm::lookAt(eye, eye + glm::vec3(1.0f, 0.05f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+
+    std::vector<uint32_t> buildings(buildingCount);
+    for (uint32_t i = 0; i < buildingCount; ++i)
+        buildings[i] = i;
+    std::vector<uint32_t> occluders;
+    OcclusionRasterizer rasterizer;
+    rasterizer.resize(OCCLUSION_RASTER_WIDTH, OCCLUSION_RASTER_WIDTH * 9 / 16);
+    HiZBuffer hiZ;
+    std::vector<uint8_t> hidden(count);
+
+    double rasterTime = 0.0, testTime = 0.0;
+    for (size_t iteration = 0; iteration < iterations; ++iteration)
+    {
+        auto start = std::chrono::steady_clock::now();
+        selectOccluders(bounds, buildings, eye, occluderCount, occluders);
+        rasterizer.clear(viewProj);
+        for (auto occluder : occluders)
+            rasterizer.drawBox(glm::mat4(1.0f), bounds[occluder]);
+        hiZ.build(rasterizer.data(), rasterizer.getWidth(), rasterizer.getHeight(), viewProj);
+        auto middle = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < count; ++i)
+            hidden[i] = hiZ.isOccluded(bounds[buildingCount + i]);
+        auto end = std::chrono::steady_clock::now();
+        rasterTime += std::chrono::duration<double, std::milli>(middle - start).count();
+        testTime += std::chrono::duration<double, std::milli>(end - middle).count();
+    }
+
+    // a hidden prop must have every sample point behind one of the rasterized buildings
+    size_t hiddenCount = 0, violations = 0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (!hidden[i])
+            continue;
+        hiddenCount++;
+        const AABB &box = bounds[buildingCount + i];
+        bool covered = true;
+        for (int sx = 0; sx <= 3 && covered; ++sx)
+        {
+            for (int sy = 0; sy <= 3 && covered; ++sy)
+            {
+                for (int sz = 0; sz <= 3 && covered; ++sz)
+                {
+                    glm::vec3 point = box.min + (box.max - box.min) * glm::vec3(sx, sy, sz) / 3.0f;
+                    bool blocked = false;
+                    for (auto occluder : occluders)
+                        blocked = blocked || segmentHitsBox(eye, point, bounds[occluder]);
+                    covered = blocked;
+                }
+            }
+        }
+        violations += !covered;
+    }
+
+    std::cout << count << " props, " << occluders.size() << " occluders, " << rasterizer.getWidth() << "x" << rasterizer.getHeight() << " depth, " << SIMD_WIDTH << " lanes" << std::endl;
+    std::cout << hiddenCount << " hidden, " << violations << " hidden but visible" << std::endl;
+    std::cout << "rasterize and build: " << rasterTime / iterations << " ms, test: " << testTime / iterations << " ms ("
+              << testTime * 1e6 / static_cast<double>(count * iterations) << " ns per prop)" << std::endl;
+
+    size_t wallVisible = 0;
+    size_t slitHidden = countHiddenThroughSlit(wallVisible);
+    std::cout << "reprojected slit: " << slitHidden << " of 8 props seen through it hidden, " << wallVisible << " of 8 props behind the wall visible" << std::endl;
+    return violations == 0 && slitHidden == 0 ? 0 : 1;
+}
@@ -0,0 +1,352 @@
+#include "../BvhHelper.h"
+#include "../CullingHelper.h"
+#include "../SceneParser.h"
+#include "../SimdHelper.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+
+// meshes the instances are spread over, all of them share the same unit cube vertex data
+const uint32_t SYNTHETIC_MESHES = 8;
+// side of the square the leaves are scattered over by default, city scale against the 1000 unit far plane
+// so most instances are off screen from the street and the low overhead view
+const float DEFAULT_SCENE_EXTENT = 4000.0f;
+// height of the overhead camera path
+const float OVERHEAD_HEIGHT = 300.0f;
+
+// writes an .s72 scene with instances mesh nodes as the leaves of a tree depth levels deep, spread over an extent wide square,
+// and drivers animating random nodes, rotation on inner nodes so whole subtrees move and translation on the leaves
+static void writeSyntheticScene(const std::string &filename, uint32_t instances, uint32_t depth, uint32_t drivers, float extent, std::mt19937 &rng)
+{
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    depth = std::max(depth, 1u);
+    uint32_t branching = std::max(2u, static_cast<uint32_t>(std::ceil(std::pow(static_cast<float>(instances), 1.0f / static_cast<float>(depth)))));
+
+    // node counts per level from the leaves up, a parent takes the next branching nodes of the level below
+    std::vector<uint32_t> levelCounts(depth);
+    levelCounts[depth - 1] = instances;
+    for (uint32_t level = depth - 1; level > 0; --level)
+    {
+        levelCounts[level - 1] = (levelCounts[level] + branching - 1) / branching;
+    }
+
+    // object ids are the 1-based position in the array: the scene, then the meshes, then the nodes level by level
+    std::vector<uint32_t> levelFirst(depth);
+    uint32_t nextId = 2 + SYNTHETIC_MESHES;
+    for (uint32_t level = 0; level < depth; ++level)
+    {
+        levelFirst[level] = nextId;
+        nextId += levelCounts[level];
+    }
+
+    std::ostringstream out;
+    out << "[\"s72-v1\",\n{\"type\":\"SCENE\",\"name\":\"synthetic\",\"roots\":[";
+    for (uint32_t i = 0; i < levelCounts[0]; ++i)
+    {
+        out << (i ? "," : "") << levelFirst[0] + i;
+    }
+    out << "]}";
+
+    for (uint32_t i = 0; i < SYNTHETIC_MESHES; ++i)
+    {
+        out << ",\n{\"type\":\"MESH\",\"name\":\"mesh" << i << "\",\"topology\":\"TRIANGLE_LIST\",\"count\":36,\"attributes\":{"
+            << "\"POSITION\":{\"src\":\"synthetic.b72\",\"offset\":0,\"stride\":28,\"format\":\"R32G32B32_SFLOAT\"},"
+            << "\"NORMAL\":{\"src\":\"synthetic.b72\",\"offset\":12,\"stride\":28,\"format\":\"R32G32B32_SFLOAT\"},"
+            << "\"COLOR\":{\"src\":\"synthetic.b72\",\"offset\":24,\"stride\":28,\"format\":\"R8G8B8A8_UNORM\"}}}";
+    }
+
+    for (uint32_t level = 0; level < depth; ++level)
+    {
+        // leaves are scattered over the whole extent, inner nodes only add a small offset
+        float spread = level + 1 == depth ? extent : 4.0f;
+        for (uint32_t i = 0; i < levelCounts[level]; ++i)
+        {
+            out << ",\n{\"type\":\"NODE\",\"name\":\"node" << level << "_" << i << "\",\"translation\":["
+                << (unit(rng) - 0.5f) * spread << "," << unit(rng) * 4.0f << "," << (unit(rng) - 0.5f) * spread << "]";
+            if (level + 1 == depth)
+            {
+                out << ",\"scale\":[" << 0.5f + unit(rng) << "," << 0.5f + unit(rng) << "," << 0.5f + unit(rng) << "]";
+                out << ",\"mesh\":" << 2 + i % SYNTHETIC_MESHES;
+            }
+            else
+            {
+                out << ",\"children\":[";
+                uint32_t first = i * branching;
+                uint32_t last = std::min(first + branching, levelCounts[level + 1]);
+                for (uint32_t child = first; child < last; ++child)
+                {
+                    out << (child != first ? "," : "") << levelFirst[level + 1] + child;
+                }
+                out << "]";
+            }
+            out << "}";
+        }
+    }
+
+    for (uint32_t i = 0; i < drivers; ++i)
+    {
+        uint32_t level = static_cast<uint32_t>(unit(rng) * depth) % depth;
+        uint32_t node = levelFirst[level] + static_cast<uint32_t>(unit(rng) * levelCounts[level]) % levelCounts[level];
+        bool leaf = level + 1 == depth;
+        out << ",\n{\"type\":\"DRIVER\",\"name\":\"driver" << i << "\",\"node\":" << node
+            << ",\"channel\":\"" << (leaf ? "translation" : "rotation") << "\",\"times\":[0,1,2,3,4],\"values\":[";
+        for (uint32_t key = 0; key < 5; ++key)
+        {
+            if (leaf)
+            {
+                out << (key ? "," : "") << (unit(rng) - 0.5f) * extent << "," << unit(rng) * 4.0f << "," << (unit(rng) - 0.5f) * extent;
+            }
+            else
+            {
+                float angle = 0.2f * static_cast<float>(key);
+                out << (key ? "," : "") << "0," << std::sin(angle) << ",0," << std::cos(angle);
+            }
+        }
+        out << "],\"interpolation\":\"" << (leaf ? "LINEAR" : "SLERP") << "\"}";
+    }
+    out << "\n]\n";
+
+    std::ofstream file(filename, std::ios::binary);
+    if (!file.is_open())
+        throw std::runtime_error("failed to write " + filename);
+    file << out.str();
+}
+
+// interleaved position, normal and color like the scene meshes
+static std::vector<char> createVertexData(size_t vertices, std::mt19937 &rng)
+{
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+    std::vector<char> data(vertices * 28);
+    for (size_t i = 0; i < vertices; ++i)
+    {
+        float position[3] = {dist(rng), dist(rng), dist(rng)};
+        std::memcpy(data.data() + i * 28, position, sizeof(position));
+    }
+    return data;
+}
+
+// look-at views along a few camera paths through the scene, one per frame
+static glm::mat4 getPathView(uint32_t path, float t, float extent)
+{
+    glm::vec3 up(0.0f, 1.0f, 0.0f);
+    if (path == 0)
+    {
+        // orbit around the center looking in
+        glm::vec3 eye(std::cos(t) * extent * 0.6f, 40.0f, std::sin(t) * extent * 0.6f);
+        return glm::lookAt(eye, glm::vec3(0.0f), up);
+    }
+    if (path == 1)
+    {
+        // street level flythrough looking ahead
+        glm::vec3 eye(-extent * 0.5f + t * 40.0f, 2.0f, 10.0f * std::sin(t));
+        return glm::lookAt(eye, eye + glm::vec3(1.0f, 0.0f, 0.2f * std::cos(t)), up);
+    }
+    // overhead, looking down on the center, sees all of a small extent but only a district of a large one
+    glm::vec3 eye(10.0f * std::sin(t), OVERHEAD_HEIGHT, 10.0f * std::cos(t));
+    return glm::lookAt(eye, glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f));
+}
+
+struct Samples
+{
+    const char *name;
+    std::vector<double> nanoseconds; // per frame
+};
+
+static void printSamples(Samples &samples, size_t items)
+{
+    std::sort(samples.nanoseconds.begin(), samples.nanoseconds.end());
+    auto percentile = [&](double p)
+    { return samples.nanoseconds[static_cast<size_t>(p * static_cast<double>(samples.nanoseconds.size() - 1))]; };
+    double perItem = static_cast<double>(std::max<size_t>(items, 1));
+    std::cout << samples.name << ": median " << percentile(0.5) / perItem << " ns/instance, p99 " << percentile(0.99) / perItem
+              << " ns/instance, " << percentile(0.5) / 1000.0 << " us/frame" << std::endl;
+
+    // ten buckets between the fastest and the slowest frame
+    const uint32_t buckets = 10;
+    double low = samples.nanoseconds.front();
+    double width = std::max((samples.nanoseconds.back() - low) / buckets, 1.0);
+    std::vector<size_t> counts(buckets);
+    for (double sample : samples.nanoseconds)
+    {
+        counts[std::min(static_cast<uint32_t>((sample - low) / width), buckets - 1)]++;
+    }
+    size_t most = *std::max_element(counts.begin(), counts.end());
+    for (uint32_t i = 0; i < buckets; ++i)
+    {
+        std::cout << "  " << (low + i * width) / perItem << " ns " << std::string(counts[i] * 40 / most, '#') << " " << counts[i] << std::endl;
+    }
+}
+
+// generates a scene, then times loading, the per-frame transform update and the culling tiers along camera paths;
+// a smaller extent puts more of the scene on screen, e.g. 400 for a mostly visible one
+// usage: SceneBenchmark [instances] [depth] [drivers] [frames] [extent]
+int main(int argc, char **argv)
+{
+    uint32_t instances = argc > 1 ? static_cast<uint32_t>(std::strtoul(argv[1], nullptr, 10)) : 100000;
+    uint32_t depth = argc > 2 ? static_cast<uint32_t>(std::strtoul(argv[2], nullptr, 10)) : 4;
+    uint32_t driverCount = argc > 3 ? static_cast<uint32_t>(std::strtoul(argv[3], nullptr, 10)) : 1000;
+    uint32_t frames = argc > 4 ? static_cast<uint32_t>(std::strtoul(argv[4], nullptr, 10)) : 300;
+    float extent = argc > 5 ? std::strtof(argv[5], nullptr) : DEFAULT_SCENE_EXTENT;
+
+    std::mt19937 rng(42);
+    std::string sceneFile = (std::filesystem::temp_directory_path() / "synthetic.s72").string();
+
+    try
+    {
+        writeSyntheticScene(sceneFile, instances, depth, driverCount, extent, rng);
+
+        auto start = std::chrono::steady_clock::now();
+        SceneParser parser(sceneFile);
+        SceneStructure structure = parser.parseSceneStructure(true);
+        double parseTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        std::cout << instances << " instances, depth " << depth << ", " << structure.drivers.size() << " drivers, parsed in " << parseTime << " ms" << std::endl;
+
+        // mesh bounds, one big buffer alone and split over meshes the way createVertexBuffers sees a scene
+        std::vector<char> vertices = createVertexData(size_t(1) << 22, rng);
+        start = std::chrono::steady_clock::now();
+        AABB bigAabb = createAABB(vertices, 28, 0, 12);
+        double singleTime = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        std::vector<VertexSource> sources;
+        size_t meshSize = vertices.size() / 16 / 28 * 28;
+        for (size_t offset = 0; offset + meshSize <= vertices.size(); offset += meshSize)
+        {
+            sources.push_back(VertexSource{vertices.data() + offset, meshSize, 28, 0, 12});
+        }
+        std::vector<AABB> meshAabbs;
+        start = std::chrono::steady_clock::now();
+        createAABBs(sources, meshAabbs);
+        double batchTime = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        AABB merged = meshAabbs[0];
+        for (const auto &aabb : meshAabbs)
+        {
+            merged.min = glm::min(merged.min, aabb.min);
+            merged.max = glm::max(merged.max, aabb.max);
+        }
+        bool boundsMatch = merged.min == bigAabb.min && merged.max == bigAabb.max;
+        std::cout << "createAABB: " << singleTime / static_cast<double>(vertices.size() / 28) << " ns/vertex, createAABBs over "
+                  << sources.size() << " meshes: " << batchTime / static_cast<double>(vertices.size() / 28) << " ns/vertex"
+                  << (boundsMatch ? "" : " (bounds differ!)") << std::endl;
+
+        // instance order and bounds as the renderer lays them out
+        std::vector<char> cube = createVertexData(36, rng);
+        AABB cubeAabb = createAABB(cube, 28, 0, 12);
+        std::vector<glm::mat4> uniformData;
+        for (const auto &meshInfo : structure.meshes)
+        {
+            uniformData.insert(uniformData.end(), meshInfo.transforms.begin(), meshInfo.transforms.end());
+        }
+        size_t count = uniformData.size();
+        std::vector<AABB> instanceAabbs(count, cubeAabb);
+        std::vector<AABB> worldAabbs(count);
+        std::vector<glm::vec4> worldSpheres(count);
+        for (size_t i = 0; i < count; ++i)
+        {
+            worldAabbs[i] = transformAABB(uniformData[i], instanceAabbs[i]);
+            worldSpheres[i] = transformBoundingSphere(uniformData[i], instanceAabbs[i]);
+        }
+        InstanceBvh bvh;
+        bvh.build(worldAabbs);
+
+        float top = 0.1f * std::tan(0.5f * glm::radians(60.0f));
+        CullingFrustum frustum{16.0f / 9.0f * top, top, -0.1f, -1000.0f};
+
+        Samples update{"transform update", {}};
+        Samples reference{"per-instance sat", {}};
+        Samples tiered{"bvh, sphere, box, batched sat", {}};
+        std::vector<uint8_t> referenceVisible(count);
+        std::vector<uint32_t> visibility((count + 31) / 32);
+        std::vector<uint32_t> candidates;
+        std::vector<glm::mat4> candidateTransforms;
+        std::vector<AABB> candidateAabbs;
+        std::vector<uint32_t> candidateVisibility;
+        std::vector<glm::mat4> viewTransforms(count);
+        CullingStats stats;
+        size_t mismatches = 0, visibleTotal = 0;
+
+        for (uint32_t path = 0; path < 3; ++path)
+        {
+            for (uint32_t frame = 0; frame < frames; ++frame)
+            {
+                // the hierarchy starts at time 0, where updateTransforms has nothing to evaluate
+                float time = static_cast<float>(frame + 1) / 60.0f;
+
+                // animation and dirty instance upload, the same work Application::updateScene and the uniform update do
+                start = std::chrono::steady_clock::now();
+                SceneParser::updateTransforms(structure, time);
+                const TransformHierarchy &hierarchy = structure.hierarchy;
+                for (size_t i = 0; i < hierarchy.dirtyInstances.size(); ++i)
+                {
+                    uint32_t instance = hierarchy.dirtyInstances[i];
+                    uniformData[instance] = hierarchy.worlds[hierarchy.meshEntries[hierarchy.dynamicMeshes[i]]];
+                    worldAabbs[instance] = transformAABB(uniformData[instance], instanceAabbs[instance]);
+                    worldSpheres[instance] = transformBoundingSphere(uniformData[instance], instanceAabbs[instance]);
+                }
+                bvh.refit(worldAabbs, hierarchy.dirtyInstances);
+                auto middle = std::chrono::steady_clock::now();
+                update.nanoseconds.push_back(std::chrono::duration<double, std::nano>(middle - start).count());
+
+                glm::mat4 view = getPathView(path, time, extent);
+                for (size_t i = 0; i < count; ++i)
+                {
+                    viewTransforms[i] = view * uniformData[i];
+                }
+                start = std::chrono::steady_clock::now();
+                for (size_t i = 0; i < count; ++i)
+                {
+                    referenceVisible[i] = test_using_separating_axis_theorem(frustum, viewTransforms[i], instanceAabbs[i]);
+                }
+                middle = std::chrono::steady_clock::now();
+                reference.nanoseconds.push_back(std::chrono::duration<double, std::nano>(middle - start).count());
+
+                // same tiers as VulkanHelper::recordCommandBuffer
+                std::array<glm::vec4, 6> planes = getFrustumPlanes(frustum, view);
+                bvh.cull(planes, worldAabbs, worldSpheres, visibility, candidates, stats);
+                candidateTransforms.resize(candidates.size());
+                candidateAabbs.resize(candidates.size());
+                for (size_t i = 0; i < candidates.size(); ++i)
+                {
+                    candidateTransforms[i] = view * uniformData[candidates[i]];
+                    candidateAabbs[i] = instanceAabbs[candidates[i]];
+                }
+                candidateVisibility.resize((candidates.size() + 31) / 32);
+                cullInstances(frustum, candidateTransforms.data(), candidateAabbs.data(), candidates.size(), candidateVisibility.data());
+                for (size_t i = 0; i < candidates.size(); ++i)
+                {
+                    if ((candidateVisibility[i / 32] >> (i % 32)) & 1)
+                        visibility[candidates[i] / 32] |= 1u << (candidates[i] % 32);
+                }
+                tiered.nanoseconds.push_back(std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - middle).count());
+
+                for (size_t i = 0; i < count; ++i)
+                {
+                    bool visible = (visibility[i / 32] >> (i % 32)) & 1;
+                    visibleTotal += visible;
+                    mismatches += visible != static_cast<bool>(referenceVisible[i]);
+                }
+            }
+        }
+
+        double visibleRatio = static_cast<double>(visibleTotal) / static_cast<double>(std::max<size_t>(count * 3 * frames, 1));
+        std::cout << count << " instances over a " << extent << " unit extent, " << visibleTotal / (3 * frames) << " visible per frame ("
+                  << visibleRatio * 100.0 << "%), " << mismatches << " mismatches" << std::endl;
+        printSamples(update, count);
+        printSamples(reference, count);
+        printSamples(tiered, count);
+        std::filesystem::remove(sceneFile);
+        return mismatches == 0 && boundsMatch ? 0 : 1;
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << std::endl;
+        std::filesystem::remove(sceneFile);
+        return EXIT_FAILURE;
+    }
+}
@@ -1,4 +1,5 @@
 #include "Application.h"
+#include "SceneCache.h"
 
 int main(int argc, char *argv[])
 {
@@ -6,6 +7,22 @@ int main(int argc, char *argv[])
     std::optional<std::string> camera;
     std::optional<std::string> device;
     uint32_t width = 800, height = 600;
+    bool useMapping = true;
+    bool loadStats = false;
+    bool parallelParse = false;
+    bool compile = false;
+    bool useCache = true;
+    bool cullingStats = false;
+    bool temporalCulling = false;
+    bool gpuCulling = false;
+    bool occlusionCulling = false;
+    bool softwareOcclusion = false;
+    bool autoOccluders = false;
+    bool meshletCulling = false;
+    bool instancedDrawing = false;
+    bool parallelRecording = false;
+    bool commandBufferCache = false;
+    std::vector<std::string> occluders;
     for (int i = 0; i < argc; ++i)
     {
         if (std::string(argv[i]) == "--scene")
@@ -25,20 +42,145 @@ int main(int argc, char *argv[])
             width = static_cast<uint32_t>(std::stoul(argv[i + 1]));
             height = static_cast<uint32_t>(std::stoul(argv[i + 2]));
         }
+        if (std::string(argv[i]) == "--no-mmap")
+        {
+            useMapping = false;
+        }
+        if (std::string(argv[i]) == "--load-stats")
+        {
+            loadStats = true;
+        }
+        if (std::string(argv[i]) == "--parallel-parse")
+        {
+            parallelParse = true;
+        }
+        if (std::string(argv[i]) == "--compile-scene")
+        {
+            compile = true;
+        }
+        if (std::string(argv[i]) == "--no-scene-cache")
+        {
+            useCache = false;
+        }
+        if (std::string(argv[i]) == "--culling-stats")
+        {
+            cullingStats = true;
+        }
+        if (std::string(argv[i]) == "--temporal-culling")
+        {
+            temporalCulling = true;
+        }
+        if (std::string(argv[i]) == "--gpu-culling")
+        {
+            gpuCulling = true;
+        }
+        if (std::string(argv[i]) == "--occlusion-culling")
+        {
+            occlusionCulling = true;
+        }
+        if (std::string(argv[i]) == "--instancing")
+        {
+            instancedDrawing = true;
+        }
+        if (std::string(argv[i]) == "--parallel-recording")
+        {
+            parallelRecording = true;
+        }
+        if (std::string(argv[i]) == "--command-cache")
+        {
+            commandBufferCache = true;
+        }
+        if (std::string(argv[i]) == "--meshlet-culling")
+        {
+            meshletCulling = true;
+        }
+        if (std::string(argv[i]) == "--software-occlusion")
+        {
+            softwareOcclusion = true;
+        }
+        if (std::string(argv[i]) == "--auto-occluders")
+        {
+            autoOccluders = true;
+        }
+        if (std::string(argv[i]) == "--occluders")
+        {
+            // comma separated mesh names
+            std::string names = argv[i + 1];
+            size_t start = 0;
+            while (start <= names.size())
+            {
+                size_t comma = std::min(names.find(',', start), names.size());
+                if (comma > start)
+                    occluders.push_back(names.substr(start, comma - start));
+                start = comma + 1;
+            }
+        }
     }
+    if (softwareOcclusion && occluders.empty())
+        std::cout << "software occlusion only draws the meshes named with --occluders, nothing will be hidden" << std::endl;
 
     try
     {
+        auto loadStart = std::chrono::steady_clock::now();
+        std::string compiledFile = getCompiledScenePath(sceneFile);
+        if (compile)
+        {
+            SceneParser parser(sceneFile, useMapping);
+            compileScene(parser.parseSceneStructure(parallelParse), sceneFile, compiledFile);
+            float compileTime = std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::steady_clock::now() - loadStart).count();
+            std::cout << "compiled " << sceneFile << " to " << compiledFile << " in " << compileTime << " ms" << std::endl;
+            return EXIT_SUCCESS;
+        }
+
+        // prefer an up to date compiled image, fall back to parsing the text
+        std::optional<SceneStructure> compiledStructure;
+        if (useCache)
+        {
+            try
+            {
+                compiledStructure = loadCompiledScene(compiledFile, sceneFile);
+            }
+            catch (const std::exception &e)
+            {
+                std::cout << "ignoring " << compiledFile << ": " << e.what() << std::endl;
+            }
+        }
+        std::string loadMethod = "s72b";
+        SceneStructure sceneStructure;
+        if (compiledStructure.has_value())
+        {
+            sceneStructure = std::move(compiledStructure.value());
+        }
+        else
+        {
+            SceneParser parser(sceneFile, useMapping);
+            sceneStructure = parser.parseSceneStructure(parallelParse);
+            loadMethod = parser.isMapped() ? "mmap" : "ifstream";
+        }
+        if (loadStats)
+        {
+            float loadTime = std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::steady_clock::now() - loadStart).count();
+            std::cout << "loaded " << sceneFile << " in " << loadTime << " ms (" << loadMethod << "), peak RSS " << getPeakResidentSetSize() / (1024 * 1024) << " MB" << std::endl;
+        }
+
         Application app(width, height);
-        SceneParser parser(sceneFile);
-        SceneStructure sceneStructure = parser.parseSceneStructure();
+        app.setGpuCulling(gpuCulling);
+        app.setOcclusionCulling(occlusionCulling);
+        app.setSoftwareOcclusion(softwareOcclusion);
+        app.setMeshletCulling(meshletCulling);
+        app.setInstancedDrawing(instancedDrawing);
+        app.setParallelRecording(parallelRecording);
+        app.setCommandBufferCache(commandBufferCache);
+        app.setOccluderMeshes(occluders);
+        app.setAutoOccluders(autoOccluders);
         app.loadScene(sceneStructure);
 
         if (!camera.has_value())
         {
             camera = sceneStructure.cameras[0].camera.name;
         }
-        app.renderLoop(sceneStructure, camera.value());
+        app.setTemporalCulling(temporalCulling);
+        app.renderLoop(sceneStructure, camera.value(), cullingStats);
     }
     catch (const std::exception &e)
     {
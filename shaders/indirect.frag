@@ -0,0 +1,14 @@
+#version 450
+
+layout(location = 0) in vec3 fragNormal;
+layout(location = 1) in vec4 fragColor;
+
+layout(location = 0) out vec4 outColor;
+
+void main()
+{
+    // hemisphere light from +z, scenes are z-up; only the gpu culling and --instancing paths shade with this
+    vec3 normal = normalize(fragNormal);
+    vec3 light = mix(vec3(0.1), vec3(1.0), 0.5 * normal.z + 0.5);
+    outColor = vec4(fragColor.rgb * light, fragColor.a);
+}
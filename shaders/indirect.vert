@@ -0,0 +1,41 @@
+#version 450
+
+// instanced vertex shader, the instance is looked up in the visible list compacted by cull.comp or by the cpu culling
+
+struct ObjectData
+{
+    mat4 model;
+    mat4 normal;
+};
+
+layout(std430, set = 0, binding = 0) readonly buffer Objects
+{
+    ObjectData objects[];
+};
+
+layout(std430, set = 0, binding = 4) readonly buffer VisibleInstances
+{
+    uint visibleInstances[];
+};
+
+layout(push_constant) uniform PushConstants
+{
+    mat4 view;
+    mat4 proj;
+} pc;
+
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec3 inNormal;
+layout(location = 2) in vec4 inColor;
+
+layout(location = 0) out vec3 fragNormal;
+layout(location = 1) out vec4 fragColor;
+
+void main()
+{
+    // gl_InstanceIndex already includes the firstInstance of the draw, the start of the mesh's slice of the list
+    ObjectData object = objects[visibleInstances[gl_InstanceIndex]];
+    gl_Position = pc.proj * pc.view * object.model * vec4(inPosition, 1.0);
+    fragNormal = mat3(object.normal) * inNormal;
+    fragColor = inColor;
+}